@@ -0,0 +1,42 @@
+// USB serial transmit throughput, for use with tools/usb_serial_benchmark.py
+// which sends a request and reads the data as fast as the host can.
+//
+// Each request is a line "size total".  The sketch sends total bytes with
+// Serial.write() calls of size bytes, then the host sends "t" and the
+// sketch replies with the microseconds its write calls took, so time
+// spent in the driver can be compared with the USB transfer rate.
+//
+// This example code is in the public domain.
+
+uint8_t buf[8192];
+uint32_t last_usec = 0;
+
+void setup()
+{
+	for (uint32_t i=0; i < sizeof(buf); i++) buf[i] = 'a' + i % 26;
+	Serial.begin(9600);
+}
+
+void loop()
+{
+	if (!Serial.available()) return;
+	String line = Serial.readStringUntil('\n');
+	if (line.startsWith("t")) {
+		Serial.println(last_usec);
+		return;
+	}
+	int space = line.indexOf(' ');
+	if (space < 0) return;
+	uint32_t size = line.substring(0, space).toInt();
+	uint32_t total = line.substring(space + 1).toInt();
+	if (size < 1 || size > sizeof(buf)) return;
+	uint32_t begin = micros();
+	uint32_t sent = 0;
+	while (sent < total) {
+		uint32_t n = total - sent;
+		if (n > size) n = size;
+		sent += Serial.write(buf, n);
+	}
+	Serial.send_now();
+	last_usec = micros() - begin;
+}
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+# Teensy 3.x USB serial transmit throughput benchmark
+# Copyright (c) 2021 PJRC.COM, LLC.
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# 1. The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# 2. If the Software is incorporated into a build system that allows
+# selection among a list of target devices, then similar target
+# devices manufactured by PJRC.COM must be included in the list of
+# target devices and selectable in the same manner.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+# BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+# ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""Measure USB serial transmit throughput of a Teensy.
+
+Upload tools/benchmarks/UsbSerialBenchmark to the Teensy, then run this
+script with its serial port.  For each write size, the Teensy sends the
+requested amount of data with Serial.write() calls of that size.  The
+host rate is what arrived over USB.  The Teensy time is how long its
+write calls took, which is longer than the host time only when the
+driver, not USB, limits the rate.  Requires pyserial.
+
+Example:
+  usb_serial_benchmark.py /dev/ttyACM0
+"""
+
+import argparse
+import sys
+import time
+
+try:
+	import serial
+except ImportError:
+	sys.exit('pyserial is required: pip install pyserial')
+
+SIZES = [1, 16, 64, 256, 1024, 8192]
+
+
+def run(port, size, total):
+	port.reset_input_buffer()
+	port.write(b'%d %d\n' % (size, total))
+	done = 0
+	begin = None
+	while done < total:
+		data = port.read(min(65536, total - done))
+		if not data:
+			break
+		if begin is None:
+			begin = time.perf_counter()
+			first = len(data)
+		done += len(data)
+	elapsed = time.perf_counter() - begin if begin is not None else 0.0
+	port.write(b't\n')
+	usec = int(port.readline().strip() or 0)
+	# the clock starts at the first data, so that data doesn't count
+	rate = (done - first) / elapsed / 1e6 if elapsed > 0 else 0.0
+	return done, rate, usec
+
+
+def main():
+	ap = argparse.ArgumentParser(description=__doc__,
+		formatter_class=argparse.RawDescriptionHelpFormatter)
+	ap.add_argument('port', help='serial port, eg /dev/ttyACM0 or COM3')
+	ap.add_argument('-m', '--megabytes', type=float, default=4,
+		help='amount to transfer per test (default 4)')
+	ap.add_argument('-s', '--size', type=int, action='append',
+		help='write size in bytes, may be repeated (default %s)' % SIZES)
+	args = ap.parse_args()
+
+	total = int(args.megabytes * 1e6)
+	port = serial.Serial(args.port, timeout=2)
+	print('   size   host MB/s   Teensy MB/s')
+	for size in args.size or SIZES:
+		done, rate, usec = run(port, size, total)
+		if done < total:
+			print('%7d   only %d of %d bytes arrived' % (size, done, total))
+			continue
+		print('%7d   %9.3f   %11.3f' % (size, rate, total / usec if usec else 0.0))
+	port.close()
+
+
+if __name__ == '__main__':
+	main()
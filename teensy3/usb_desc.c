@@ -68,7 +68,11 @@
 static uint8_t device_descriptor[] = {
         18,                                     // bLength
         1,                                      // bDescriptorType
+#ifdef USB_HIGHSPEED
+        0x00, 0x02,                             // bcdUSB
+#else
         0x10, 0x01,                             // bcdUSB
+#endif
 #ifdef DEVICE_CLASS
         DEVICE_CLASS,                           // bDeviceClass
 #else
@@ -117,6 +121,34 @@ static uint8_t device_descriptor[] = {
 // has trouble accessing flash memory with enough bandwidth
 // while the processor is executing from flash.
 
+#ifdef USB_HIGHSPEED
+// Device Qualifier Descriptor, USB spec 9.6.2, page 264.  A high speed
+// capable device tells the host how it would work at the other speed.
+static uint8_t qualifier_descriptor[] = {
+        10,                                     // bLength
+        6,                                      // bDescriptorType
+        0x00, 0x02,                             // bcdUSB
+#ifdef DEVICE_CLASS
+        DEVICE_CLASS,                           // bDeviceClass
+#else
+        0,
+#endif
+#ifdef DEVICE_SUBCLASS
+        DEVICE_SUBCLASS,                        // bDeviceSubClass
+#else
+        0,
+#endif
+#ifdef DEVICE_PROTOCOL
+        DEVICE_PROTOCOL,                        // bDeviceProtocol
+#else
+        0,
+#endif
+        EP0_SIZE,                               // bMaxPacketSize0
+        1,                                      // bNumConfigurations
+        0                                       // bReserved
+};
+#endif
+
 
 
 // **************************************************************
@@ -601,6 +633,13 @@ static uint8_t flightsim_report_desc[] = {
 
 // USB Configuration Descriptor.  This huge descriptor tells all
 // of the devices capabilities.
+#ifdef USB_HIGHSPEED
+// The USBHS driver builds the configuration for the speed actually in
+// use, and the other speed configuration, from config_descriptor.
+uint8_t usb_config_descriptor_speed[CONFIG_DESC_SIZE];
+uint8_t usb_config_descriptor_other[CONFIG_DESC_SIZE];
+const uint16_t usb_config_descriptor_size = CONFIG_DESC_SIZE;
+#endif
 static uint8_t config_descriptor[CONFIG_DESC_SIZE] = {
         // configuration descriptor, USB spec 9.6.3, page 264-266, Table 9-10
         9,                                      // bLength;
@@ -1844,10 +1883,21 @@ void usb_init_serialnumber(void)
 
 // This table provides access to all the descriptor data above.
 
+#ifdef USB_HIGHSPEED
+// config_descriptor is written for 12 Mbit/sec
+const uint8_t *usb_config_descriptor_12 = config_descriptor;
+#endif
+
 const usb_descriptor_list_t usb_descriptor_list[] = {
 	//wValue, wIndex, address,          length
 	{0x0100, 0x0000, device_descriptor, sizeof(device_descriptor)},
+#ifdef USB_HIGHSPEED
+	{0x0600, 0x0000, qualifier_descriptor, sizeof(qualifier_descriptor)},
+	{0x0200, 0x0000, usb_config_descriptor_speed, sizeof(usb_config_descriptor_speed)},
+	{0x0700, 0x0000, usb_config_descriptor_other, sizeof(usb_config_descriptor_other)},
+#else
 	{0x0200, 0x0000, config_descriptor, sizeof(config_descriptor)},
+#endif
 #ifdef SEREMU_INTERFACE
 	{0x2200, SEREMU_INTERFACE, seremu_report_desc, sizeof(seremu_report_desc)},
 	{0x2100, SEREMU_INTERFACE, config_descriptor+SEREMU_HID_DESC_OFFSET, 9},
@@ -81,7 +81,13 @@ Edit NUM_USB_BUFFERS to control how much memory the USB stack will
 allocate.  At least 2 should be used for each endpoint.  More
 memory will allow higher throughput for user programs that have
 high latency (eg, spending time doing things other than interacting
-with the USB).
+with the USB).  Up to 1024 buffers may be used.  Each receive
+endpoint may hold at most USB_ENDPOINT_BUFFER_QUOTA (default 3/4
+of NUM_USB_BUFFERS) while waiting for the user to read, so the
+other endpoints are not starved.  While a receive endpoint is waiting
+for memory, transmitting may not use the last USB_RX_BUFFER_RESERVE
+(default 1/4 of NUM_USB_BUFFERS) free buffers, so a busy transmit
+endpoint can not keep receiving stopped.
 
 Edit the ENDPOINT*_CONFIG lines so each endpoint is configured
 the proper way (transmit, receive, or both).
@@ -989,6 +995,46 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
 
 #endif
 
+// Teensy 3.6 can use its second (USBHS) port as a 480 Mbit/sec device,
+// with usbhs_dev.c instead of usb_dev.c.  Bulk endpoints use 512 byte
+// packets.  The descriptors above are written for 12 Mbit/sec, and
+// adapted at runtime to the speed the host actually uses.
+#if defined(USB_HIGHSPEED) && defined(NUM_ENDPOINTS)
+  #if !defined(__MK66FX1M0__)
+  #error "USB_HIGHSPEED requires Teensy 3.6"
+  #endif
+  #if NUM_ENDPOINTS > 7
+  #error "This USB Type uses too many endpoints for USB_HIGHSPEED (max 7)"
+  #endif
+  #if defined(AUDIO_INTERFACE)
+  #error "USB Audio is not supported with USB_HIGHSPEED"
+  #endif
+  #ifdef CDC_RX_SIZE
+    #undef CDC_RX_SIZE
+    #undef CDC_TX_SIZE
+    #define CDC_RX_SIZE		512
+    #define CDC_TX_SIZE		512
+  #endif
+  #ifdef CDC2_RX_SIZE
+    #undef CDC2_RX_SIZE
+    #undef CDC2_TX_SIZE
+    #define CDC2_RX_SIZE	512
+    #define CDC2_TX_SIZE	512
+  #endif
+  #ifdef MIDI_RX_SIZE
+    #undef MIDI_RX_SIZE
+    #undef MIDI_TX_SIZE
+    #define MIDI_RX_SIZE	512
+    #define MIDI_TX_SIZE	512
+  #endif
+  #ifdef MTP_RX_SIZE
+    #undef MTP_RX_SIZE
+    #undef MTP_TX_SIZE
+    #define MTP_RX_SIZE		512
+    #define MTP_TX_SIZE		512
+  #endif
+#endif
+
 #ifdef USB_DESC_LIST_DEFINE
 #if defined(NUM_ENDPOINTS) && NUM_ENDPOINTS > 0
 // NUM_ENDPOINTS = number of non-zero endpoints (0 to 15)
@@ -38,7 +38,7 @@
  */
 
 #include "usb_dev.h"
-#if F_CPU >= 20000000 && defined(NUM_ENDPOINTS)
+#if F_CPU >= 20000000 && defined(NUM_ENDPOINTS) && !defined(USB_HIGHSPEED)
 
 #include "kinetis.h"
 //#include "HardwareSerial.h"
@@ -247,7 +247,7 @@ static void usb_setup(void)
 #endif
 			if (epconf & USB_ENDPT_EPRXEN) {
 				usb_packet_t *p;
-				p = usb_malloc();
+				p = usb_malloc_endpoint(i);
 				if (p) {
 					table[index(i, RX, EVEN)].addr = p->buf;
 					table[index(i, RX, EVEN)].desc = BDT_DESC(64, 0);
@@ -255,7 +255,7 @@ static void usb_setup(void)
 					table[index(i, RX, EVEN)].desc = 0;
 					usb_rx_memory_needed++;
 				}
-				p = usb_malloc();
+				p = usb_malloc_endpoint(i);
 				if (p) {
 					table[index(i, RX, ODD)].addr = p->buf;
 					table[index(i, RX, ODD)].desc = BDT_DESC(64, 1);
@@ -785,11 +785,12 @@ uint32_t usb_tx_packet_count(uint32_t endpoint)
 // likely calling usb_malloc to obtain memory for transmitting.  When the
 // user is creating data very quickly, their consumption could starve reception
 // without this prioritization.  The packet buffer (input) is assigned to the
-// first endpoint needing memory.
+// first endpoint needing memory which is not already holding its quota.
+// Returns 0 if the packet was not used.
 //
-void usb_rx_memory(usb_packet_t *packet)
+int usb_rx_memory(usb_packet_t *packet)
 {
-	unsigned int i;
+	unsigned int i, starving=0;
 	const uint8_t *cfg;
 
 	cfg = usb_endpoint_config_table;
@@ -801,32 +802,36 @@ void usb_rx_memory(usb_packet_t *packet)
 #endif
 		if (*cfg++ & USB_ENDPT_EPRXEN) {
 			if (table[index(i, RX, EVEN)].desc == 0) {
+				starving = 1;
+				if (!usb_mem_claim(packet, i)) continue;
 				table[index(i, RX, EVEN)].addr = packet->buf;
 				table[index(i, RX, EVEN)].desc = BDT_DESC(64, 0);
 				usb_rx_memory_needed--;
 				__enable_irq();
 				//serial_phex(i);
 				//serial_print(",even\n");
-				return;
+				return 1;
 			}
 			if (table[index(i, RX, ODD)].desc == 0) {
+				starving = 1;
+				if (!usb_mem_claim(packet, i)) continue;
 				table[index(i, RX, ODD)].addr = packet->buf;
 				table[index(i, RX, ODD)].desc = BDT_DESC(64, 1);
 				usb_rx_memory_needed--;
 				__enable_irq();
 				//serial_phex(i);
 				//serial_print(",odd\n");
-				return;
+				return 1;
 			}
 		}
 	}
+	// If no endpoint needed memory, usb_rx_memory_needed was set
+	// greater than zero by mistake.  Otherwise, all the starving
+	// endpoints hold their quota, and will get memory when the
+	// user frees some of their packets.
+	if (!starving) usb_rx_memory_needed = 0;
 	__enable_irq();
-	// we should never reach this point.  If we get here, it means
-	// usb_rx_memory_needed was set greater than zero, but no memory
-	// was actually needed.
-	usb_rx_memory_needed = 0;
-	usb_free(packet);
-	return;
+	return 0;
 }
 
 //#define index(endpoint, tx, odd) (((endpoint) << 2) | ((tx) << 1) | (odd))
@@ -874,6 +879,53 @@ void usb_tx(uint32_t endpoint, usb_packet_t *packet)
 	__enable_irq();
 }
 
+// Transmit a list of packets linked by their next pointers, using only
+// 1 interrupt disable for all of them.
+void usb_tx_list(uint32_t endpoint, usb_packet_t *packet)
+{
+	bdt_t *b;
+	usb_packet_t *last;
+	uint8_t next;
+
+	if (endpoint - 1 >= NUM_ENDPOINTS) return;
+	__disable_irq();
+	while (packet) {
+		b = &table[index(endpoint, TX, EVEN)];
+		switch (tx_state[endpoint - 1]) {
+		  case TX_STATE_BOTH_FREE_EVEN_FIRST:
+			next = TX_STATE_ODD_FREE;
+			break;
+		  case TX_STATE_BOTH_FREE_ODD_FIRST:
+			b++;
+			next = TX_STATE_EVEN_FREE;
+			break;
+		  case TX_STATE_EVEN_FREE:
+			next = TX_STATE_NONE_FREE_ODD_FIRST;
+			break;
+		  case TX_STATE_ODD_FREE:
+			b++;
+			next = TX_STATE_NONE_FREE_EVEN_FIRST;
+			break;
+		  default:
+			// both buffers busy, queue the rest
+			for (last = packet; last->next; last = last->next) ;
+			if (tx_first[endpoint - 1] == NULL) {
+				tx_first[endpoint - 1] = packet;
+			} else {
+				tx_last[endpoint - 1]->next = packet;
+			}
+			tx_last[endpoint - 1] = last;
+			__enable_irq();
+			return;
+		}
+		tx_state[endpoint - 1] = next;
+		b->addr = packet->buf;
+		b->desc = BDT_DESC(packet->len, ((uint32_t)b & 8) ? DATA1 : DATA0);
+		packet = packet->next;
+	}
+	__enable_irq();
+}
+
 void usb_tx_isochronous(uint32_t endpoint, void *data, uint32_t len)
 {
 	bdt_t *b = &table[index(endpoint, TX, EVEN)];
@@ -898,14 +950,6 @@ void usb_tx_isochronous(uint32_t endpoint, void *data, uint32_t len)
 
 
 
-void _reboot_Teensyduino_(void)
-{
-	// TODO: initialize R0 with a code....
-	__asm__ volatile("bkpt");
-	__builtin_unreachable();
-}
-
-
 
 void usb_isr(void)
 {
@@ -1077,11 +1121,10 @@ void usb_isr(void)
 					}
 					rx_last[endpoint] = packet;
 					usb_rx_byte_count_data[endpoint] += packet->len;
-					// TODO: implement a per-endpoint maximum # of allocated
-					// packets, so a flood of incoming data on 1 endpoint
-					// doesn't starve the others if the user isn't reading
-					// it regularly
-					packet = usb_malloc();
+					// each endpoint has a maximum # of allocated packets,
+					// so a flood of incoming data on 1 endpoint doesn't
+					// starve the others if the user isn't reading it
+					packet = usb_malloc_endpoint(endpoint + 1);
 					if (packet) {
 						b->addr = packet->buf;
 						b->desc = BDT_DESC(64,
@@ -1228,10 +1271,20 @@ void usb_init(void)
 }
 
 
-#else // F_CPU < 20 MHz && defined(NUM_ENDPOINTS)
+#elif !defined(USB_HIGHSPEED) // F_CPU < 20 MHz && defined(NUM_ENDPOINTS)
 
 void usb_init(void)
 {
 }
 
 #endif // F_CPU >= 20 MHz && defined(NUM_ENDPOINTS)
+
+// used by both the full speed (usb_dev.c) and USBHS (usbhs_dev.c) drivers
+#if F_CPU >= 20000000 && defined(NUM_ENDPOINTS)
+void _reboot_Teensyduino_(void)
+{
+	// TODO: initialize R0 with a code....
+	__asm__ volatile("bkpt");
+	__builtin_unreachable();
+}
+#endif
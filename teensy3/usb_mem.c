@@ -38,32 +38,104 @@
 __attribute__ ((section(".usbbuffers"), used))
 unsigned char usb_buffer_memory[NUM_USB_BUFFERS * sizeof(usb_packet_t)];
 
-static uint32_t usb_buffer_available = 0xFFFFFFFF;
-
 // use bitmask and CLZ instruction to implement fast free list
 // http://www.archivum.info/gnu.gcc.help/2006-08/00148/Re-GCC-Inline-Assembly.html
 // http://gcc.gnu.org/ml/gcc/2012-06/msg00015.html
 // __builtin_clz()
+//
+// Each word of usb_buffer_available has 1 bit per buffer.  Another word,
+// usb_buffer_summary, has 1 bit per word with any buffers available, so
+// 2 CLZ instructions find a free buffer in pools of up to 1024.
 
-usb_packet_t * usb_malloc(void)
+#define USB_BUFFER_WORDS ((NUM_USB_BUFFERS + 31) / 32)
+#if USB_BUFFER_WORDS > 32
+#error "NUM_USB_BUFFERS can not be more than 1024"
+#endif
+
+static uint32_t usb_buffer_available[USB_BUFFER_WORDS] = {
+	[0 ... USB_BUFFER_WORDS-1] = 0xFFFFFFFF
+};
+static uint32_t usb_buffer_summary = 0xFFFFFFFF << (32 - USB_BUFFER_WORDS);
+
+// Receive endpoints may only hold a limited number of buffers, so a
+// flood of incoming data on 1 endpoint the user isn't reading can not
+// starve all the others.  usb_buffer_owner remembers which endpoint
+// each buffer was given to, or 0 for memory allocated by usb_malloc().
+#ifndef USB_ENDPOINT_BUFFER_QUOTA
+#define USB_ENDPOINT_BUFFER_QUOTA (NUM_USB_BUFFERS * 3 / 4)
+#endif
+static uint8_t usb_buffer_owner[NUM_USB_BUFFERS];
+static uint16_t usb_endpoint_quota[NUM_ENDPOINTS+1] = {
+	[0 ... NUM_ENDPOINTS] = USB_ENDPOINT_BUFFER_QUOTA
+};
+// The quota is only a limit, so transmitting could still use every free
+// buffer and leave nothing for receiving.  While a receive endpoint is
+// waiting for memory, allocations not made for a receive endpoint
+// (usb_malloc, mostly for transmit) can not take the last
+// USB_RX_BUFFER_RESERVE free buffers.  At other times all buffers are
+// available for transmit, as before.
+#ifndef USB_RX_BUFFER_RESERVE
+#define USB_RX_BUFFER_RESERVE (NUM_USB_BUFFERS / 4)
+#endif
+extern uint8_t usb_rx_memory_needed;
+static uint16_t usb_rx_reserve = USB_RX_BUFFER_RESERVE;
+static uint16_t usb_endpoint_used[NUM_ENDPOINTS+1];
+static uint16_t usb_endpoint_used_max[NUM_ENDPOINTS+1];
+static uint16_t usb_buffers_used = 0;
+static uint16_t usb_buffers_used_max = 0;
+static uint32_t usb_buffer_failures = 0;
+
+static inline void usb_claim(unsigned int n, unsigned int endpoint)
 {
-	unsigned int n, avail;
-	uint8_t *p;
+	unsigned int used;
 
-	__disable_irq();
-	avail = usb_buffer_available;
-	n = __builtin_clz(avail); // clz = count leading zeros
-	if (n >= NUM_USB_BUFFERS) {
-		__enable_irq();
-		return NULL;
+	usb_buffer_owner[n] = endpoint;
+	if (endpoint) {
+		used = ++usb_endpoint_used[endpoint];
+		if (used > usb_endpoint_used_max[endpoint]) {
+			usb_endpoint_used_max[endpoint] = used;
+		}
+	}
+}
+
+// find and claim a free buffer, called with interrupts disabled
+static int usb_alloc_index(unsigned int endpoint)
+{
+	unsigned int w, n, avail;
+
+	if (endpoint) {
+		if (usb_endpoint_used[endpoint] >= usb_endpoint_quota[endpoint]) return -1;
+	} else {
+		if (usb_rx_memory_needed
+		  && NUM_USB_BUFFERS - usb_buffers_used <= usb_rx_reserve) return -1;
 	}
+	w = __builtin_clz(usb_buffer_summary); // clz = count leading zeros
+	if (w >= USB_BUFFER_WORDS) goto fail;
+	avail = usb_buffer_available[w];
+	n = __builtin_clz(avail);
+	if (w * 32 + n >= NUM_USB_BUFFERS) goto fail;
 	//serial_print("malloc:");
 	//serial_phex(n);
 	//serial_print("\n");
 
-	usb_buffer_available = avail & ~(0x80000000 >> n);
-	__enable_irq();
-	p = usb_buffer_memory + (n * sizeof(usb_packet_t));
+	avail &= ~(0x80000000 >> n);
+	usb_buffer_available[w] = avail;
+	if (avail == 0) usb_buffer_summary &= ~(0x80000000 >> w);
+	n += w * 32;
+	usb_claim(n, endpoint);
+	if (++usb_buffers_used > usb_buffers_used_max) {
+		usb_buffers_used_max = usb_buffers_used;
+	}
+	return n;
+fail:
+	usb_buffer_failures++;
+	return -1;
+}
+
+static inline usb_packet_t * usb_packet_init(int n)
+{
+	uint8_t *p = usb_buffer_memory + (n * sizeof(usb_packet_t));
+
 	//serial_print("malloc:");
 	//serial_phex32((int)p);
 	//serial_print("\n");
@@ -72,13 +144,58 @@ usb_packet_t * usb_malloc(void)
 	return (usb_packet_t *)p;
 }
 
+static usb_packet_t * usb_alloc(unsigned int endpoint)
+{
+	int n;
+
+	__disable_irq();
+	n = usb_alloc_index(endpoint);
+	__enable_irq();
+	if (n < 0) return NULL;
+	return usb_packet_init(n);
+}
+
+usb_packet_t * usb_malloc(void)
+{
+	return usb_alloc(0);
+}
+
+// Allocate up to count packets, linked by their next pointers, or NULL
+// if none are available.  Interrupts are disabled only once.
+usb_packet_t * usb_malloc_list(uint32_t count)
+{
+	usb_packet_t *first=NULL, *p;
+	uint16_t list[8];
+	int i, n;
+
+	if (count > 8) count = 8;
+	__disable_irq();
+	for (n=0; n < (int)count; n++) {
+		i = usb_alloc_index(0);
+		if (i < 0) break;
+		list[n] = i;
+	}
+	__enable_irq();
+	while (--n >= 0) {
+		p = usb_packet_init(list[n]);
+		p->next = first;
+		first = p;
+	}
+	return first;
+}
+
+usb_packet_t * usb_malloc_endpoint(uint32_t endpoint)
+{
+	if (endpoint > NUM_ENDPOINTS) endpoint = 0;
+	return usb_alloc(endpoint);
+}
+
 // for the receive endpoints to request memory
-extern uint8_t usb_rx_memory_needed;
-extern void usb_rx_memory(usb_packet_t *packet);
+extern int usb_rx_memory(usb_packet_t *packet);
 
 void usb_free(usb_packet_t *p)
 {
-	unsigned int n, mask;
+	unsigned int n, endpoint;
 
 	//serial_print("free:");
 	n = ((uint8_t *)p - usb_buffer_memory) / sizeof(usb_packet_t);
@@ -86,19 +203,27 @@ void usb_free(usb_packet_t *p)
 	//serial_phex(n);
 	//serial_print("\n");
 
+	__disable_irq();
+	endpoint = usb_buffer_owner[n];
+	if (endpoint) {
+		usb_endpoint_used[endpoint]--;
+		usb_buffer_owner[n] = 0;
+	}
+	__enable_irq();
+
 	// if any endpoints are starving for memory to receive
 	// packets, give this memory to them immediately!
 	if (usb_rx_memory_needed && usb_configuration) {
 		//serial_print("give to rx:");
 		//serial_phex32((int)p);
 		//serial_print("\n");
-		usb_rx_memory(p);
-		return;
+		if (usb_rx_memory(p)) return;
 	}
 
-	mask = (0x80000000 >> n);
 	__disable_irq();
-	usb_buffer_available |= mask;
+	usb_buffer_available[n >> 5] |= (0x80000000 >> (n & 31));
+	usb_buffer_summary |= (0x80000000 >> (n >> 5));
+	usb_buffers_used--;
 	__enable_irq();
 
 	//serial_print("free:");
@@ -106,4 +231,62 @@ void usb_free(usb_packet_t *p)
 	//serial_print("\n");
 }
 
+// Called by usb_rx_memory with interrupts disabled, to give a buffer
+// already allocated to a receive endpoint.  Returns 0 if the endpoint
+// already holds its quota.
+int usb_mem_claim(usb_packet_t *p, uint32_t endpoint)
+{
+	unsigned int n;
+
+	n = ((uint8_t *)p - usb_buffer_memory) / sizeof(usb_packet_t);
+	if (n >= NUM_USB_BUFFERS || endpoint > NUM_ENDPOINTS) return 0;
+	if (usb_endpoint_used[endpoint] >= usb_endpoint_quota[endpoint]) return 0;
+	usb_claim(n, endpoint);
+	return 1;
+}
+
+void usb_mem_set_quota(uint32_t endpoint, uint32_t max)
+{
+	if (endpoint == 0 || endpoint > NUM_ENDPOINTS) return;
+	if (max < 2) max = 2; // at least enough for both BDT entries
+	if (max > NUM_USB_BUFFERS) max = NUM_USB_BUFFERS;
+	usb_endpoint_quota[endpoint] = max;
+}
+
+void usb_mem_set_rx_reserve(uint32_t count)
+{
+	if (count > NUM_USB_BUFFERS / 2) count = NUM_USB_BUFFERS / 2;
+	usb_rx_reserve = count;
+}
+
+void usb_mem_stats(usb_mem_stats_t *stats)
+{
+	__disable_irq();
+	stats->total = NUM_USB_BUFFERS;
+	stats->used = usb_buffers_used;
+	stats->used_max = usb_buffers_used_max;
+	stats->failures = usb_buffer_failures;
+	__enable_irq();
+}
+
+uint32_t usb_mem_endpoint_used(uint32_t endpoint, uint32_t *used_max)
+{
+	if (endpoint > NUM_ENDPOINTS) return 0;
+	if (used_max) *used_max = usb_endpoint_used_max[endpoint];
+	return usb_endpoint_used[endpoint];
+}
+
+void usb_mem_clear_stats(void)
+{
+	unsigned int i;
+
+	__disable_irq();
+	usb_buffers_used_max = usb_buffers_used;
+	usb_buffer_failures = 0;
+	for (i=0; i <= NUM_ENDPOINTS; i++) {
+		usb_endpoint_used_max[i] = usb_endpoint_used[i];
+	}
+	__enable_irq();
+}
+
 #endif // F_CPU >= 20 MHz && defined(NUM_ENDPOINTS)
@@ -33,11 +33,18 @@
 
 #include <stdint.h>
 
+// Teensy 3.6 high speed (USBHS) bulk endpoints use 512 byte packets
+#if defined(USB_HIGHSPEED)
+#define USB_PACKET_SIZE 512
+#else
+#define USB_PACKET_SIZE 64
+#endif
+
 typedef struct usb_packet_struct {
 	uint16_t len;
 	uint16_t index;
 	struct usb_packet_struct *next;
-	uint8_t buf[64];
+	uint8_t buf[USB_PACKET_SIZE];
 } usb_packet_t;
 
 #ifdef __cplusplus
@@ -45,7 +52,30 @@ extern "C" {
 #endif
 
 usb_packet_t * usb_malloc(void);
+usb_packet_t * usb_malloc_endpoint(uint32_t endpoint);
+usb_packet_t * usb_malloc_list(uint32_t count); // up to 8 packets
 void usb_free(usb_packet_t *p);
+int usb_mem_claim(usb_packet_t *p, uint32_t endpoint);
+
+// Limit the number of buffers a receive endpoint may hold while waiting
+// to be read.  The default is USB_ENDPOINT_BUFFER_QUOTA, or 3/4 of
+// NUM_USB_BUFFERS.
+void usb_mem_set_quota(uint32_t endpoint, uint32_t max);
+// While a receive endpoint is short of memory, keep this many free buffers
+// for it, which usb_malloc() and usb_malloc_list() (used for transmit) can
+// not take.  The default is USB_RX_BUFFER_RESERVE, or 1/4 of NUM_USB_BUFFERS.
+void usb_mem_set_rx_reserve(uint32_t count);
+
+typedef struct {
+	uint16_t total;     // NUM_USB_BUFFERS
+	uint16_t used;      // buffers currently allocated
+	uint16_t used_max;  // high water mark
+	uint32_t failures;  // allocations which found no free buffer
+} usb_mem_stats_t;
+void usb_mem_stats(usb_mem_stats_t *stats);
+// returns buffers held by a receive endpoint, and optionally its high water mark
+uint32_t usb_mem_endpoint_used(uint32_t endpoint, uint32_t *used_max);
+void usb_mem_clear_stats(void);
 
 #ifdef __cplusplus
 }
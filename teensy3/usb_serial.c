@@ -199,6 +199,30 @@ int usb_serial_write(const void *buffer, uint32_t size)
 
 	tx_noautoflush = 1;
 	while (size > 0) {
+		if (!tx_packet && size >= CDC_TX_SIZE && usb_configuration) {
+			// when writing whole packets, allocate and transmit
+			// several at once, to avoid the overhead of each one
+			len = usb_tx_packet_count(CDC_TX_ENDPOINT);
+			if (len < TX_PACKET_LIMIT) {
+				usb_packet_t *p, *list;
+				len = TX_PACKET_LIMIT - len;
+				if (len > size / CDC_TX_SIZE) len = size / CDC_TX_SIZE;
+				list = usb_malloc_list(len);
+				if (list) {
+					for (p = list; p; p = p->next) {
+						memcpy(p->buf, src, CDC_TX_SIZE);
+						p->len = CDC_TX_SIZE;
+						p->index = CDC_TX_SIZE;
+						src += CDC_TX_SIZE;
+						size -= CDC_TX_SIZE;
+					}
+					usb_tx_list(CDC_TX_ENDPOINT, list);
+					transmit_previous_timeout = 0;
+					usb_cdc_transmit_flush_timer = TRANSMIT_FLUSH_TIMEOUT;
+					continue;
+				}
+			}
+		}
 		if (!tx_packet) {
 			wait_count = 0;
 			while (1) {
@@ -225,7 +249,8 @@ int usb_serial_write(const void *buffer, uint32_t size)
 		dest = tx_packet->buf + tx_packet->index;
 		tx_packet->index += len;
 		size -= len;
-		while (len-- > 0) *dest++ = *src++;
+		memcpy(dest, src, len);
+		src += len;
 		if (tx_packet->index >= CDC_TX_SIZE) {
 			tx_packet->len = CDC_TX_SIZE;
 			usb_tx(CDC_TX_ENDPOINT, tx_packet);
@@ -199,6 +199,30 @@ int usb_serial2_write(const void *buffer, uint32_t size)
 
 	tx_noautoflush = 1;
 	while (size > 0) {
+		if (!tx_packet && size >= CDC2_TX_SIZE && usb_configuration) {
+			// when writing whole packets, allocate and transmit
+			// several at once, to avoid the overhead of each one
+			len = usb_tx_packet_count(CDC2_TX_ENDPOINT);
+			if (len < TX_PACKET_LIMIT) {
+				usb_packet_t *p, *list;
+				len = TX_PACKET_LIMIT - len;
+				if (len > size / CDC2_TX_SIZE) len = size / CDC2_TX_SIZE;
+				list = usb_malloc_list(len);
+				if (list) {
+					for (p = list; p; p = p->next) {
+						memcpy(p->buf, src, CDC2_TX_SIZE);
+						p->len = CDC2_TX_SIZE;
+						p->index = CDC2_TX_SIZE;
+						src += CDC2_TX_SIZE;
+						size -= CDC2_TX_SIZE;
+					}
+					usb_tx_list(CDC2_TX_ENDPOINT, list);
+					transmit_previous_timeout = 0;
+					usb_cdc2_transmit_flush_timer = TRANSMIT_FLUSH_TIMEOUT;
+					continue;
+				}
+			}
+		}
 		if (!tx_packet) {
 			wait_count = 0;
 			while (1) {
@@ -225,7 +249,8 @@ int usb_serial2_write(const void *buffer, uint32_t size)
 		dest = tx_packet->buf + tx_packet->index;
 		tx_packet->index += len;
 		size -= len;
-		while (len-- > 0) *dest++ = *src++;
+		memcpy(dest, src, len);
+		src += len;
 		if (tx_packet->index >= CDC2_TX_SIZE) {
 			tx_packet->len = CDC2_TX_SIZE;
 			usb_tx(CDC2_TX_ENDPOINT, tx_packet);
@@ -0,0 +1,967 @@
+/* Teensyduino Core Library
+ * http://www.pjrc.com/teensy/
+ * Copyright (c) 2017 PJRC.COM, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * 1. The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * 2. If the Software is incorporated into a build system that allows
+ * selection among a list of target devices, then similar target
+ * devices manufactured by PJRC.COM must be included in the list of
+ * target devices and selectable in the same manner.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* High speed (480 Mbit/sec) device driver for the USBHS port on Teensy 3.6.
+ *
+ * The USBHS controller is the same EHCI style device controller used by
+ * Teensy 4.x, so this follows teensy4/usb.c: each endpoint has a queue
+ * head, and transfers are linked lists of transfer descriptors the
+ * controller processes by DMA.  Above that, the same packet functions as
+ * usb_dev.c (usb_rx, usb_tx, usb_malloc, usb_free) are provided, so the
+ * Teensy 3 serial, MIDI, RawHID and other drivers work unchanged.  Each
+ * endpoint uses 2 transfer descriptors per direction, like the even and
+ * odd BDT entries of the full speed controller.
+ *
+ * Build with USB_HIGHSPEED defined to use this instead of usb_dev.c.
+ */
+
+#include "usb_dev.h"
+#if defined(USB_HIGHSPEED)
+#if F_CPU >= 20000000 && defined(NUM_ENDPOINTS)
+
+#include "kinetis.h"
+#include "usb_mem.h"
+#include "core_pins.h" // for delay()
+#include <string.h>
+
+typedef struct transfer_struct transfer_t;
+struct transfer_struct {
+	uint32_t next;
+	volatile uint32_t status;
+	uint32_t pointer0;
+	uint32_t pointer1;
+	uint32_t pointer2;
+	uint32_t pointer3;
+	uint32_t pointer4;
+	uint32_t callback_param;
+};
+
+typedef struct endpoint_struct endpoint_t;
+struct endpoint_struct {
+	uint32_t config;
+	uint32_t current;
+	uint32_t next;
+	uint32_t status;
+	uint32_t pointer0;
+	uint32_t pointer1;
+	uint32_t pointer2;
+	uint32_t pointer3;
+	uint32_t pointer4;
+	uint32_t reserved;
+	uint32_t setup0;
+	uint32_t setup1;
+	transfer_t *first_transfer;
+	transfer_t *last_transfer;
+	void (*callback_function)(transfer_t *completed_transfer);
+	uint32_t unused1;
+};
+
+static endpoint_t endpoint_queue_head[(NUM_ENDPOINTS+1)*2] __attribute__ ((used, aligned(2048)));
+
+#define RX 0
+#define TX 1
+// 2 transfers for each direction of each endpoint, callback_param is the
+// packet, or zero when the transfer is not in use
+static transfer_t endpoint_transfer[NUM_ENDPOINTS][2][2] __attribute__ ((aligned(32)));
+static transfer_t endpoint0_transfer_data __attribute__ ((aligned(32)));
+static transfer_t endpoint0_transfer_ack  __attribute__ ((aligned(32)));
+
+static usb_packet_t *rx_first[NUM_ENDPOINTS];
+static usb_packet_t *rx_last[NUM_ENDPOINTS];
+static usb_packet_t *tx_first[NUM_ENDPOINTS];
+static usb_packet_t *tx_last[NUM_ENDPOINTS];
+static uint16_t rx_size[NUM_ENDPOINTS]; // 0 if not receiving
+uint16_t usb_rx_byte_count_data[NUM_ENDPOINTS];
+
+typedef union {
+ struct {
+  union {
+   struct {
+	uint8_t bmRequestType;
+	uint8_t bRequest;
+   };
+	uint16_t wRequestAndType;
+  };
+	uint16_t wValue;
+	uint16_t wIndex;
+	uint16_t wLength;
+ };
+ struct {
+	uint32_t word1;
+	uint32_t word2;
+ };
+	uint64_t bothwords;
+} setup_t;
+
+static setup_t endpoint0_setupdata;
+static uint32_t endpoint0_notify_mask=0;
+static uint32_t endpointN_notify_mask=0;
+static uint8_t endpoint0_buffer[8];
+static uint8_t reply_buffer[8];
+uint8_t usb_rx_memory_needed = 0;
+
+volatile uint8_t usb_configuration = 0;
+volatile uint8_t usb_high_speed = 0;
+volatile uint8_t usb_reboot_timer = 0;
+
+extern const uint8_t *usb_config_descriptor_12;
+extern uint8_t usb_config_descriptor_speed[];
+extern uint8_t usb_config_descriptor_other[];
+extern const uint16_t usb_config_descriptor_size;
+
+static void endpoint0_setup(uint64_t setupdata);
+static void endpoint0_transmit(const void *data, uint32_t len, int notify);
+static void endpoint0_receive(void *data, uint32_t len, int notify);
+static void endpoint0_complete(void);
+static void run_callbacks(endpoint_t *ep);
+static void endpoints_stop(void);
+static void config_descriptor_for_speed(uint8_t *dst, int high_speed, uint8_t type);
+
+
+void usb_init(void)
+{
+	uint32_t count;
+
+	usb_init_serialnumber();
+	config_descriptor_for_speed(usb_config_descriptor_speed, 0, 2);
+	config_descriptor_for_speed(usb_config_descriptor_other, 1, 7);
+
+	// The PHY's PLL uses the 16 MHz crystal, and its regulator
+	MCG_C1 |= MCG_C1_IRCLKEN;
+	OSC0_CR |= OSC_ERCLKEN;
+	SIM_SOPT2 |= SIM_SOPT2_USBREGEN;
+	SIM_SOPT2 &= ~SIM_SOPT2_USBSLSRC;
+	SIM_USBPHYCTL |= SIM_USBPHYCTL_USBDISILIM;
+	SIM_SCGC3 |= SIM_SCGC3_USBHSDCD | SIM_SCGC3_USBHSPHY | SIM_SCGC3_USBHS;
+	// allow the USBHS DMA to access all RAM
+	MPU_RGDAAC0 |= 0x30000000;
+	USBHSDCD_CLOCK = 33 << 2;
+
+	USBPHY_CTRL_CLR = USBPHY_CTRL_SFTRST | USBPHY_CTRL_CLKGATE;
+	USBPHY_CTRL_SET = USBPHY_CTRL_ENUTMILEVEL2 | USBPHY_CTRL_ENUTMILEVEL3;
+	USBPHY_TRIM_OVERRIDE_EN_SET = 1;
+	USBPHY_PLL_SIC = USBPHY_PLL_SIC_PLL_POWER | USBPHY_PLL_SIC_PLL_ENABLE |
+		USBPHY_PLL_SIC_PLL_DIV_SEL(1) | USBPHY_PLL_SIC_PLL_EN_USB_CLKS;
+	for (count=0; count < 1000000; count++) {
+		if (USBPHY_PLL_SIC & USBPHY_PLL_SIC_PLL_LOCK) break;
+	}
+	USBPHY_PWD = 0;
+	delay(10);
+
+	USBHS_USBCMD |= USBHS_USBCMD_RST;
+	while (USBHS_USBCMD & USBHS_USBCMD_RST) ;
+	NVIC_CLEAR_PENDING(IRQ_USBHS);
+
+	USBHS_USBMODE = USBHS_USBMODE_CM(2) | USBHS_USBMODE_SLOM;
+	memset(endpoint_queue_head, 0, sizeof(endpoint_queue_head));
+	endpoint_queue_head[0].config = (64 << 16) | (1 << 15);
+	endpoint_queue_head[1].config = (64 << 16);
+	USBHS_EPLISTADDR = (uint32_t)&endpoint_queue_head;
+	// general purpose timer 0 gives a 1 ms tick, like the full
+	// speed controller's SOF interrupt, for flushing partial packets
+	USBHS_GPTIMER0LD = 999;
+	USBHS_GPTIMER0CTL = USBHS_GPTIMERCTL_RST | USBHS_GPTIMERCTL_RUN |
+		USBHS_GPTIMERCTL_MODE;
+	USBHS_USBINTR = USBHS_USBINTR_UE | USBHS_USBINTR_UEE | USBHS_USBINTR_PCE |
+		USBHS_USBINTR_URE | USBHS_USBINTR_SLE | USBHS_USBINTR_TIE0;
+	attachInterruptVector(IRQ_USBHS, usb_isr);
+	NVIC_SET_PRIORITY(IRQ_USBHS, 112);
+	NVIC_ENABLE_IRQ(IRQ_USBHS);
+	USBHS_USBCMD = USBHS_USBCMD_RS;
+}
+
+
+// _reboot_Teensyduino_() is shared with the full speed driver, in usb_dev.c
+
+
+// Called every 1 ms by the USBHS timer
+static void usb_timer(void)
+{
+	uint8_t t;
+
+	if (!usb_configuration) return;
+	t = usb_reboot_timer;
+	if (t) {
+		usb_reboot_timer = --t;
+		if (!t) _reboot_Teensyduino_();
+	}
+#ifdef CDC_DATA_INTERFACE
+	t = usb_cdc_transmit_flush_timer;
+	if (t) {
+		usb_cdc_transmit_flush_timer = --t;
+		if (t == 0) usb_serial_flush_callback();
+	}
+#endif
+#ifdef CDC2_DATA_INTERFACE
+	t = usb_cdc2_transmit_flush_timer;
+	if (t) {
+		usb_cdc2_transmit_flush_timer = --t;
+		if (t == 0) usb_serial2_flush_callback();
+	}
+#endif
+#ifdef CDC3_DATA_INTERFACE
+	t = usb_cdc3_transmit_flush_timer;
+	if (t) {
+		usb_cdc3_transmit_flush_timer = --t;
+		if (t == 0) usb_serial3_flush_callback();
+	}
+#endif
+#ifdef SEREMU_INTERFACE
+	t = usb_seremu_transmit_flush_timer;
+	if (t) {
+		usb_seremu_transmit_flush_timer = --t;
+		if (t == 0) usb_seremu_flush_callback();
+	}
+#endif
+#ifdef MIDI_INTERFACE
+	usb_midi_flush_output();
+#endif
+#ifdef FLIGHTSIM_INTERFACE
+	usb_flightsim_flush_callback();
+#endif
+#ifdef MULTITOUCH_INTERFACE
+	usb_touchscreen_update_callback();
+#endif
+}
+
+
+void usb_isr(void)
+{
+	uint32_t status = USBHS_USBSTS;
+	USBHS_USBSTS = status;
+
+	if (status & USBHS_USBSTS_UI) {
+		uint32_t setupstatus = USBHS_EPSETUPSR;
+		while (setupstatus) {
+			USBHS_EPSETUPSR = setupstatus;
+			setup_t s;
+			do {
+				USBHS_USBCMD |= USBHS_USBCMD_SUTW;
+				s.word1 = endpoint_queue_head[0].setup0;
+				s.word2 = endpoint_queue_head[0].setup1;
+			} while (!(USBHS_USBCMD & USBHS_USBCMD_SUTW));
+			USBHS_USBCMD &= ~USBHS_USBCMD_SUTW;
+			USBHS_EPFLUSH = (1<<16) | (1<<0);
+			while (USBHS_EPFLUSH & ((1<<16) | (1<<0))) ;
+			endpoint0_notify_mask = 0;
+			endpoint0_setup(s.bothwords);
+			setupstatus = USBHS_EPSETUPSR;
+		}
+		uint32_t completestatus = USBHS_EPCOMPLETE;
+		if (completestatus) {
+			USBHS_EPCOMPLETE = completestatus;
+			if (completestatus & endpoint0_notify_mask) {
+				endpoint0_notify_mask = 0;
+				endpoint0_complete();
+			}
+			completestatus &= endpointN_notify_mask;
+			uint32_t tx = completestatus >> 16;
+			while (tx) {
+				int p = __builtin_ctz(tx);
+				run_callbacks(endpoint_queue_head + p * 2 + 1);
+				tx &= ~(1 << p);
+			}
+			uint32_t rx = completestatus & 0xFFFF;
+			while (rx) {
+				int p = __builtin_ctz(rx);
+				run_callbacks(endpoint_queue_head + p * 2);
+				rx &= ~(1 << p);
+			}
+		}
+	}
+	if (status & USBHS_USBSTS_URI) {
+		USBHS_EPSETUPSR = USBHS_EPSETUPSR;
+		USBHS_EPCOMPLETE = USBHS_EPCOMPLETE;
+		while (USBHS_EPPRIME != 0) ;
+		USBHS_EPFLUSH = 0xFFFFFFFF;
+		usb_configuration = 0;
+		endpoints_stop();
+	}
+	if (status & USBHS_USBSTS_PCI) {
+		// the connection speed is known after reset, so the
+		// descriptors can be made for the speed in use
+		usb_high_speed = (USBHS_PORTSC1 & USBHS_PORTSC_HSP) ? 1 : 0;
+		config_descriptor_for_speed(usb_config_descriptor_speed, usb_high_speed, 2);
+		config_descriptor_for_speed(usb_config_descriptor_other, !usb_high_speed, 7);
+	}
+	if (status & USBHS_USBSTS_TI0) {
+		usb_timer();
+	}
+}
+
+
+// The descriptors in usb_desc.c are written for 12 Mbit/sec.  At
+// 480 Mbit/sec, bulk endpoints must use 512 byte packets and interrupt
+// endpoint bInterval is 2^(n-1) microframes instead of milliseconds.
+static void config_descriptor_for_speed(uint8_t *dst, int high_speed, uint8_t type)
+{
+	uint32_t i, len, size, ms, n;
+	uint8_t *d;
+
+	len = usb_config_descriptor_size;
+	memcpy(dst, usb_config_descriptor_12, len);
+	dst[1] = type;
+	for (i=0; i + 7 <= len && dst[i] > 0; i += dst[i]) {
+		d = dst + i;
+		if (d[1] != 5) continue; // only endpoint descriptors change
+		switch (d[3] & 3) {
+		  case 2: // bulk
+			size = d[4] | (d[5] << 8);
+			if (high_speed) {
+				size = 512;
+			} else if (size > 64) {
+				size = 64;
+			}
+			d[4] = size;
+			d[5] = size >> 8;
+			break;
+		  case 3: // interrupt
+			if (high_speed) {
+				ms = d[6];
+				for (n=4; ms > 1 && n < 16; n++) ms >>= 1;
+				d[6] = n;
+			}
+			break;
+		}
+	}
+}
+
+
+static void endpoint0_transmit(const void *data, uint32_t len, int notify)
+{
+	if (len > 0) {
+		endpoint0_transfer_data.next = 1;
+		endpoint0_transfer_data.status = (len << 16) | (1<<7);
+		uint32_t addr = (uint32_t)data;
+		endpoint0_transfer_data.pointer0 = addr;
+		endpoint0_transfer_data.pointer1 = addr + 4096;
+		endpoint0_transfer_data.pointer2 = addr + 8192;
+		endpoint0_transfer_data.pointer3 = addr + 12288;
+		endpoint0_transfer_data.pointer4 = addr + 16384;
+		endpoint_queue_head[1].next = (uint32_t)&endpoint0_transfer_data;
+		endpoint_queue_head[1].status = 0;
+		USBHS_EPPRIME |= (1<<16);
+		while (USBHS_EPPRIME) ;
+	}
+	endpoint0_transfer_ack.next = 1;
+	endpoint0_transfer_ack.status = (1<<7) | (notify ? (1 << 15) : 0);
+	endpoint0_transfer_ack.pointer0 = 0;
+	endpoint_queue_head[0].next = (uint32_t)&endpoint0_transfer_ack;
+	endpoint_queue_head[0].status = 0;
+	USBHS_EPCOMPLETE = (1<<0) | (1<<16);
+	USBHS_EPPRIME |= (1<<0);
+	endpoint0_notify_mask = (notify ? (1 << 0) : 0);
+	while (USBHS_EPPRIME) ;
+}
+
+static void endpoint0_receive(void *data, uint32_t len, int notify)
+{
+	if (len > 0) {
+		endpoint0_transfer_data.next = 1;
+		endpoint0_transfer_data.status = (len << 16) | (1<<7);
+		uint32_t addr = (uint32_t)data;
+		endpoint0_transfer_data.pointer0 = addr;
+		endpoint0_transfer_data.pointer1 = addr + 4096;
+		endpoint0_transfer_data.pointer2 = addr + 8192;
+		endpoint0_transfer_data.pointer3 = addr + 12288;
+		endpoint0_transfer_data.pointer4 = addr + 16384;
+		endpoint_queue_head[0].next = (uint32_t)&endpoint0_transfer_data;
+		endpoint_queue_head[0].status = 0;
+		USBHS_EPPRIME |= (1<<0);
+		while (USBHS_EPPRIME) ;
+	}
+	endpoint0_transfer_ack.next = 1;
+	endpoint0_transfer_ack.status = (1<<7) | (notify ? (1 << 15) : 0);
+	endpoint0_transfer_ack.pointer0 = 0;
+	endpoint_queue_head[1].next = (uint32_t)&endpoint0_transfer_ack;
+	endpoint_queue_head[1].status = 0;
+	USBHS_EPCOMPLETE = (1<<0) | (1<<16);
+	USBHS_EPPRIME |= (1<<16);
+	endpoint0_notify_mask = (notify ? (1 << 16) : 0);
+	while (USBHS_EPPRIME) ;
+}
+
+static void endpoints_configure(void);
+
+static void endpoint0_setup(uint64_t setupdata)
+{
+	setup_t setup;
+	uint32_t endpoint, dir, ctrl;
+	const usb_descriptor_list_t *list;
+
+	setup.bothwords = setupdata;
+	switch (setup.wRequestAndType) {
+	  case 0x0500: // SET_ADDRESS
+		endpoint0_receive(NULL, 0, 0);
+		USBHS_DEVICEADDR = USBHS_DEVICEADDR_USBADR(setup.wValue) | USBHS_DEVICEADDR_USBADRA;
+		return;
+	  case 0x0900: // SET_CONFIGURATION
+		usb_configuration = setup.wValue;
+		endpoints_configure();
+		endpoint0_receive(NULL, 0, 0);
+		return;
+	  case 0x0880: // GET_CONFIGURATION
+		reply_buffer[0] = usb_configuration;
+		endpoint0_transmit(reply_buffer, 1, 0);
+		return;
+	  case 0x0080: // GET_STATUS (device)
+		reply_buffer[0] = 0;
+		reply_buffer[1] = 0;
+		endpoint0_transmit(reply_buffer, 2, 0);
+		return;
+	  case 0x0082: // GET_STATUS (endpoint)
+		endpoint = setup.wIndex & 0x7F;
+		if (endpoint > NUM_ENDPOINTS) break;
+		dir = setup.wIndex & 0x80;
+		ctrl = (&USBHS_EPCR0)[endpoint];
+		reply_buffer[0] = 0;
+		reply_buffer[1] = 0;
+		if ((dir && (ctrl & USBHS_EPCR_TXS)) || (!dir && (ctrl & USBHS_EPCR_RXS))) {
+			reply_buffer[0] = 1;
+		}
+		endpoint0_transmit(reply_buffer, 2, 0);
+		return;
+	  case 0x0302: // SET_FEATURE (endpoint)
+		endpoint = setup.wIndex & 0x7F;
+		if (endpoint > NUM_ENDPOINTS) break;
+		dir = setup.wIndex & 0x80;
+		if (dir) {
+			(&USBHS_EPCR0)[endpoint] |= USBHS_EPCR_TXS;
+		} else {
+			(&USBHS_EPCR0)[endpoint] |= USBHS_EPCR_RXS;
+		}
+		endpoint0_receive(NULL, 0, 0);
+		return;
+	  case 0x0102: // CLEAR_FEATURE (endpoint)
+		endpoint = setup.wIndex & 0x7F;
+		if (endpoint > NUM_ENDPOINTS) break;
+		dir = setup.wIndex & 0x80;
+		// clearing halt also resets the data toggle to DATA0
+		if (dir) {
+			(&USBHS_EPCR0)[endpoint] = ((&USBHS_EPCR0)[endpoint]
+				& ~USBHS_EPCR_TXS) | USBHS_EPCR_TXR;
+		} else {
+			(&USBHS_EPCR0)[endpoint] = ((&USBHS_EPCR0)[endpoint]
+				& ~USBHS_EPCR_RXS) | USBHS_EPCR_RXR;
+		}
+		endpoint0_receive(NULL, 0, 0);
+		return;
+	  case 0x0680: // GET_DESCRIPTOR
+	  case 0x0681:
+		for (list = usb_descriptor_list; list->addr != NULL; list++) {
+			if (setup.wValue == list->wValue && setup.wIndex == list->wIndex) {
+				uint32_t datalen;
+				if ((setup.wValue >> 8) == 3) {
+					// for string descriptors, use the descriptor's
+					// length field, allowing runtime configured length.
+					datalen = *(list->addr);
+				} else {
+					datalen = list->length;
+				}
+				if (datalen > setup.wLength) datalen = setup.wLength;
+				// descriptors are in RAM, so the DMA can read them
+				endpoint0_transmit(list->addr, datalen, 0);
+				return;
+			}
+		}
+		break;
+#if defined(CDC_STATUS_INTERFACE)
+	  case 0x2221: // CDC_SET_CONTROL_LINE_STATE
+		#ifdef CDC_STATUS_INTERFACE
+		if (setup.wIndex == CDC_STATUS_INTERFACE) {
+			usb_cdc_line_rtsdtr_millis = systick_millis_count;
+			usb_cdc_line_rtsdtr = setup.wValue;
+		}
+		#endif
+		#ifdef CDC2_STATUS_INTERFACE
+		if (setup.wIndex == CDC2_STATUS_INTERFACE) {
+			usb_cdc2_line_rtsdtr_millis = systick_millis_count;
+			usb_cdc2_line_rtsdtr = setup.wValue;
+		}
+		#endif
+		#ifdef CDC3_STATUS_INTERFACE
+		if (setup.wIndex == CDC3_STATUS_INTERFACE) {
+			usb_cdc3_line_rtsdtr_millis = systick_millis_count;
+			usb_cdc3_line_rtsdtr = setup.wValue;
+		}
+		#endif
+		__attribute__((fallthrough));
+		// fall through to next case, to always send ZLP ACK
+	  case 0x2321: // CDC_SEND_BREAK
+		endpoint0_receive(NULL, 0, 0);
+		return;
+	  case 0x2021: // CDC_SET_LINE_CODING
+		if (setup.wLength != 7) break;
+		endpoint0_setupdata.bothwords = setupdata;
+		endpoint0_receive(endpoint0_buffer, 7, 1);
+		return;
+#endif
+#if defined(SEREMU_INTERFACE) || defined(KEYBOARD_INTERFACE)
+	  case 0x0921: // HID SET_REPORT
+		if (setup.wLength <= sizeof(endpoint0_buffer)) {
+			endpoint0_setupdata.bothwords = setupdata;
+			endpoint0_buffer[0] = 0xE9;
+			endpoint0_receive(endpoint0_buffer, setup.wLength, 1);
+			return;
+		}
+		break;
+	  case 0x0A21: // HID SET_IDLE
+		endpoint0_receive(NULL, 0, 0);
+		return;
+#endif
+#if defined(MULTITOUCH_INTERFACE)
+	  case 0x01A1:
+		if (setup.wValue == 0x0300 && setup.wIndex == MULTITOUCH_INTERFACE) {
+			reply_buffer[0] = MULTITOUCH_FINGERS;
+			endpoint0_transmit(reply_buffer, 1, 0);
+			return;
+		} else if (setup.wValue == 0x0100 && setup.wIndex == MULTITOUCH_INTERFACE) {
+			memset(reply_buffer, 0, 8);
+			endpoint0_transmit(reply_buffer, 8, 0);
+			return;
+		}
+		break;
+#endif
+#if defined(MTP_INTERFACE)
+	  case 0x67A1: // Get Device Status (PTP spec, 5.2.4, page 10)
+		// For now, always respond with status ok.
+		reply_buffer[0] = 0x4;
+		reply_buffer[1] = 0;
+		reply_buffer[2] = 0x01;
+		reply_buffer[3] = 0x20;
+		endpoint0_transmit(reply_buffer, 4, 0);
+		return;
+#endif
+	}
+	USBHS_EPCR0 = 0x000010001; // stall
+}
+
+static void endpoint0_complete(void)
+{
+	setup_t setup;
+
+	setup.bothwords = endpoint0_setupdata.bothwords;
+#ifdef CDC_STATUS_INTERFACE
+	// 0x2021 is CDC_SET_LINE_CODING
+	if (setup.wRequestAndType == 0x2021 && setup.wIndex == CDC_STATUS_INTERFACE) {
+		memcpy(usb_cdc_line_coding, endpoint0_buffer, 7);
+		if (usb_cdc_line_coding[0] == 134) usb_reboot_timer = 15;
+	}
+#endif
+#ifdef CDC2_STATUS_INTERFACE
+	if (setup.wRequestAndType == 0x2021 && setup.wIndex == CDC2_STATUS_INTERFACE) {
+		memcpy(usb_cdc2_line_coding, endpoint0_buffer, 7);
+		if (usb_cdc2_line_coding[0] == 134) usb_reboot_timer = 15;
+	}
+#endif
+#ifdef CDC3_STATUS_INTERFACE
+	if (setup.wRequestAndType == 0x2021 && setup.wIndex == CDC3_STATUS_INTERFACE) {
+		memcpy(usb_cdc3_line_coding, endpoint0_buffer, 7);
+		if (usb_cdc3_line_coding[0] == 134) usb_reboot_timer = 15;
+	}
+#endif
+#ifdef KEYBOARD_INTERFACE
+	if (setup.word1 == 0x02000921 && setup.word2 == ((1 << 16) | KEYBOARD_INTERFACE)) {
+		keyboard_leds = endpoint0_buffer[0];
+	}
+#endif
+#ifdef SEREMU_INTERFACE
+	if (setup.word1 == 0x03000921 && setup.word2 == ((4<<16)|SEREMU_INTERFACE)) {
+		if (endpoint0_buffer[0] == 0xA9 && endpoint0_buffer[1] == 0x45
+		  && endpoint0_buffer[2] == 0xC2 && endpoint0_buffer[3] == 0x6B) {
+			usb_reboot_timer = 5;
+		} else {
+			// any other feature report means Arduino Serial Monitor is open
+			usb_seremu_online = 1;
+		}
+	}
+#endif
+}
+
+
+static void usb_prepare_transfer(transfer_t *transfer, const void *data, uint32_t len, uint32_t param)
+{
+	transfer->next = 1;
+	transfer->status = (len << 16) | (1<<7);
+	uint32_t addr = (uint32_t)data;
+	transfer->pointer0 = addr;
+	transfer->pointer1 = addr + 4096;
+	transfer->pointer2 = addr + 8192;
+	transfer->pointer3 = addr + 12288;
+	transfer->pointer4 = addr + 16384;
+	transfer->callback_param = param;
+}
+
+// add a transfer to an endpoint's list, called with interrupts disabled
+static void schedule_transfer(endpoint_t *endpoint, uint32_t epmask, transfer_t *transfer)
+{
+	if (endpoint->callback_function) {
+		transfer->status |= (1<<15);
+	}
+	transfer_t *last = endpoint->last_transfer;
+	if (last) {
+		last->next = (uint32_t)transfer;
+		if (USBHS_EPPRIME & epmask) goto end;
+		uint32_t status, count=0;
+		do {
+			USBHS_USBCMD |= USBHS_USBCMD_ATDTW;
+			status = USBHS_EPSR;
+		} while (!(USBHS_USBCMD & USBHS_USBCMD_ATDTW) && ++count < 1000);
+		if (status & epmask) goto end;
+		endpoint->next = (uint32_t)transfer;
+		endpoint->status = 0;
+		USBHS_EPPRIME |= epmask;
+		goto end;
+	}
+	endpoint->next = (uint32_t)transfer;
+	endpoint->status = 0;
+	USBHS_EPPRIME |= epmask;
+	endpoint->first_transfer = transfer;
+end:
+	endpoint->last_transfer = transfer;
+}
+
+static void run_callbacks(endpoint_t *ep)
+{
+	transfer_t *first = ep->first_transfer;
+	if (first == NULL) return;
+
+	// count how many transfers are completed, then remove them from the endpoint's list
+	uint32_t count = 0;
+	transfer_t *t = first;
+	while (1) {
+		if (t->status & (1<<7)) {
+			// found a still-active transfer, new list begins here
+			ep->first_transfer = t;
+			break;
+		}
+		count++;
+		t = (transfer_t *)t->next;
+		if ((uint32_t)t == 1) {
+			// reached end of list, all need callbacks, new list is empty
+			ep->first_transfer = NULL;
+			ep->last_transfer = NULL;
+			break;
+		}
+	}
+	// do all the callbacks
+	while (count) {
+		transfer_t *next = (transfer_t *)first->next;
+		ep->callback_function(first);
+		first = next;
+		count--;
+	}
+}
+
+
+static void rx_start(uint32_t endpoint, transfer_t *t, usb_packet_t *packet)
+{
+	usb_prepare_transfer(t, packet->buf, rx_size[endpoint - 1], (uint32_t)packet);
+	schedule_transfer(endpoint_queue_head + endpoint * 2, 1 << endpoint, t);
+}
+
+static void tx_start(uint32_t endpoint, transfer_t *t, usb_packet_t *packet)
+{
+	usb_prepare_transfer(t, packet->buf, packet->len, (uint32_t)packet);
+	schedule_transfer(endpoint_queue_head + endpoint * 2 + 1, 1 << (endpoint + 16), t);
+}
+
+static void rx_complete(transfer_t *t)
+{
+	uint32_t i = (t - &endpoint_transfer[0][0][0]) >> 2; // endpoint - 1
+	usb_packet_t *packet = (usb_packet_t *)t->callback_param;
+	uint32_t status = t->status;
+	uint32_t len = 0;
+
+	// halted, data buffer or transaction error, reuse the packet
+	if (!(status & 0x68)) len = rx_size[i] - ((status >> 16) & 0x7FFF);
+	if (len > 0) {
+		packet->len = len;
+		packet->index = 0;
+		packet->next = NULL;
+		__disable_irq();
+		if (rx_first[i] == NULL) {
+			rx_first[i] = packet;
+		} else {
+			rx_last[i]->next = packet;
+		}
+		rx_last[i] = packet;
+		usb_rx_byte_count_data[i] += len;
+		__enable_irq();
+		// each endpoint has a maximum # of allocated packets
+		packet = usb_malloc_endpoint(i + 1);
+	}
+	__disable_irq();
+	if (packet) {
+		rx_start(i + 1, t, packet);
+	} else {
+		t->callback_param = 0;
+		usb_rx_memory_needed++;
+	}
+	__enable_irq();
+}
+
+static void tx_complete(transfer_t *t)
+{
+	uint32_t i = (t - &endpoint_transfer[0][0][0]) >> 2; // endpoint - 1
+	usb_packet_t *packet;
+
+	usb_free((usb_packet_t *)t->callback_param);
+	__disable_irq();
+	t->callback_param = 0;
+	packet = tx_first[i];
+	if (packet) {
+		tx_first[i] = packet->next;
+		tx_start(i + 1, t, packet);
+	}
+	__enable_irq();
+}
+
+
+// Flush all non-zero endpoints and free all their memory
+static void endpoints_stop(void)
+{
+	uint32_t i, j;
+	usb_packet_t *p, *n;
+	transfer_t *t;
+
+	USBHS_EPFLUSH = 0xFFFEFFFE;
+	while (USBHS_EPFLUSH) ;
+	endpointN_notify_mask = 0;
+	usb_rx_memory_needed = 0;
+	for (i=0; i < NUM_ENDPOINTS; i++) {
+		rx_size[i] = 0;
+		(&USBHS_EPCR0)[i + 1] = 0;
+	}
+	for (i=0; i < NUM_ENDPOINTS; i++) {
+		for (j=0; j < 4; j++) {
+			t = &endpoint_transfer[i][j >> 1][j & 1];
+			if (t->callback_param) {
+				usb_free((usb_packet_t *)t->callback_param);
+				t->callback_param = 0;
+			}
+		}
+		p = rx_first[i];
+		while (p) {
+			n = p->next;
+			usb_free(p);
+			p = n;
+		}
+		rx_first[i] = NULL;
+		rx_last[i] = NULL;
+		p = tx_first[i];
+		while (p) {
+			n = p->next;
+			usb_free(p);
+			p = n;
+		}
+		tx_first[i] = NULL;
+		tx_last[i] = NULL;
+		usb_rx_byte_count_data[i] = 0;
+	}
+	memset(endpoint_queue_head + 2, 0, sizeof(endpoint_t) * NUM_ENDPOINTS * 2);
+}
+
+static void endpoint_config(endpoint_t *qh, uint32_t size, void (*callback)(transfer_t *))
+{
+	memset(qh, 0, sizeof(endpoint_t));
+	qh->config = (size << 16) | (1 << 29); // no automatic zero length packets
+	qh->next = 1; // Terminate bit = 1
+	qh->callback_function = callback;
+}
+
+// Configure the endpoints from the configuration descriptor, which has
+// each endpoint's type and packet size for the speed in use.
+static void endpoints_configure(void)
+{
+	uint32_t epcr[NUM_ENDPOINTS+1];
+	uint32_t i, len, n, type, size;
+	const uint8_t *d;
+	usb_packet_t *p;
+
+	endpoints_stop();
+	for (n=1; n <= NUM_ENDPOINTS; n++) {
+		// an unused direction must not be left as control type
+		epcr[n] = USBHS_EPCR_TXT(2) | USBHS_EPCR_RXT(2);
+	}
+	len = usb_config_descriptor_size;
+	for (i=0; i + 7 <= len && usb_config_descriptor_speed[i] > 0;
+	  i += usb_config_descriptor_speed[i]) {
+		d = usb_config_descriptor_speed + i;
+		if (d[1] != 5) continue;
+		n = d[2] & 0x0F;
+		if (n == 0 || n > NUM_ENDPOINTS) continue;
+		type = d[3] & 3;
+		size = d[4] | ((d[5] & 7) << 8);
+		if (size > USB_PACKET_SIZE) size = USB_PACKET_SIZE;
+		if (d[2] & 0x80) {
+			endpoint_config(endpoint_queue_head + n * 2 + 1, size, tx_complete);
+			epcr[n] = (epcr[n] & ~USBHS_EPCR_TXT(3)) | USBHS_EPCR_TXE
+				| USBHS_EPCR_TXR | USBHS_EPCR_TXT(type);
+			endpointN_notify_mask |= (1 << (n + 16));
+		} else {
+			endpoint_config(endpoint_queue_head + n * 2, size, rx_complete);
+			epcr[n] = (epcr[n] & ~USBHS_EPCR_RXT(3)) | USBHS_EPCR_RXE
+				| USBHS_EPCR_RXR | USBHS_EPCR_RXT(type);
+			endpointN_notify_mask |= (1 << n);
+			rx_size[n - 1] = size;
+		}
+	}
+	for (n=1; n <= NUM_ENDPOINTS; n++) {
+		(&USBHS_EPCR0)[n] = epcr[n];
+		if (!rx_size[n - 1]) continue;
+		for (i=0; i < 2; i++) {
+			p = usb_malloc_endpoint(n);
+			if (p) {
+				rx_start(n, &endpoint_transfer[n - 1][RX][i], p);
+			} else {
+				usb_rx_memory_needed++;
+			}
+		}
+	}
+}
+
+
+usb_packet_t *usb_rx(uint32_t endpoint)
+{
+	usb_packet_t *ret;
+	endpoint--;
+	if (endpoint >= NUM_ENDPOINTS) return NULL;
+	__disable_irq();
+	ret = rx_first[endpoint];
+	if (ret) {
+		rx_first[endpoint] = ret->next;
+		usb_rx_byte_count_data[endpoint] -= ret->len;
+	}
+	__enable_irq();
+	return ret;
+}
+
+uint32_t usb_tx_byte_count(uint32_t endpoint)
+{
+	const usb_packet_t *p;
+	uint32_t count=0;
+
+	endpoint--;
+	if (endpoint >= NUM_ENDPOINTS) return 0;
+	__disable_irq();
+	for (p = tx_first[endpoint]; p; p = p->next) count += p->len;
+	__enable_irq();
+	return count;
+}
+
+uint32_t usb_tx_packet_count(uint32_t endpoint)
+{
+	const usb_packet_t *p;
+	uint32_t count=0;
+
+	endpoint--;
+	if (endpoint >= NUM_ENDPOINTS) return 0;
+	__disable_irq();
+	for (p = tx_first[endpoint]; p; p = p->next) count++;
+	__enable_irq();
+	return count;
+}
+
+// Called from usb_free when receive endpoints are starving for memory.
+// The packet is given to the first endpoint needing memory which is not
+// already holding its quota.  Returns 0 if the packet was not used.
+int usb_rx_memory(usb_packet_t *packet)
+{
+	unsigned int i, j, starving=0;
+	transfer_t *t;
+
+	__disable_irq();
+	for (i=1; i <= NUM_ENDPOINTS; i++) {
+		if (!rx_size[i - 1]) continue;
+		for (j=0; j < 2; j++) {
+			t = &endpoint_transfer[i - 1][RX][j];
+			if (t->callback_param) continue;
+			starving = 1;
+			if (!usb_mem_claim(packet, i)) break;
+			rx_start(i, t, packet);
+			usb_rx_memory_needed--;
+			__enable_irq();
+			return 1;
+		}
+	}
+	if (!starving) usb_rx_memory_needed = 0;
+	__enable_irq();
+	return 0;
+}
+
+void usb_tx(uint32_t endpoint, usb_packet_t *packet)
+{
+	packet->next = NULL;
+	usb_tx_list(endpoint, packet);
+}
+
+void usb_tx_list(uint32_t endpoint, usb_packet_t *packet)
+{
+	transfer_t *t;
+	usb_packet_t *last;
+
+	if (endpoint - 1 >= NUM_ENDPOINTS) return;
+	__disable_irq();
+	// use an idle transfer, only if none are waiting
+	while (packet && tx_first[endpoint - 1] == NULL) {
+		t = &endpoint_transfer[endpoint - 1][TX][0];
+		if (t->callback_param) t++;
+		if (t->callback_param) break;
+		last = packet->next;
+		tx_start(endpoint, t, packet);
+		packet = last;
+	}
+	if (packet) {
+		for (last = packet; last->next; last = last->next) ;
+		if (tx_first[endpoint - 1] == NULL) {
+			tx_first[endpoint - 1] = packet;
+		} else {
+			tx_last[endpoint - 1]->next = packet;
+		}
+		tx_last[endpoint - 1] = last;
+	}
+	__enable_irq();
+}
+
+// usb_tx_isochronous() is not provided, USB Audio can not be used here
+#if defined(AUDIO_INTERFACE)
+#error "USB Audio is not supported with USB_HIGHSPEED"
+#endif
+
+
+#else // F_CPU < 20 MHz && defined(NUM_ENDPOINTS)
+
+void usb_init(void)
+{
+}
+
+#endif // F_CPU >= 20 MHz && defined(NUM_ENDPOINTS)
+#endif // USB_HIGHSPEED
@@ -37,15 +37,22 @@
 #endif
 
 #define NUM_MASKS  (((MAX_AUDIO_MEMORY / AUDIO_BLOCK_SAMPLES / 2) + 31) / 32)
+#define NUM_F32_MASKS  (((MAX_AUDIO_MEMORY / AUDIO_BLOCK_SAMPLES / 4) + 31) / 32)
 
 audio_block_t * AudioStream::memory_pool;
 uint32_t AudioStream::memory_pool_available_mask[NUM_MASKS];
 uint16_t AudioStream::memory_pool_first_mask;
 
+audio_block_f32_t * AudioStream::f32_memory_pool;
+uint32_t AudioStream::f32_memory_pool_available_mask[NUM_F32_MASKS];
+uint16_t AudioStream::f32_memory_pool_first_mask;
+
 uint16_t AudioStream::cpu_cycles_total = 0;
 uint16_t AudioStream::cpu_cycles_total_max = 0;
 uint16_t AudioStream::memory_used = 0;
 uint16_t AudioStream::memory_used_max = 0;
+uint16_t AudioStream::f32_memory_used = 0;
+uint16_t AudioStream::f32_memory_used_max = 0;
 AudioConnection* AudioStream::unused = NULL; // linked list of unused but not destructed connections
 
 void software_isr(void);
@@ -86,6 +93,37 @@ FLASHMEM void AudioStream::initialize_memory(audio_block_t *data, unsigned int n
 	__enable_irq();
 }
 
+// Set up the pool of floating point audio blocks
+FLASHMEM void AudioStream::initialize_f32_memory(audio_block_f32_t *data, unsigned int num)
+{
+	unsigned int i;
+	unsigned int maxnum = MAX_AUDIO_MEMORY / AUDIO_BLOCK_SAMPLES / 4;
+
+	if (num > maxnum) num = maxnum;
+	__disable_irq();
+	f32_memory_pool = data;
+	f32_memory_pool_first_mask = 0;
+	for (i=0; i < NUM_F32_MASKS; i++) {
+		f32_memory_pool_available_mask[i] = 0;
+	}
+	for (i=0; i < num; i++) {
+		f32_memory_pool_available_mask[i >> 5] |= (1 << (i & 0x1F));
+	}
+	for (i=0; i < num; i++) {
+		data[i].memory_pool_index = i;
+	}
+	if (update_scheduled == false) {
+		// same as initialize_memory(), in case only float blocks are used
+		IntervalTimer *timer = new IntervalTimer();
+		if (timer) {
+			float usec = 1e6 * AUDIO_BLOCK_SAMPLES / AUDIO_SAMPLE_RATE_EXACT;
+			timer->begin(update_all, usec);
+			update_setup();
+		}
+	}
+	__enable_irq();
+}
+
 // Allocate 1 audio data block.  If successful
 // the caller is the only owner of this new block
 audio_block_t * AudioStream::allocate(void)
@@ -150,6 +188,61 @@ void AudioStream::release(audio_block_t *block)
 	__enable_irq();
 }
 
+// Allocate 1 floating point audio block
+audio_block_f32_t * AudioStream::allocate_f32(void)
+{
+	uint32_t n, index, avail;
+	uint32_t *p, *end;
+	audio_block_f32_t *block;
+	uint32_t used;
+
+	p = f32_memory_pool_available_mask;
+	end = p + NUM_F32_MASKS;
+	__disable_irq();
+	index = f32_memory_pool_first_mask;
+	p += index;
+	while (1) {
+		if (p >= end) {
+			__enable_irq();
+			return NULL;
+		}
+		avail = *p;
+		if (avail) break;
+		index++;
+		p++;
+	}
+	n = __builtin_clz(avail);
+	avail &= ~(0x80000000 >> n);
+	*p = avail;
+	if (!avail) index++;
+	f32_memory_pool_first_mask = index;
+	used = f32_memory_used + 1;
+	f32_memory_used = used;
+	__enable_irq();
+	index = p - f32_memory_pool_available_mask;
+	block = f32_memory_pool + ((index << 5) + (31 - n));
+	block->ref_count = 1;
+	if (used > f32_memory_used_max) f32_memory_used_max = used;
+	return block;
+}
+
+// Release ownership of a floating point audio block
+void AudioStream::release(audio_block_f32_t *block)
+{
+	uint32_t mask = (0x80000000 >> (31 - (block->memory_pool_index & 0x1F)));
+	uint32_t index = block->memory_pool_index >> 5;
+
+	__disable_irq();
+	if (block->ref_count > 1) {
+		block->ref_count--;
+	} else {
+		f32_memory_pool_available_mask[index] |= mask;
+		if (index < f32_memory_pool_first_mask) f32_memory_pool_first_mask = index;
+		f32_memory_used--;
+	}
+	__enable_irq();
+}
+
 // Transmit an audio data block
 // to all streams that connect to an output.  The block
 // becomes owned by all the recepients, but also is still
@@ -160,7 +253,7 @@ void AudioStream::release(audio_block_t *block)
 void AudioStream::transmit(audio_block_t *block, unsigned char index)
 {
 	for (AudioConnection *c = destination_list; c != NULL; c = c->next_dest) {
-		if (c->src_index == index) {
+		if (c->src_index == index && !c->isF32) {
 			if (c->dst->inputQueue[c->dest_index] == NULL) {
 				c->dst->inputQueue[c->dest_index] = block;
 				block->ref_count++;
@@ -169,6 +262,20 @@ void AudioStream::transmit(audio_block_t *block, unsigned char index)
 	}
 }
 
+// Transmit a floating point block to all float inputs connected
+// (by AudioConnection_F32) to an output.
+void AudioStream::transmit(audio_block_f32_t *block, unsigned char index)
+{
+	for (AudioConnection *c = destination_list; c != NULL; c = c->next_dest) {
+		if (c->src_index == index && c->isF32) {
+			if (c->dst->inputQueue_f32[c->dest_index] == NULL) {
+				c->dst->inputQueue_f32[c->dest_index] = block;
+				block->ref_count++;
+			}
+		}
+	}
+}
+
 
 // Receive block from an input.  The block's data
 // may be shared with other streams, so it must not be written
@@ -200,12 +307,79 @@ audio_block_t * AudioStream::receiveWritable(unsigned int index)
 	return in;
 }
 
+// Receive a floating point block, which must not be written
+audio_block_f32_t * AudioStream::receiveReadOnly_f32(unsigned int index)
+{
+	audio_block_f32_t *in;
+
+	if (index >= num_inputs_f32) return NULL;
+	in = inputQueue_f32[index];
+	inputQueue_f32[index] = NULL;
+	return in;
+}
+
+// Receive a floating point block which may be changed
+audio_block_f32_t * AudioStream::receiveWritable_f32(unsigned int index)
+{
+	audio_block_f32_t *in, *p;
+
+	if (index >= num_inputs_f32) return NULL;
+	in = inputQueue_f32[index];
+	inputQueue_f32[index] = NULL;
+	if (in && in->ref_count > 1) {
+		p = allocate_f32();
+		if (p) memcpy(p->data, in->data, sizeof(p->data));
+		in->ref_count--;
+		in = p;
+	}
+	return in;
+}
+
+void AudioConvert_I16toF32::update(void)
+{
+	audio_block_t *in;
+	audio_block_f32_t *out;
+
+	in = receiveReadOnly(0);
+	if (!in) return;
+	out = allocate_f32();
+	if (out) {
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			out->data[i] = (float)in->data[i] * (1.0f / 32768.0f);
+		}
+		transmit(out);
+		release(out);
+	}
+	release(in);
+}
+
+void AudioConvert_F32toI16::update(void)
+{
+	audio_block_f32_t *in;
+	audio_block_t *out;
+
+	in = receiveReadOnly_f32(0);
+	if (!in) return;
+	out = allocate();
+	if (out) {
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			float f = in->data[i] * 32768.0f;
+			if (f > 32767.0f) f = 32767.0f;
+			if (f < -32768.0f) f = -32768.0f;
+			out->data[i] = (int16_t)f;
+		}
+		transmit(out);
+		release(out);
+	}
+	release(in);
+}
+
 /**************************************************************************************/
 // Constructor with no parameters: leave unconnected
 AudioConnection::AudioConnection() 
 	: src(NULL), dst(NULL),
 	  src_index(0), dest_index(0),
-	  isConnected(false)
+	  isConnected(false), isF32(false)
 
 {
 	// we are unused right now, so
@@ -250,7 +424,7 @@ int AudioConnection::connect(void)
 			break;
 		}
 			
-		if (dest_index >= dst->num_inputs) // input number too high
+		if (dest_index >= (isF32 ? dst->num_inputs_f32 : dst->num_inputs)) // input number too high
 		{
 			result = 2;
 			break;
@@ -265,7 +439,7 @@ int AudioConnection::connect(void)
 			p = s->destination_list;	// first patchCord in this stream's list
 			while (p)
 			{
-				if (p->dst == dst && p->dest_index == dest_index) // same destination - it's in use!
+				if (p->dst == dst && p->dest_index == dest_index && p->isF32 == isF32) // same destination - it's in use!
 				{
 					__enable_irq();
 					return 4;
@@ -353,7 +527,7 @@ int AudioConnection::disconnect(void)
 	AudioConnection *p;
 
 	if (!isConnected) return 1;
-	if (dest_index >= dst->num_inputs) return 2; // should never happen!
+	if (dest_index >= (isF32 ? dst->num_inputs_f32 : dst->num_inputs)) return 2; // should never happen!
 	__disable_irq();
 	
 	// Remove destination from source list
@@ -382,7 +556,13 @@ int AudioConnection::disconnect(void)
 	}
 //>>> PAH release the audio buffer properly
 	//Remove possible pending src block from destination
-	if(dst->inputQueue[dest_index] != NULL) {
+	if (isF32) {
+		if (dst->inputQueue_f32[dest_index] != NULL) {
+			AudioStream::release(dst->inputQueue_f32[dest_index]);
+			__disable_irq();
+			dst->inputQueue_f32[dest_index] = NULL;
+		}
+	} else if(dst->inputQueue[dest_index] != NULL) {
 		AudioStream::release(dst->inputQueue[dest_index]);
 		// release() re-enables the IRQ. Need it to be disabled a little longer
 		__disable_irq();
@@ -92,6 +92,17 @@ typedef struct audio_block_struct {
 	int16_t  data[AUDIO_BLOCK_SAMPLES];
 } audio_block_t;
 
+// Floating point audio blocks, for objects doing their processing with
+// the Cortex-M7 FPU.  These come from a separate pool, AudioMemory_F32(),
+// and travel over AudioConnection_F32 to float inputs.  Samples use a
+// nominal range of -1.0 to +1.0, but may exceed it without clipping.
+typedef struct audio_block_f32_struct {
+	uint8_t  ref_count;
+	uint8_t  reserved1;
+	uint16_t memory_pool_index;
+	float    data[AUDIO_BLOCK_SAMPLES];
+} audio_block_f32_t;
+
 
 
 class AudioConnection
@@ -117,12 +128,28 @@ protected:
 	unsigned char dest_index;
 	AudioConnection *next_dest; // linked list of connections from one source
 	bool isConnected;
+	bool isF32;		// carries audio_block_f32_t to a float input
 #if defined(AUDIO_DEBUG_CLASS)
 	friend class AudioDebug;
 #endif // defined(AUDIO_DEBUG_CLASS)
 };
 
 
+// A connection carrying floating point blocks.  The destination input number
+// refers to the destination's float inputs, which are separate from its
+// 16 bit integer inputs.
+class AudioConnection_F32 : public AudioConnection
+{
+public:
+	AudioConnection_F32() : AudioConnection() { isF32 = true; }
+	AudioConnection_F32(AudioStream &source, AudioStream &destination)
+		: AudioConnection_F32() { connect(source,destination); }
+	AudioConnection_F32(AudioStream &source, unsigned char sourceOutput,
+		AudioStream &destination, unsigned char destinationInput)
+		: AudioConnection_F32() { connect(source,sourceOutput, destination,destinationInput); }
+};
+
+
 #define AudioMemory(num) ({ \
 	static DMAMEM audio_block_t data[num]; \
 	AudioStream::initialize_memory(data, num); \
@@ -137,16 +164,32 @@ protected:
 #define AudioMemoryUsageMax() (AudioStream::memory_used_max)
 #define AudioMemoryUsageMaxReset() (AudioStream::memory_used_max = AudioStream::memory_used)
 
+#define AudioMemory_F32(num) ({ \
+	static DMAMEM audio_block_f32_t data_f32[num]; \
+	AudioStream::initialize_f32_memory(data_f32, num); \
+})
+
+#define AudioMemoryUsage_F32() (AudioStream::f32_memory_used)
+#define AudioMemoryUsageMax_F32() (AudioStream::f32_memory_used_max)
+#define AudioMemoryUsageMaxReset_F32() (AudioStream::f32_memory_used_max = AudioStream::f32_memory_used)
+
 class AudioStream
 {
 public:
 	AudioStream(unsigned char ninput, audio_block_t **iqueue) :
-		num_inputs(ninput), inputQueue(iqueue) {
+		AudioStream(ninput, iqueue, 0, NULL) { }
+	AudioStream(unsigned char ninput, audio_block_t **iqueue,
+	  unsigned char ninput_f32, audio_block_f32_t **iqueue_f32) :
+		num_inputs(ninput), num_inputs_f32(ninput_f32), inputQueue(iqueue),
+		inputQueue_f32(iqueue_f32) {
 			active = false;
 			destination_list = NULL;
 			for (int i=0; i < num_inputs; i++) {
 				inputQueue[i] = NULL;
 			}
+			for (int i=0; i < num_inputs_f32; i++) {
+				inputQueue_f32[i] = NULL;
+			}
 			// add to a simple list, for update_all
 			// TODO: replace with a proper data flow analysis in update_all
 			if (first_update == NULL) {
@@ -162,6 +205,7 @@ public:
 			numConnections = 0;
 		}
 	static void initialize_memory(audio_block_t *data, unsigned int num);
+	static void initialize_f32_memory(audio_block_f32_t *data, unsigned int num);
 	float processorUsage(void) { return CYCLE_COUNTER_APPROX_PERCENT(cpu_cycles); }
 	float processorUsageMax(void) { return CYCLE_COUNTER_APPROX_PERCENT(cpu_cycles_max); }
 	void processorUsageMaxReset(void) { cpu_cycles_max = cpu_cycles; }
@@ -172,14 +216,22 @@ public:
 	static uint16_t cpu_cycles_total_max;
 	static uint16_t memory_used;
 	static uint16_t memory_used_max;
+	static uint16_t f32_memory_used;
+	static uint16_t f32_memory_used_max;
 protected:
 	bool active;
 	unsigned char num_inputs;
+	unsigned char num_inputs_f32;
 	static audio_block_t * allocate(void);
 	static void release(audio_block_t * block);
 	void transmit(audio_block_t *block, unsigned char index = 0);
 	audio_block_t * receiveReadOnly(unsigned int index = 0);
 	audio_block_t * receiveWritable(unsigned int index = 0);
+	static audio_block_f32_t * allocate_f32(void);
+	static void release(audio_block_f32_t * block);
+	void transmit(audio_block_f32_t *block, unsigned char index = 0);
+	audio_block_f32_t * receiveReadOnly_f32(unsigned int index = 0);
+	audio_block_f32_t * receiveWritable_f32(unsigned int index = 0);
 	static bool update_setup(void);
 	static void update_stop(void);
 	static void update_all(void) { NVIC_SET_PENDING(IRQ_SOFTWARE); }
@@ -193,6 +245,7 @@ private:
 	static AudioConnection* unused; // linked list of unused but not destructed connections
 	AudioConnection *destination_list;
 	audio_block_t **inputQueue;
+	audio_block_f32_t **inputQueue_f32;
 	static bool update_scheduled;
 	virtual void update(void) = 0;
 	static AudioStream *first_update; // for update_all
@@ -200,6 +253,30 @@ private:
 	static audio_block_t *memory_pool;
 	static uint32_t memory_pool_available_mask[];
 	static uint16_t memory_pool_first_mask;
+	static audio_block_f32_t *f32_memory_pool;
+	static uint32_t f32_memory_pool_available_mask[];
+	static uint16_t f32_memory_pool_first_mask;
+};
+
+// Convert 16 bit integer audio to floating point, scaled so full scale
+// integer samples become -1.0 to +1.0.
+class AudioConvert_I16toF32 : public AudioStream
+{
+public:
+	AudioConvert_I16toF32(void) : AudioStream(1, inputQueueArray) { }
+	virtual void update(void);
+private:
+	audio_block_t *inputQueueArray[1];
+};
+
+// Convert floating point audio back to 16 bit integers, with saturation.
+class AudioConvert_F32toI16 : public AudioStream
+{
+public:
+	AudioConvert_F32toI16(void) : AudioStream(0, NULL, 1, inputQueueArray_f32) { }
+	virtual void update(void);
+private:
+	audio_block_f32_t *inputQueueArray_f32[1];
 };
 
 #if defined(AUDIO_DEBUG_CLASS)
@@ -0,0 +1,94 @@
+/* Teensyduino Core Library
+ * http://www.pjrc.com/teensy/
+ * Copyright (c) 2017 PJRC.COM, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * 1. The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * 2. If the Software is incorporated into a build system that allows
+ * selection among a list of target devices, then similar target
+ * devices manufactured by PJRC.COM must be included in the list of
+ * target devices and selectable in the same manner.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "BufferedPrint.h"
+
+size_t BufferedPrint::write(const uint8_t *buffer, size_t size)
+{
+	if (buffer == nullptr) return 0;
+	if (size >= bufsize) {
+		// too large to be worth buffering, write it straight through
+		send();
+		return dev->write(buffer, size);
+	}
+	size_t count = 0;
+	while (size > 0) {
+		if (len >= bufsize && !refill()) break;
+		size_t n = bufsize - len;
+		if (n > size) n = size;
+		memcpy(buf + len, buffer, n);
+		len += n;
+		buffer += n;
+		size -= n;
+		count += n;
+	}
+	return count;
+}
+
+// Copy the buffer into claimed USB transmit buffer space, usually with a
+// single claim.  The claim is committed before returning.  When nothing
+// can be claimed (USB not configured yet), usb_serial_write() is used,
+// which keeps early output in the fast boot buffer.
+size_t BufferedPrint::sendDirect(void)
+{
+	size_t count = 0;
+#if defined(CDC_STATUS_INTERFACE) && defined(CDC_DATA_INTERFACE) && !defined(USB_DISABLED)
+	while (count < len) {
+		uint32_t avail;
+		uint8_t *p = usb_serial_write_claim(&avail);
+		if (!p) {
+			int n = usb_serial_write(buf + count, len - count);
+			if (n > 0) count += n;
+			break;
+		}
+		size_t n = (len - count < avail) ? len - count : avail;
+		memcpy(p, buf + count, n);
+		usb_serial_write_commit(n);
+		count += n;
+	}
+#endif
+	return count;
+}
+
+void BufferedPrint::send(void)
+{
+	if (len > 0) {
+		size_t n = direct ? sendDirect() : dev->write(buf, len);
+		if (n < len) setWriteError();
+		len = 0;
+	}
+}
+
+bool BufferedPrint::refill(void)
+{
+	send();
+	return bufsize > 0;
+}
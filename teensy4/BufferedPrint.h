@@ -0,0 +1,93 @@
+/* Teensyduino Core Library
+ * http://www.pjrc.com/teensy/
+ * Copyright (c) 2017 PJRC.COM, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * 1. The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * 2. If the Software is incorporated into a build system that allows
+ * selection among a list of target devices, then similar target
+ * devices manufactured by PJRC.COM must be included in the list of
+ * target devices and selectable in the same manner.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BufferedPrint_h
+#define BufferedPrint_h
+
+#include "Print.h"
+#include "usb_serial.h"
+
+// BufferedPrint collects the many small writes done by print(), println()
+// and printf() and hands them to the underlying device with a single large
+// write(), so a line with many fields costs one driver call rather than
+// dozens.  Output is sent when the buffer fills, when send() or flush()
+// is called, or when the BufferedPrint is destroyed.
+//
+//   uint8_t buf[256];
+//   BufferedPrint out(Serial1, buf, sizeof(buf));
+//   out.print(x); out.print(','); out.println(y);
+//
+// When used with Serial (USB virtual serial), no buffer is needed.  A
+// small buffer inside the object (BUFFEREDPRINT_SERIAL_SIZE bytes) collects
+// the output, and send() copies it into the USB transmit buffer with a
+// single claim and commit.  Before USB is configured, output goes through
+// Serial.write() instead, so fast boot still holds it until the PC is ready.
+#ifndef BUFFEREDPRINT_SERIAL_SIZE
+#define BUFFEREDPRINT_SERIAL_SIZE 64
+#endif
+
+class BufferedPrint : public Print
+{
+public:
+	BufferedPrint(Print &device, void *buffer, size_t size)
+		: dev(&device), buf((uint8_t *)buffer), bufsize(size), len(0), direct(false) { }
+#if defined(CDC_STATUS_INTERFACE) && defined(CDC_DATA_INTERFACE) && !defined(USB_DISABLED)
+	BufferedPrint(usb_serial_class &device)
+		: dev(&device), buf(internal), bufsize(sizeof(internal)), len(0), direct(true) { }
+#endif
+	~BufferedPrint() { send(); }
+	virtual size_t write(uint8_t b) {
+		if (len >= bufsize && !refill()) return 0;
+		buf[len++] = b;
+		return 1;
+	}
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	virtual int availableForWrite(void) { return bufsize - len; }
+	// Send buffered data and ask the device to transmit immediately.
+	virtual void flush() { send(); dev->flush(); }
+	// Give all buffered data to the device with one write().
+	void send(void);
+	using Print::write;
+private:
+	BufferedPrint(const BufferedPrint &) = delete;
+	BufferedPrint & operator = (const BufferedPrint &) = delete;
+	bool refill(void);
+	size_t sendDirect(void);
+	Print *dev;
+	uint8_t *buf;
+	size_t bufsize;
+	size_t len;
+	bool direct;
+#if defined(CDC_STATUS_INTERFACE) && defined(CDC_DATA_INTERFACE) && !defined(USB_DISABLED)
+	uint8_t internal[BUFFEREDPRINT_SERIAL_SIZE];
+#endif
+};
+
+#endif
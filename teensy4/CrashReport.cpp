@@ -21,6 +21,24 @@ extern "C" uint32_t set_arm_clock(uint32_t frequency); // clockspeed.c
 
 static int isvalid(const struct arm_fault_info_struct *info);
 static void cleardata(struct arm_fault_info_struct *info);
+static int isvalid(const struct arm_fault_backtrace_struct *bt);
+static void print_location(Print& p, uint32_t addr);
+
+/* Line table written into flash by tools/crashreport_lines.py, all 32 bit
+   words little endian, offsets from the start of the table:
+     header:  magic "CRLT", size, nfuncs, funcs, nblocks, blocks, files,
+              strings, stream_end
+     funcs:   nfuncs x { addr, size, name }   sorted by addr
+     blocks:  nblocks x { addr, stream }      sorted by addr
+     files:   string offset for each file number
+     strings: zero terminated names
+     stream:  rows of uleb128(addr_delta << 1 | new_file) [uleb128(file)]
+              sleb128(line_delta), starting from addr=block addr, file=0,
+              line=0 in each block.  A row applies from its address until
+              the next row, line 0 means no line info.
+   tools/test_crashreport_lines.py checks a Python copy of print_location(). */
+extern "C" const uint8_t crashreport_line_table[] __attribute__((weak));
+#define CRLT_MAGIC 0x544C5243
 
 FLASHMEM
 size_t CrashReportClass::printTo(Print& p) const
@@ -42,7 +60,9 @@ size_t CrashReportClass::printTo(Print& p) const
     p.print(":");
     p.println(ss);
     p.print("  Code was executing from address 0x");
-    p.println(info->ret, HEX);
+    p.print(info->ret, HEX);
+    print_location(p, info->ret);
+    p.println();
     //p.print("  length: ");
     //p.println(info->len);
     //p.print("  IPSR: ");
@@ -70,12 +90,8 @@ size_t CrashReportClass::printTo(Print& p) const
         if (info->mmfar < 32) {
           p.print(" (nullptr)\n\t  Check code at 0x");
           p.print(info->ret, HEX);
-          p.print(" - very likely a bug!\n\t  Run \"addr2line -e mysketch.ino.elf 0x");
-          p.print(info->ret, HEX);
-          p.print("\" for filename & line number.");
-            // TODO: in some perfect future, maybe we'll build part of the ELF debug_line
-            // section (maybe just the .ino files) into CrashReport and be able to report
-            // the actual filename and line number.  Wouldn't that be awesome?!
+          print_location(p, info->ret);
+          p.print(" - very likely a bug!");
         } else if ((info->mmfar >= (uint32_t)&_ebss) && (info->mmfar < (uint32_t)&_ebss + 32)) {
           p.print(" (Stack problem)\n\t  Check for stack overflows, array bounds, etc.");
         }
@@ -129,6 +145,20 @@ size_t CrashReportClass::printTo(Print& p) const
       }
     }
 
+    const struct arm_fault_backtrace_struct *bt = (struct arm_fault_backtrace_struct *)0x2027FF00;
+    if (isvalid(bt) && bt->count > 1) {
+      p.println("  Backtrace:");
+      for (uint32_t i=0; i < bt->count; i++) {
+        p.print("    #");
+        p.print(i);
+        p.print(" 0x");
+        p.print(bt->addr[i], HEX);
+        // return addresses are just after the call
+        print_location(p, (i > 0) ? bt->addr[i] - 2 : bt->addr[i]);
+        p.println();
+      }
+    }
+
     p.print("  Temperature inside the chip was ");
     p.print(info->temp);
     p.print(" °C\n");
@@ -235,6 +265,113 @@ CrashReportClass::operator bool()
 	return false;
 }
 
+FLASHMEM
+static int isvalid(const struct arm_fault_backtrace_struct *bt)
+{
+	uint32_t i, crc;
+	const uint32_t *data, *end;
+
+	if (bt->count == 0 || bt->count > 30) return 0;
+	data = (uint32_t *)bt;
+	end = data + (sizeof(*bt) / 4 - 1);
+	crc = 0xFFFFFFFF;
+	while (data < end) {
+		crc ^= *data++;
+		for (i=0; i < 32; i++) crc = (crc >> 1) ^ (crc & 1)*0xEDB88320;
+	}
+	if (crc != bt->crc) return 0;
+	return 1;
+}
+
+FLASHMEM
+static uint32_t uleb128(const uint8_t **p, const uint8_t *end)
+{
+	uint32_t n = 0, shift = 0;
+	while (*p < end) {
+		uint8_t b = *(*p)++;
+		n |= (uint32_t)(b & 0x7F) << shift;
+		shift += 7;
+		if (!(b & 0x80)) break;
+	}
+	return n;
+}
+
+FLASHMEM
+static int32_t sleb128(const uint8_t **p, const uint8_t *end)
+{
+	uint32_t n = 0, shift = 0;
+	uint8_t b = 0;
+	while (*p < end) {
+		b = *(*p)++;
+		n |= (uint32_t)(b & 0x7F) << shift;
+		shift += 7;
+		if (!(b & 0x80)) break;
+	}
+	if ((b & 0x40) && shift < 32) n |= ~0u << shift;
+	return (int32_t)n;
+}
+
+// find the last entry (of "stride" words, address first) with address <= addr
+FLASHMEM
+static const uint32_t * table_search(const uint32_t *list, uint32_t count, uint32_t stride, uint32_t addr)
+{
+	uint32_t low = 0, high = count;
+	if (count == 0 || addr < list[0]) return NULL;
+	while (high - low > 1) {
+		uint32_t mid = (low + high) / 2;
+		if (list[mid * stride] <= addr) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+	return list + low * stride;
+}
+
+// print " (function + offset, file:line)" if the line table has this address
+FLASHMEM
+static void print_location(Print& p, uint32_t addr)
+{
+	const uint8_t *table = crashreport_line_table;
+	const uint32_t *hdr = (const uint32_t *)table;
+
+	if (!table || hdr[0] != CRLT_MAGIC) return;
+	addr &= ~1;
+	const char *strings = (const char *)table + hdr[7];
+	const uint32_t *func = table_search((const uint32_t *)(table + hdr[3]), hdr[2], 3, addr);
+	if (!func || addr >= func[0] + func[1]) return;
+	p.print(" (");
+	p.print(strings + func[2]);
+	p.print(" + ");
+	p.print(addr - func[0]);
+
+	const uint32_t *block = table_search((const uint32_t *)(table + hdr[5]), hdr[4], 2, addr);
+	if (block) {
+		const uint8_t *s = table + block[1];
+		const uint8_t *end = (block + 2 < (const uint32_t *)(table + hdr[5]) + hdr[4] * 2)
+			? table + block[3] : table + hdr[8];
+		uint32_t a = block[0], file = 0, line = 0, found_file = 0, found_line = 0;
+		while (s < end) {
+			uint32_t delta = uleb128(&s, end);
+			a += delta >> 1;
+			if (a > addr) break;
+			if (delta & 1) file = uleb128(&s, end);
+			line += sleb128(&s, end);
+			found_file = file;
+			found_line = line;
+		}
+		uint32_t nfiles = (hdr[7] - hdr[6]) / 4;
+		if (found_line && found_file < nfiles) {
+			const uint32_t *files = (const uint32_t *)(table + hdr[6]);
+			p.print(", ");
+			p.print(strings + files[found_file]);
+			p.print(":");
+			p.print(found_line);
+		}
+	}
+	p.print(")");
+}
+
 FLASHMEM
 static int isvalid(const struct arm_fault_info_struct *info)
 {
@@ -266,6 +403,10 @@ static void cleardata(struct arm_fault_info_struct *info)
 	info->xpsr  = 0;
 	info->crc = 0;
 	arm_dcache_flush_delete(info, sizeof(*info));
+	struct arm_fault_backtrace_struct *bt = (struct arm_fault_backtrace_struct *)0x2027FF00;
+	bt->count = 0;
+	bt->crc = 0;
+	arm_dcache_flush_delete(bt, sizeof(*bt));
 	SRC_SRSR = SRC_SRSR; // zeros all write-1-to-clear bits
 	SRC_GPR5 = 0;
 }
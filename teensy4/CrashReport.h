@@ -35,3 +35,13 @@ public:
 };
 
 extern CrashReportClass CrashReport;
+
+// Reserve flash for a table of function names and line numbers, so the
+// crash address and backtrace print as "function (file:line)".  The table
+// is filled in after linking by tools/crashreport_lines.py.  Use this once
+// in your program, for example CRASHREPORT_LINE_TABLE(65536);
+// The backtrace also needs unwind tables, so compile with -funwind-tables
+// (the Makefile adds it when CRASHREPORT_LINES=1).
+#define CRASHREPORT_LINE_TABLE(size) \
+	extern "C" const uint8_t crashreport_line_table[(size)] \
+	__attribute__ ((section(".crashreport_lines"), used, aligned(4))) = {'e','m','p','t','y'}
@@ -30,37 +30,56 @@
 
 #include "DMAChannel.h"
 
-// only 16 channels supported, because we don't handle sharing interrupts
-#define DMA_MAX_CHANNELS 16
+#define DMA_MAX_CHANNELS 32
 
 // The channel allocation bitmask is accessible from "C" namespace,
 // so C-only code can reserve DMA channels
-uint16_t dma_channel_allocated_mask = 0;
+uint32_t dma_channel_allocated_mask = 0;
+static uint8_t dma_channel_allocated_max = 0;
+static uint32_t dma_channel_allocation_failures = 0;
+
+// Channels n and n+16 share IRQ n.  When only one of them has an
+// interrupt, its function goes directly in the vector table.
+static void (*dma_channel_isr[DMA_MAX_CHANNELS])(void);
 
 #ifdef CR
 #warning "CR is defined as something?"
 #endif
 
 
-void DMAChannel::begin(bool force_initialization)
+void DMAChannel::begin(bool force_initialization, int group)
 {
-	uint32_t ch = 0;
+	uint32_t ch, first, last;
 
+	if (group == DMA_GROUP_LOW) {
+		first = 0;
+		last = 15;
+	} else if (group == DMA_GROUP_HIGH) {
+		first = 16;
+		last = 31;
+	} else {
+		first = 0;
+		last = DMA_MAX_CHANNELS - 1;
+	}
 	__disable_irq();
-	if (!force_initialization && TCD && channel < DMA_MAX_CHANNELS
-	  && (dma_channel_allocated_mask & (1 << channel))
+	if (!force_initialization && TCD && channel >= first && channel <= last
+	  && (dma_channel_allocated_mask & (1u << channel))
 	  && (uint32_t)TCD == (uint32_t)(0x400E9000 + channel * 32)) {
 		// DMA channel already allocated
 		__enable_irq();
 		return;
 	}
+	ch = first;
 	while (1) {
-		if (!(dma_channel_allocated_mask & (1 << ch))) {
-			dma_channel_allocated_mask |= (1 << ch);
+		if (!(dma_channel_allocated_mask & (1u << ch))) {
+			dma_channel_allocated_mask |= (1u << ch);
+			uint32_t count = __builtin_popcount(dma_channel_allocated_mask);
+			if (count > dma_channel_allocated_max) dma_channel_allocated_max = count;
 			__enable_irq();
 			break;
 		}
-		if (++ch >= DMA_MAX_CHANNELS) {
+		if (++ch > last) {
+			dma_channel_allocation_failures++;
 			__enable_irq();
 			TCD = (TCD_t *)0;
 			channel = DMA_MAX_CHANNELS;
@@ -76,6 +95,11 @@ void DMAChannel::begin(bool force_initialization)
 	DMA_CERR = ch;
 	DMA_CEEI = ch;
 	DMA_CINT = ch;
+	if (ch >= 16) {
+		// DCHPRIn are bytes in big endian order within each word.  Give
+		// group 1 channels the same fixed priorities as group 0.
+		*((volatile uint8_t *)&DMA_DCHPRI3 + (ch ^ 3)) = ch - 16;
+	}
 	TCD = (TCD_t *)(0x400E9000 + ch * 32);
 	uint32_t *p = (uint32_t *)TCD;
 	*p++ = 0;
@@ -92,19 +116,267 @@ void DMAChannel::release(void)
 {
 	if (channel >= DMA_MAX_CHANNELS) return;
 	DMA_CERQ = channel;
+	if (dma_channel_isr[channel]) detachInterrupt();
 	__disable_irq();
-	dma_channel_allocated_mask &= ~(1 << channel);
+	dma_channel_allocated_mask &= ~(1u << channel);
 	__enable_irq();
 	channel = DMA_MAX_CHANNELS;
 	TCD = (TCD_t *)0;
 }
 
+uint32_t DMAChannel::channelsAllocated(void)
+{
+	return __builtin_popcount(dma_channel_allocated_mask);
+}
+
+uint32_t DMAChannel::channelsAllocatedMax(void)
+{
+	return dma_channel_allocated_max;
+}
+
+uint32_t DMAChannel::allocationFailures(void)
+{
+	return dma_channel_allocation_failures;
+}
+
+// interrupt shared by 2 channels, both with a function attached
+static void dma_shared_isr(void)
+{
+	uint32_t ipsr;
+	asm volatile("mrs %0, ipsr\n" : "=r" (ipsr) :: "memory");
+	uint32_t ch = (ipsr & 0x1FF) - 16 - IRQ_DMA_CH0;
+	uint32_t status = DMA_INT;
+	if (status & (1u << ch)) (*dma_channel_isr[ch])();
+	if (status & (1u << (ch + 16))) (*dma_channel_isr[ch + 16])();
+}
+
+// put the right function in the vector table for one shared interrupt
+static void dma_update_vector(uint32_t irq)
+{
+	void (*low)(void) = dma_channel_isr[irq];
+	void (*high)(void) = dma_channel_isr[irq + 16];
+	if (low && high) {
+		_VectorsRam[irq + IRQ_DMA_CH0 + 16] = dma_shared_isr;
+	} else if (low || high) {
+		_VectorsRam[irq + IRQ_DMA_CH0 + 16] = low ? low : high;
+	}
+}
+
+void DMAChannel::attachInterrupt(void (*isr)(void))
+{
+	uint32_t irq = channel & 15;
+	__disable_irq();
+	dma_channel_isr[channel] = isr;
+	dma_update_vector(irq);
+	__enable_irq();
+	NVIC_ENABLE_IRQ(IRQ_DMA_CH0 + irq);
+}
+
+void DMAChannel::attachInterrupt(void (*isr)(void), uint8_t prio)
+{
+	attachInterrupt(isr);
+	NVIC_SET_PRIORITY(IRQ_DMA_CH0 + (channel & 15), prio);
+}
+
+void DMAChannel::detachInterrupt(void)
+{
+	uint32_t irq = channel & 15;
+	__disable_irq();
+	dma_channel_isr[channel] = nullptr;
+	if (dma_channel_isr[channel ^ 16]) {
+		dma_update_vector(irq);
+	} else {
+		NVIC_DISABLE_IRQ(IRQ_DMA_CH0 + irq);
+	}
+	__enable_irq();
+}
+
+// Peripheral registers don't increment and don't need cache maintenance
+static inline bool is_peripheral(const volatile void *addr)
+{
+	return (uint32_t)addr >= 0x40000000 && (uint32_t)addr < 0x60000000;
+}
+
+static inline bool is_cached(const volatile void *addr)
+{
+	return (uint32_t)addr >= 0x20200000 && !is_peripheral(addr);
+}
+
+// Set up a TCD to move len bytes.  Memory to memory uses the widest
+// transfers the alignment allows (16 bytes, SSIZE 4, is reserved on this
+// eDMA, so 16 byte aligned moves use 8 bytes), in minor loops of up to 1K so other
+// channels are not held off for the whole copy.  When either side is a
+// peripheral register, each trigger moves one unit (1, 2 or 4 bytes).
+// Cached source data is flushed and the cached destination is deleted.
+static bool setup_tcd(DMABaseClass::TCD_t *tcd, volatile void *dst,
+	volatile const void *src, uint32_t len, uint32_t unit)
+{
+	uint32_t align, size, attr, count, per;
+
+	if (len == 0) return false;
+	bool periph = is_peripheral(src) || is_peripheral(dst);
+	align = periph ? unit : ((uint32_t)dst | (uint32_t)src | len);
+	if (!(align & 31)) {
+		size = 32; // 32 byte burst
+		attr = 5;
+	} else if (!(align & 7)) {
+		size = 8;
+		attr = 3;
+	} else if (!(align & 3)) {
+		size = 4;
+		attr = 2;
+	} else if (!(align & 1)) {
+		size = 2;
+		attr = 1;
+	} else {
+		size = 1;
+		attr = 0;
+	}
+	if (len % size) return false;
+	count = len / size;
+	if (periph) {
+		if (count > 32767) return false;
+		per = 1;
+	} else {
+		// The minor loop must evenly divide the copy, otherwise the
+		// whole copy is 1 minor loop.
+		per = 1024 / size;
+		if (per > count) per = count;
+		while (count % per) per--;
+		if (count / per > 32767) per = count;
+	}
+	if (is_cached(src)) arm_dcache_flush((void *)src, len);
+	if (is_cached(dst)) arm_dcache_flush_delete((void *)dst, len);
+	tcd->SADDR = src;
+	tcd->SOFF = is_peripheral(src) ? 0 : size;
+	tcd->ATTR = DMA_TCD_ATTR_SSIZE(attr) | DMA_TCD_ATTR_DSIZE(attr);
+	tcd->NBYTES = per * size;
+	tcd->SLAST = is_peripheral(src) ? 0 : -len;
+	tcd->DADDR = dst;
+	tcd->DOFF = is_peripheral(dst) ? 0 : size;
+	tcd->CITER = count / per;
+	tcd->BITER = count / per;
+	tcd->DLASTSGA = is_peripheral(dst) ? 0 : -len;
+	return true;
+}
+
+bool DMAChannel::copyMemory(void *dst, const void *src, uint32_t len, bool interrupt)
+{
+	if (!TCD || len == 0) return false;
+	if (is_peripheral(dst) || is_peripheral(src)) return false;
+	disable();
+	clearComplete();
+	if (!setup_tcd(TCD, dst, src, len, 1)) return false;
+	TCD->CSR = DMA_TCD_CSR_DREQ | (interrupt ? DMA_TCD_CSR_INTMAJOR : 0);
+	triggerContinuously();
+	enable();
+	return true;
+}
+
+bool DMAChannel::fillMemory(void *dst, const uint32_t *pattern, uint32_t len, bool interrupt)
+{
+	if (!TCD || len == 0 || is_peripheral(dst)) return false;
+	if ((uint32_t)pattern & 31) return false;
+	disable();
+	clearComplete();
+	// same as a copy, but the source doesn't move
+	if (!setup_tcd(TCD, dst, dst, len, 1)) return false;
+	if (is_cached(pattern)) arm_dcache_flush((void *)pattern, 32);
+	TCD->SADDR = pattern;
+	TCD->SOFF = 0;
+	TCD->SLAST = 0;
+	TCD->CSR = DMA_TCD_CSR_DREQ | (interrupt ? DMA_TCD_CSR_INTMAJOR : 0);
+	triggerContinuously();
+	enable();
+	return true;
+}
+
+bool DMAChainBase::add(volatile void *dst, volatile const void *src, uint32_t len, bool interrupt)
+{
+	if (!channel.TCD) return false;
+	update();
+	if (count >= size) return false;
+	uint32_t n = head + count;
+	if (n >= size) n -= size;
+	DMABaseClass::TCD_t *tcd = list + n;
+	DMABaseClass::TCD_t *next = list + ((n + 1 < size) ? n + 1 : 0);
+	if (!setup_tcd(tcd, dst, src, len, unit)) return false;
+	// Every TCD links to the next slot, even the last one which doesn't
+	// use it.  The channel's DLASTSGA then tells which TCD is loaded.
+	tcd->DLASTSGA = (int32_t)next;
+	tcd->CSR = DMA_TCD_CSR_DREQ | (interrupt ? DMA_TCD_CSR_INTMAJOR : 0);
+	if (is_cached(tcd)) arm_dcache_flush(tcd, sizeof(*tcd));
+
+	bool linked = false;
+	__disable_irq();
+	if (count > 0) {
+		DMABaseClass::TCD_t *prev = list + ((n > 0) ? n - 1 : size - 1);
+		prev->CSR = (prev->CSR & ~DMA_TCD_CSR_DREQ) | DMA_TCD_CSR_ESG;
+		if (is_cached(prev)) arm_dcache_flush(prev, sizeof(*prev));
+		DMABaseClass::TCD_t *hw = channel.TCD;
+		if (hw->DLASTSGA == (int32_t)tcd) {
+			// The previous TCD is already loaded in the channel, so
+			// link it there too.  If it completes first, the hardware
+			// refuses to set ESG and the channel has stopped.
+			hw->CSR |= DMA_TCD_CSR_DREQ;
+			hw->CSR = hw->CSR | DMA_TCD_CSR_ESG;
+			if (hw->CSR & DMA_TCD_CSR_ESG) {
+				hw->CSR &= ~DMA_TCD_CSR_DREQ;
+				linked = true;
+			} else if (hw->DLASTSGA == (int32_t)next) {
+				linked = true; // new TCD loaded already
+			}
+		} else {
+			linked = true; // channel will load the previous TCD from memory
+		}
+	}
+	if (!linked) {
+		// nothing running, load this TCD into the channel and start
+		channel.disable();
+		channel.clearComplete();
+		const uint32_t *p = (const uint32_t *)tcd;
+		uint32_t *q = (uint32_t *)channel.TCD;
+		for (int i=0; i < 8; i++) *q++ = *p++;
+		if (!is_peripheral(src) && !is_peripheral(dst)) channel.triggerContinuously();
+		channel.enable();
+	}
+	count++;
+	__enable_irq();
+	return true;
+}
+
+// find which segments the channel has finished
+void DMAChainBase::update(void)
+{
+	__disable_irq();
+	if (count > 0) {
+		DMABaseClass::TCD_t *hw = channel.TCD;
+		uint32_t link = (uint32_t)hw->DLASTSGA - (uint32_t)list;
+		bool stopped = (hw->CSR & DMA_TCD_CSR_DONE) && !(DMA_ERQ & (1u << channel.channel));
+		uint32_t tail = head + count - 1;
+		if (tail >= size) tail -= size;
+		if (link < size * sizeof(DMABaseClass::TCD_t)) {
+			uint32_t loaded = link / sizeof(DMABaseClass::TCD_t);
+			loaded = (loaded > 0) ? loaded - 1 : size - 1;
+			uint32_t finished = (loaded >= head) ? loaded - head : loaded + size - head;
+			if (loaded == tail && stopped) finished = count;
+			if (finished > count) finished = 0; // not yet loaded
+			head += finished;
+			if (head >= size) head -= size;
+			count -= finished;
+			completed_count += finished;
+		}
+	}
+	__enable_irq();
+}
+
 static uint32_t priority(const DMAChannel &c)
 {
 	uint32_t n;
 	n = *(uint32_t *)((uint32_t)&DMA_DCHPRI3 + (c.channel & 0xFC));
 	n = __builtin_bswap32(n);
-	return (n >> ((c.channel & 0x03) << 3)) & 0x0F;
+	// group 1 (channels 16-31) is above all of group 0
+	return ((n >> ((c.channel & 0x03) << 3)) & 0x0F) | (c.channel & 0x10);
 }
 
 static void swap(DMAChannel &c1, DMAChannel &c2)
@@ -41,11 +41,44 @@
 
 
 // The channel allocation bitmask is accessible from "C" namespace,
-// so C-only code can reserve DMA channels
+// so C-only code can reserve DMA channels.  It is 32 bits since channels
+// 16-31 became available.  Old code declaring its own extern uint16_t
+// still links and sees channels 0-15 in the low half, but must not be
+// compiled together with this header.
 #ifdef __cplusplus
 extern "C" {
 #endif
-extern uint16_t dma_channel_allocated_mask;
+extern uint32_t dma_channel_allocated_mask;
+
+// Asynchronous memcpy and memset using DMA.  The dma_memop_t must remain
+// valid until the operation is done.  Operations are queued and run on a
+// small pool of DMA channels.  The callback, if used, runs from the DMA
+// interrupt.  Copies shorter than DMA_MEMOP_MIN_LEN are done immediately
+// by the CPU, as are partial 32 byte cache rows at either end of a cached
+// destination.  Returns 0 if the operation can not be started.
+typedef struct dma_memop_struct {
+	uint32_t pattern[8];  // fill data for memset, 32 byte aligned
+	struct dma_memop_struct *next;
+	void *dst;
+	const void *src;
+	uint32_t len;
+	void (*callback)(struct dma_memop_struct *op);
+	void *context;        // for use by the callback
+	volatile uint8_t status;
+} __attribute__ ((aligned(32))) dma_memop_t;
+#define DMA_MEMOP_DONE    0
+#define DMA_MEMOP_QUEUED  1
+#define DMA_MEMOP_RUNNING 2
+#define DMA_MEMOP_ERROR   3
+#define DMA_MEMOP_MIN_LEN 256
+int dma_memcpy_async(dma_memop_t *op, void *dst, const void *src, uint32_t len,
+	void (*callback)(dma_memop_t *op));
+int dma_memset_async(dma_memop_t *op, void *dst, int c, uint32_t len,
+	void (*callback)(dma_memop_t *op));
+static inline int dma_memop_done(const dma_memop_t *op) {
+	return op->status == DMA_MEMOP_DONE || op->status == DMA_MEMOP_ERROR;
+}
+void dma_memop_wait(const dma_memop_t *op); // calls yield() until done
 #ifdef __cplusplus
 }
 #endif
@@ -448,7 +481,15 @@ public:
 	~DMAChannel() {
 		release();
 	}
-	void begin(bool force_initialization = false);
+	// Channels 0-15 are group 0 and channels 16-31 are group 1.  Group 1
+	// always has priority over group 0.  By default channels are taken
+	// from group 0 first, then group 1 when group 0 is fully used.
+	void begin(bool force_initialization = false, int group = DMA_GROUP_ANY);
+	enum { DMA_GROUP_ANY = -1, DMA_GROUP_LOW = 0, DMA_GROUP_HIGH = 1 };
+	// channel allocation statistics
+	static uint32_t channelsAllocated(void);
+	static uint32_t channelsAllocatedMax(void);
+	static uint32_t allocationFailures(void);
 private:
 	void release(void);
 
@@ -508,21 +549,12 @@ public:
 
 	// An interrupt routine can be run when the DMA channel completes
 	// the entire transfer, and also optionally when half of the
-	// transfer is completed.
-	void attachInterrupt(void (*isr)(void)) {
-		_VectorsRam[channel + IRQ_DMA_CH0 + 16] = isr;
-		NVIC_ENABLE_IRQ(IRQ_DMA_CH0 + channel);
-	}
-
-	void attachInterrupt(void (*isr)(void), uint8_t prio) {
-		_VectorsRam[channel + IRQ_DMA_CH0 + 16] = isr;
-		NVIC_ENABLE_IRQ(IRQ_DMA_CH0 + channel);
-		NVIC_SET_PRIORITY(IRQ_DMA_CH0 + channel, prio);
-	}
-	
-	void detachInterrupt(void) {
-		NVIC_DISABLE_IRQ(IRQ_DMA_CH0 + channel);
-	}
+	// transfer is completed.  Channels n and n+16 share one interrupt.
+	// If both have a function attached, the interrupt calls each one
+	// with its bit set in DMA_INT, and the priority set last is used.
+	void attachInterrupt(void (*isr)(void));
+	void attachInterrupt(void (*isr)(void), uint8_t prio);
+	void detachInterrupt(void);
 
 	void clearInterrupt(void) {
 		DMA_CINT = channel;
@@ -565,6 +597,24 @@ public:
 		return (void *)(TCD->DADDR);
 	}
 
+	/***************************************/
+	/**    Memory to Memory Copy          **/
+	/***************************************/
+
+	// Copy memory in the background, using the widest transfers the
+	// alignment allows.  Cached source data is written to memory and the
+	// destination is removed from the cache before starting.  When
+	// complete() becomes true, use arm_dcache_delete() on a cached
+	// destination (RAM2 or EXTMEM) before reading it, because the CPU may
+	// speculatively cache it during the copy.  Below roughly 256 bytes,
+	// memcpy() is faster.  Returns false if the copy was not started.
+	// With interrupt true, the attached interrupt runs when complete.
+	bool copyMemory(void *dst, const void *src, uint32_t len, bool interrupt = false);
+	// Fill memory with a 32 byte aligned pattern, which must not change
+	// until complete.  Only the first 1 to 8 bytes of the pattern are
+	// used when dst or len are not 32 byte aligned.
+	bool fillMemory(void *dst, const uint32_t *pattern, uint32_t len, bool interrupt = false);
+
 	/***************************************/
 	/**    Direct Hardware Access         **/
 	/***************************************/
@@ -577,6 +627,57 @@ public:
 	// TCD is accessible due to inheritance from DMABaseClass
 };
 
+// DMAChain performs a list of transfers (segments) in order on one DMA
+// channel, using the eDMA scatter/gather feature.  Each segment is a
+// source, destination and length.  Memory to memory segments run as fast
+// as possible.  Segments to or from a peripheral register move "unit"
+// bytes per trigger, from the trigger configured on the channel.  More
+// segments may be added while the chain runs.  Cache maintenance for
+// each segment is done by add().  Up to N segments may be pending.
+//
+//   DMAChannel dma;
+//   DMAChain<16> chain(dma);
+//   chain.add(dst, header, 8);
+//   chain.add(dst + 8, payload, 1024);
+//   while (!chain.done()) ;  // then arm_dcache_delete() a cached dst
+
+class DMAChainBase {
+public:
+	// add a segment, returns false if full or the length can't be done
+	bool add(volatile void *dst, volatile const void *src, uint32_t len, bool interrupt = false);
+	// number of segments added but not yet complete
+	uint32_t pending(void) { update(); return count; }
+	bool full(void) { update(); return count >= size; }
+	bool done(void) { update(); return count == 0; }
+	// total number of segments completed
+	uint32_t completed(void) { update(); return completed_count; }
+protected:
+	DMAChainBase(DMAChannel &ch, DMABaseClass::TCD_t *tcds, uint16_t n, uint8_t unitsize)
+		: channel(ch), list(tcds), size(n), unit(unitsize) {}
+private:
+	void update(void);
+	DMAChannel &channel;
+	DMABaseClass::TCD_t *list;
+	uint16_t size;
+	uint16_t head = 0;
+	uint16_t count = 0;
+	uint8_t unit;
+	uint32_t completed_count = 0;
+};
+
+template <uint16_t N>
+class DMAChain : public DMAChainBase {
+public:
+	DMAChain(DMAChannel &ch, uint8_t unitsize = 4) : DMAChainBase(ch, tcddata, N, unitsize) {}
+private:
+	DMABaseClass::TCD_t tcddata[N] __attribute__((aligned(32)));
+};
+
+// dma_memcpy_async() and dma_memset_async() can trigger an EventResponder
+class EventResponder;
+int dma_memcpy_async(dma_memop_t *op, void *dst, const void *src, uint32_t len, EventResponder &event);
+int dma_memset_async(dma_memop_t *op, void *dst, int c, uint32_t len, EventResponder &event);
+
 // arrange the relative priority of 2 or more DMA channels
 void DMAPriorityOrder(DMAChannel &ch1, DMAChannel &ch2);
 void DMAPriorityOrder(DMAChannel &ch1, DMAChannel &ch2, DMAChannel &ch3);
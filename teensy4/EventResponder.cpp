@@ -322,6 +322,13 @@ void MillisTimer::runFromTimer()
 	}
 }
 
+uint32_t MillisTimer::ticksUntilNextEvent()
+{
+	if (listWaiting) return 1;
+	if (listActive) return listActive->_ms + 1;
+	return 0xFFFFFFFF;
+}
+
 // Long ago you could install your own systick interrupt handler by just
 // creating your own systick_isr() function.  No longer.  But if you
 // *really* want to commandeer systick, you can still do so by writing
@@ -339,10 +346,24 @@ void MillisTimer::runFromTimer()
 extern "C" volatile uint32_t systick_millis_count;
 extern "C" volatile uint32_t systick_cycle_count;
 extern "C" uint32_t systick_safe_read; // micros() synchronization
+
+// Only SysTick (or tickless_sleep with interrupts disabled) calls this.
+static inline void cycle_count_update(uint32_t cycles)
+{
+	uint32_t seq = cycle_count_seq;
+	uint32_t high = cycle_count[seq & 1].high;
+	if (cycles < cycle_count[seq & 1].last) high++;
+	cycle_count[(seq + 1) & 1].high = high;
+	cycle_count[(seq + 1) & 1].last = cycles;
+	cycle_count_seq = seq + 1;
+}
+
 extern "C" void systick_isr(void)
 {
-	systick_cycle_count = ARM_DWT_CYCCNT;
+	uint32_t cycles = ARM_DWT_CYCCNT;
+	systick_cycle_count = cycles;
 	systick_millis_count++;
+	cycle_count_update(cycles); // for cycles64()
 }
 
 // Entry to any ARM exception clears the LDREX exclusive access flag.
@@ -354,8 +375,107 @@ extern "C" void systick_isr(void)
 
 extern "C" void systick_isr_with_timer_events(void)
 {
-	systick_cycle_count = ARM_DWT_CYCCNT;
+	uint32_t cycles = ARM_DWT_CYCCNT;
+	systick_cycle_count = cycles;
 	systick_millis_count++;
+	cycle_count_update(cycles);
 	MillisTimer::runFromTimer();
 }
 
+
+// Tickless idle.  Rather than waking every millisecond for SysTick, the
+// CPU sleeps in WFI until any interrupt or a one-shot GPT1 compare at the
+// requested time.  SysTick keeps counting during the sleep with only its
+// interrupt disabled, so its phase is never lost.  GPT1 (24 MHz, free
+// running) measures the sleep, and the skipped milliseconds are added to
+// millis() and given to MillisTimer afterwards.
+
+volatile uint8_t tickless_idle_enabled = 0;
+static uint8_t tickless_gpt1_running = 0;
+
+static void tickless_gpt1_isr(void)
+{
+	GPT1_SR = 0x3F;
+	asm("dsb");
+}
+
+extern "C" void tickless_idle(int enable)
+{
+	tickless_idle_enabled = enable ? 1 : 0;
+}
+
+extern "C" void tickless_sleep(uint32_t usec)
+{
+	void (*isr)(void) = _VectorsRam[15];
+	bool timers = (isr == systick_isr_with_timer_events);
+	if (!timers && isr != systick_isr) return; // SysTick used by someone else
+	if (usec < 1500) return;
+	// wake at least every second, so cycles64() sees every ARM_DWT_CYCCNT
+	// rollover even when overclocked
+	if (usec > 1000000) usec = 1000000;
+	if (!tickless_gpt1_running) {
+		CCM_CCGR1 |= CCM_CCGR1_GPT1_BUS(CCM_CCGR_ON) | CCM_CCGR1_GPT1_SERIAL(CCM_CCGR_ON);
+		GPT1_CR = 0;
+		GPT1_PR = 0;
+		GPT1_SR = 0x3F;
+		GPT1_IR = 0;
+		GPT1_CR = GPT_CR_CLKSRC(1) | GPT_CR_FRR | GPT_CR_ENMOD | GPT_CR_EN; // 24 MHz
+		attachInterruptVector(IRQ_GPT1, tickless_gpt1_isr);
+		NVIC_ENABLE_IRQ(IRQ_GPT1);
+		tickless_gpt1_running = 1;
+	}
+
+	__disable_irq();
+	if (timers) {
+		uint32_t ticks = MillisTimer::ticksUntilNextEvent();
+		if (ticks < 2) {
+			__enable_irq();
+			return;
+		}
+		if (ticks - 1 < usec / 1000) usec = (ticks - 1) * 1000;
+	}
+	if (SCB_ICSR & SCB_ICSR_PENDSTSET) {
+		__enable_irq(); // tick about to be counted, don't lose it
+		return;
+	}
+	const uint32_t reload = SYST_RVR + 1; // 100 SysTick counts per ms
+	uint32_t gpt_begin = GPT1_CNT;
+	uint32_t pos_begin = (reload - SYST_CVR) % reload; // counts since last tick
+	SYST_CSR = SYST_CSR_ENABLE;
+	GPT1_OCR1 = gpt_begin + usec * 24;
+	GPT1_SR = 0x3F;
+	GPT1_IR = GPT_IR_OF1IE;
+	asm volatile("dsb\n" "wfi\n" "isb\n" ::: "memory");
+	GPT1_IR = 0;
+	GPT1_SR = 0x3F;
+	NVIC_CLEAR_PENDING(IRQ_GPT1);
+
+	// count SysTick periods passed, GPT1 gives the approximate time and
+	// SysTick's own counter gives the exact phase
+	uint32_t gpt_end = GPT1_CNT;
+	uint32_t cvr = SYST_CVR;
+	SYST_CSR = SYST_CSR_TICKINT | SYST_CSR_ENABLE;
+	uint32_t cvr_after = SYST_CVR;
+	uint32_t pos_end = (reload - cvr) % reload;
+	uint32_t counts = (gpt_end - gpt_begin + 120) / 240; // 10 us each
+	int32_t error = (int32_t)((pos_end + reload - pos_begin) % reload) - (int32_t)(counts % reload);
+	if (error > (int32_t)reload / 2) error -= reload;
+	if (error < -(int32_t)reload / 2) error += reload;
+	counts += error;
+	uint32_t ticks = (pos_begin + counts) / reload;
+	if (cvr_after > cvr && !(SCB_ICSR & SCB_ICSR_PENDSTSET)) {
+		// SysTick reached zero before its interrupt was enabled
+		ticks++;
+		pos_end = (reload - cvr_after) % reload;
+	}
+	uint32_t cycles = ARM_DWT_CYCCNT;
+	cycle_count_update(cycles);
+	if (ticks > 0) {
+		systick_millis_count += ticks;
+		systick_cycle_count = ARM_DWT_CYCCNT - pos_end * 10 * (F_CPU_ACTUAL / 1000000);
+		if (timers) {
+			while (ticks-- > 0) MillisTimer::runFromTimer();
+		}
+	}
+	__enable_irq();
+}
@@ -248,6 +248,9 @@ public:
 	void beginRepeating(unsigned long milliseconds, EventResponderRef event);
 	void end();
 	static void runFromTimer();
+	// number of systick interrupts until a timer needs runFromTimer()
+	// to do more than count, or 0xFFFFFFFF if no timers are running
+	static uint32_t ticksUntilNextEvent();
 private:
 	void addToWaitingList();
 	void addToActiveList();
@@ -0,0 +1,223 @@
+/* Teensyduino Core Library
+ * http://www.pjrc.com/teensy/
+ * Copyright (c) 2021 PJRC.COM, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * 1. The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * 2. If the Software is incorporated into a build system that allows
+ * selection among a list of target devices, then similar target
+ * devices manufactured by PJRC.COM must be included in the list of
+ * target devices and selectable in the same manner.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include <IRQTrace.h>
+
+#define NUM_VECTORS (NVIC_NUM_INTERRUPTS + 16)
+#define FIRST_TRACED 14  // PendSV, SysTick and all IRQs, not faults
+
+extern "C" void unused_interrupt_vector(void); // startup.c
+
+__attribute__ ((aligned(1024)))
+static void (* volatile trace_vectors[NUM_VECTORS])(void);
+static struct irq_trace_stats trace_stats[NUM_VECTORS];
+static uint32_t pend_time[NVIC_NUM_INTERRUPTS];
+static uint32_t pend_seen[NVIC_NUM_INTERRUPTS / 32];
+static uint32_t nested_cycles = 0;
+static uint32_t exclude_mask[(NUM_VECTORS + 31) / 32];
+
+// Excluded vectors jump straight to their handler.  LR still holds
+// EXC_RETURN and the stack pointer is untouched, so handlers which read
+// their exception frame work normally.
+__attribute__((naked))
+static void irq_direct_isr(void)
+{
+	asm volatile(
+		"mrs	r0, ipsr\n"
+		"ubfx	r0, r0, #0, #9\n"
+		"movw	r1, #:lower16:_VectorsRam\n"
+		"movt	r1, #:upper16:_VectorsRam\n"
+		"ldr	r0, [r1, r0, lsl #2]\n"
+		"bx	r0\n");
+}
+
+// remember when each pending IRQ was first seen pending
+static inline void check_pending(uint32_t now)
+{
+	volatile uint32_t *ispr = (volatile uint32_t *)0xE000E200;
+	for (uint32_t i=0; i < NVIC_NUM_INTERRUPTS / 32; i++) {
+		uint32_t pending = ispr[i] & ~pend_seen[i];
+		if (pending) {
+			pend_seen[i] |= pending;
+			do {
+				uint32_t bit = __builtin_ctz(pending);
+				pend_time[i * 32 + bit] = now;
+				pending &= pending - 1;
+			} while (pending);
+		}
+	}
+}
+
+static void irq_trace_isr(void)
+{
+	uint32_t vector, start, nested, elapsed, cycles;
+
+	start = ARM_DWT_CYCCNT;
+	asm volatile("mrs %0, ipsr\n" : "=r" (vector) :: "memory");
+	vector &= 0x1FF;
+	void (*handler)(void) = _VectorsRam[vector];
+	if (handler == &unused_interrupt_vector && vector >= 16) {
+		// let the real vector table produce a normal crash report
+		SCB_VTOR = (uint32_t)_VectorsRam;
+		NVIC_SET_PENDING(vector - 16);
+		return;
+	}
+	struct irq_trace_stats *s = trace_stats + vector;
+	if (vector >= 16) {
+		uint32_t irq = vector - 16;
+		uint32_t mask = 1 << (irq & 31);
+		if (pend_seen[irq >> 5] & mask) {
+			pend_seen[irq >> 5] &= ~mask;
+			uint32_t latency = start - pend_time[irq];
+			s->latency_count++;
+			s->total_latency += latency;
+			if (latency > s->max_latency) s->max_latency = latency;
+		}
+	}
+	check_pending(start);
+	nested = nested_cycles;
+	(*handler)();
+	elapsed = ARM_DWT_CYCCNT - start;
+	cycles = elapsed - (nested_cycles - nested);
+	nested_cycles = nested + elapsed;
+	s->count++;
+	s->total_cycles += cycles;
+	if (cycles > s->max_cycles) s->max_cycles = cycles;
+	check_pending(ARM_DWT_CYCCNT);
+}
+
+FLASHMEM
+void IRQTraceClass::begin()
+{
+	ARM_DEMCR |= ARM_DEMCR_TRCENA;
+	ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+	for (int i=0; i < NUM_VECTORS; i++) {
+		if (i < FIRST_TRACED) {
+			trace_vectors[i] = _VectorsRam[i];
+		} else if (exclude_mask[i >> 5] & (1u << (i & 31))) {
+			trace_vectors[i] = &irq_direct_isr;
+		} else {
+			trace_vectors[i] = &irq_trace_isr;
+		}
+	}
+	asm volatile("dsb");
+	SCB_VTOR = (uint32_t)trace_vectors;
+	asm volatile("dsb\nisb");
+}
+
+// C linkage, so code which can't depend on IRQTrace can call it through
+// a weak reference, like Profiler does for its GPT2 interrupt
+extern "C" void irq_trace_exclude(int irq)
+{
+	if (irq < -2 || irq >= NVIC_NUM_INTERRUPTS) return;
+	uint32_t v = irq + 16;
+	__disable_irq();
+	exclude_mask[v >> 5] |= 1u << (v & 31);
+	trace_vectors[v] = &irq_direct_isr;
+	__enable_irq();
+}
+
+void IRQTraceClass::exclude(int irq)
+{
+	irq_trace_exclude(irq);
+}
+
+FLASHMEM
+void IRQTraceClass::end()
+{
+	SCB_VTOR = (uint32_t)_VectorsRam;
+	asm volatile("dsb\nisb");
+}
+
+FLASHMEM
+void IRQTraceClass::reset()
+{
+	__disable_irq();
+	memset(trace_stats, 0, sizeof(trace_stats));
+	memset(pend_seen, 0, sizeof(pend_seen));
+	__enable_irq();
+}
+
+FLASHMEM
+void IRQTraceClass::snapshot(struct irq_trace_stats *stats)
+{
+	__disable_irq();
+	memcpy(stats, trace_stats, sizeof(trace_stats));
+	__enable_irq();
+}
+
+FLASHMEM
+bool IRQTraceClass::snapshot(int irq, struct irq_trace_stats *stats)
+{
+	if (irq < -2 || irq >= NVIC_NUM_INTERRUPTS) return false;
+	__disable_irq();
+	*stats = trace_stats[irq + 16];
+	__enable_irq();
+	return stats->count > 0;
+}
+
+FLASHMEM
+static size_t print_us(Print& p, uint64_t cycles, uint32_t count)
+{
+	char buf[16];
+	if (count == 0) return p.print("       -");
+	uint32_t hundredths = cycles * 100 / count / (F_CPU_ACTUAL / 1000000);
+	snprintf(buf, sizeof(buf), "%5lu.%02lu", (unsigned long)(hundredths / 100),
+		(unsigned long)(hundredths % 100));
+	return p.print(buf);
+}
+
+FLASHMEM
+size_t IRQTraceClass::printTo(Print& p) const
+{
+	size_t n = 0;
+	n += p.println(" IRQ  handler       count   avg us  max us  avg lat max lat");
+	for (int v=FIRST_TRACED; v < NUM_VECTORS; v++) {
+		struct irq_trace_stats s;
+		__disable_irq();
+		s = trace_stats[v];
+		__enable_irq();
+		if (s.count == 0) continue;
+		char buf[40];
+		snprintf(buf, sizeof(buf), "%4d  %08X %10lu ", v - 16,
+			(unsigned int)_VectorsRam[v], (unsigned long)s.count);
+		n += p.print(buf);
+		n += print_us(p, s.total_cycles, s.count);
+		n += print_us(p, s.max_cycles, 1);
+		n += p.print(' ');
+		n += print_us(p, s.total_latency, s.latency_count);
+		n += print_us(p, s.max_latency, s.latency_count ? 1 : 0);
+		n += p.println();
+	}
+	return n;
+}
+
+IRQTraceClass IRQTrace;
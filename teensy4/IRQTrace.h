@@ -0,0 +1,79 @@
+/* Teensyduino Core Library
+ * http://www.pjrc.com/teensy/
+ * Copyright (c) 2021 PJRC.COM, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * 1. The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * 2. If the Software is incorporated into a build system that allows
+ * selection among a list of target devices, then similar target
+ * devices manufactured by PJRC.COM must be included in the list of
+ * target devices and selectable in the same manner.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <Printable.h>
+
+// Interrupt duration and latency tracing.  While active, the CPU uses a
+// second vector table where every interrupt goes through a small
+// trampoline, which measures each handler with the DWT cycle counter and
+// then calls the normal handler from _VectorsRam.  attachInterruptVector()
+// keeps working normally.
+//
+// Duration excludes time spent in higher priority interrupts which nest
+// inside the handler.  Latency is measured from when the interrupt was
+// seen pending (checked as each traced handler starts and ends) to when
+// its handler started, so it shows how long other interrupts delayed it.
+// Interrupts which become pending while no handler is running are not
+// included in the latency numbers.
+//
+// The trampoline calls each handler as a normal function, so a handler
+// which reads EXC_RETURN from LR or finds its exception frame with MSP or
+// PSP would see the trampoline's state instead.  Use exclude() for those
+// interrupts.  Excluded interrupts jump directly to their handler and are
+// not measured.  Profiler excludes its GPT2 interrupt automatically.
+
+struct irq_trace_stats {
+	uint32_t count;          // times the handler ran
+	uint32_t max_cycles;     // longest handler run
+	uint64_t total_cycles;
+	uint32_t latency_count;  // runs with a measured latency
+	uint32_t max_latency;    // cycles from pending to handler start
+	uint64_t total_latency;
+};
+
+class IRQTraceClass: public Printable {
+public:
+	static void begin();
+	static void end();
+	static void reset();
+	// do not trace this IRQ, for handlers which read their exception frame
+	static void exclude(int irq);
+	// copy stats for all NVIC_NUM_INTERRUPTS+16 vectors, index is the
+	// vector number (IRQ number + 16)
+	static void snapshot(struct irq_trace_stats *stats);
+	// copy stats for one IRQ, return false if it has not run
+	static bool snapshot(int irq, struct irq_trace_stats *stats);
+	// print a table of all interrupts which have run
+	virtual size_t printTo(Print& p) const;
+};
+
+extern IRQTraceClass IRQTrace;
@@ -0,0 +1,179 @@
+/* Teensyduino Core Library
+ * http://www.pjrc.com/teensy/
+ * Copyright (c) 2021 PJRC.COM, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * 1. The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * 2. If the Software is incorporated into a build system that allows
+ * selection among a list of target devices, then similar target
+ * devices manufactured by PJRC.COM must be included in the list of
+ * target devices and selectable in the same manner.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include <Profiler.h>
+
+#if (PROFILER_TABLE_SIZE & (PROFILER_TABLE_SIZE - 1)) != 0
+#error "PROFILER_TABLE_SIZE must be a power of 2"
+#endif
+
+struct profiler_entry_struct {
+	uint32_t pc;
+	uint32_t lr;
+	uint32_t count;
+};
+
+// placed in DTCM (normal RAM) so sampling never misses the cache
+static struct profiler_entry_struct profiler_table[PROFILER_TABLE_SIZE];
+static volatile uint32_t profiler_samples = 0;
+static volatile uint32_t profiler_dropped = 0;
+static volatile uint32_t profiler_cycles = 0;
+static uint32_t profiler_rate = 0;
+
+extern "C" void profiler_sample(const uint32_t *stack) __attribute__((used));
+extern "C" void irq_trace_exclude(int irq) __attribute__((weak)); // IRQTrace.cpp
+
+// The interrupted code's PC and LR are in the exception frame.  Read the
+// stack pointer before any C code can push to it.
+__attribute__((naked))
+static void profiler_isr(void)
+{
+	asm volatile(
+		"tst	lr, #4\n"
+		"ite	eq\n"
+		"mrseq	r0, msp\n"
+		"mrsne	r0, psp\n"
+		"b	profiler_sample\n");
+}
+
+void profiler_sample(const uint32_t *stack)
+{
+	uint32_t begin = ARM_DWT_CYCCNT;
+	GPT2_SR = GPT_SR_OF1;
+	uint32_t pc = stack[6];
+	uint32_t lr = stack[5];
+	uint32_t i = ((pc >> 1) ^ (lr * 0x9E3779B1)) & (PROFILER_TABLE_SIZE - 1);
+	for (uint32_t n=0; n < 8; n++) {
+		struct profiler_entry_struct *e = profiler_table + i;
+		if (e->count == 0) {
+			e->pc = pc;
+			e->lr = lr;
+			e->count = 1;
+			break;
+		}
+		if (e->pc == pc && e->lr == lr) {
+			e->count++;
+			break;
+		}
+		if (n == 7) profiler_dropped++;
+		i = (i + 1) & (PROFILER_TABLE_SIZE - 1);
+	}
+	profiler_samples++;
+	profiler_cycles += ARM_DWT_CYCCNT - begin;
+	asm("dsb"); // wait for GPT2_SR write, so the interrupt isn't repeated
+}
+
+FLASHMEM
+bool ProfilerClass::begin(uint32_t rate)
+{
+	if (rate == 0 || rate > 100000) return false;
+	NVIC_DISABLE_IRQ(IRQ_GPT2);
+	CCM_CCGR0 |= CCM_CCGR0_GPT2_BUS(CCM_CCGR_ON) | CCM_CCGR0_GPT2_SERIAL(CCM_CCGR_ON);
+	GPT2_CR = 0;
+	GPT2_PR = 0;
+	GPT2_SR = 0x3F;
+	// 24 MHz clock, restart mode: counts up to OCR1, then back to zero
+	GPT2_OCR1 = 24000000 / rate - 1;
+	GPT2_IR = GPT_IR_OF1IE;
+	GPT2_CR = GPT_CR_CLKSRC(1) | GPT_CR_ENMOD | GPT_CR_EN;
+	profiler_rate = rate;
+	// profiler_isr reads its exception frame, so IRQTrace must not wrap it
+	if (irq_trace_exclude) irq_trace_exclude(IRQ_GPT2);
+	attachInterruptVector(IRQ_GPT2, profiler_isr);
+	NVIC_SET_PRIORITY(IRQ_GPT2, 0);
+	NVIC_ENABLE_IRQ(IRQ_GPT2);
+	return true;
+}
+
+FLASHMEM
+void ProfilerClass::end()
+{
+	NVIC_DISABLE_IRQ(IRQ_GPT2);
+	GPT2_CR = 0;
+	GPT2_IR = 0;
+	GPT2_SR = 0x3F;
+	profiler_rate = 0;
+}
+
+FLASHMEM
+void ProfilerClass::clear()
+{
+	__disable_irq();
+	memset(profiler_table, 0, sizeof(profiler_table));
+	profiler_samples = 0;
+	profiler_dropped = 0;
+	profiler_cycles = 0;
+	__enable_irq();
+}
+
+uint32_t ProfilerClass::samples()
+{
+	return profiler_samples;
+}
+
+uint32_t ProfilerClass::dropped()
+{
+	return profiler_dropped;
+}
+
+// Text format read by tools/profile_capture.py:
+//   # profile rate=1000 samples=12345 dropped=0 cycles=123456
+//   <pc hex> <lr hex> <count>
+//   # end
+FLASHMEM
+size_t ProfilerClass::printTo(Print& p) const
+{
+	size_t n = 0;
+	bool running = NVIC_IS_ENABLED(IRQ_GPT2);
+	NVIC_DISABLE_IRQ(IRQ_GPT2);
+	n += p.print("# profile rate=");
+	n += p.print(profiler_rate);
+	n += p.print(" samples=");
+	n += p.print(profiler_samples);
+	n += p.print(" dropped=");
+	n += p.print(profiler_dropped);
+	n += p.print(" cycles=");
+	n += p.println(profiler_cycles);
+	for (uint32_t i=0; i < PROFILER_TABLE_SIZE; i++) {
+		const struct profiler_entry_struct *e = profiler_table + i;
+		if (e->count == 0) continue;
+		n += p.print(e->pc, HEX);
+		n += p.print(' ');
+		n += p.print(e->lr, HEX);
+		n += p.print(' ');
+		n += p.println(e->count);
+	}
+	n += p.println("# end");
+	if (running) NVIC_ENABLE_IRQ(IRQ_GPT2);
+	return n;
+}
+
+ProfilerClass Profiler;
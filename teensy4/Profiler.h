@@ -0,0 +1,61 @@
+/* Teensyduino Core Library
+ * http://www.pjrc.com/teensy/
+ * Copyright (c) 2021 PJRC.COM, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * 1. The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * 2. If the Software is incorporated into a build system that allows
+ * selection among a list of target devices, then similar target
+ * devices manufactured by PJRC.COM must be included in the list of
+ * target devices and selectable in the same manner.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <Printable.h>
+
+// Statistical CPU profiler.  A high priority timer interrupt (GPT2) samples
+// the address where the CPU was executing, and the return address (LR),
+// into a table in DTCM.  Printing the profile gives one line per unique
+// address pair, which tools/profile_capture.py turns into a report of
+// where the time was spent.  Code running with interrupts disabled is
+// seen only after interrupts are enabled again.
+
+#ifndef PROFILER_TABLE_SIZE
+#define PROFILER_TABLE_SIZE 1024  // unique pc/lr pairs, must be a power of 2
+#endif
+
+class ProfilerClass: public Printable {
+public:
+	// start sampling, rate is samples per second (up to 100000)
+	static bool begin(uint32_t rate = 1000);
+	static void end();
+	// discard all samples
+	static void clear();
+	// samples taken, samples lost because the table was full
+	static uint32_t samples();
+	static uint32_t dropped();
+	// print the profile (stops sampling while printing)
+	virtual size_t printTo(Print& p) const;
+	operator bool() { return samples() > 0; }
+};
+
+extern ProfilerClass Profiler;
@@ -57,6 +57,7 @@
 #include "usb_joystick.h"
 #include "usb_midi.h"
 #include "usb_rawhid.h"
+#include "usb_msc.h"
 #include "usb_flightsim.h"
 //#include "usb_mtp.h"
 #include "usb_audio.h"
@@ -68,6 +69,8 @@
 #include "elapsedMillis.h"
 #include "IntervalTimer.h"
 #include "CrashReport.h"
+#include "Profiler.h"
+#include "IRQTrace.h"
 
 uint16_t makeWord(uint16_t w);
 uint16_t makeWord(byte h, byte l);
@@ -20,6 +20,8 @@ volatile uint32_t F_BUS_ACTUAL = 132000000;
 // https://forum.pjrc.com/index.php?threads/75798/#post-349215
 
 uint32_t set_arm_clock(uint32_t frequency);
+extern volatile uint32_t systick_cycle_count;
+extern void nanos_set_frequency(uint32_t frequency); // delay.c
 
 
 // stuff needing wait handshake:
@@ -160,9 +162,20 @@ uint32_t set_arm_clock(uint32_t frequency)
 	CCM_CBCDR &= ~CCM_CBCDR_PERIPH_CLK_SEL;
 	while (CCM_CDHIPR & CCM_CDHIPR_PERIPH_CLK_SEL_BUSY) ; // wait
 
+	uint32_t primask;
+	__asm__ volatile("mrs %0, primask\n" : "=r" (primask)::);
+	__disable_irq();
 	F_CPU_ACTUAL = frequency;
 	F_BUS_ACTUAL = frequency / div_ipg;
 	scale_cpu_cycles_to_microseconds = 0xFFFFFFFFu / (uint32_t)(frequency / 1000000u);
+	// micros() counts CPU cycles since the last SysTick, so restart that
+	// count at the new speed.  SysTick runs from a fixed 100 kHz clock,
+	// which tells how far into this millisecond we are.
+	uint32_t elapsed = SYST_RVR - SYST_CVR + 1; // 10 us units, rounded up
+	if (SCB_ICSR & SCB_ICSR_PENDSTSET) elapsed = SYST_RVR + 1;
+	systick_cycle_count = ARM_DWT_CYCCNT - elapsed * 10 * (frequency / 1000000);
+	nanos_set_frequency(frequency);
+	if (!primask) __enable_irq();
 
 	printf("New Frequency: ARM=%u, IPG=%u\n", frequency, frequency / div_ipg);
 
@@ -2421,6 +2421,7 @@ extern uint8_t yield_active_check_flags;
 #define YIELD_CHECK_EVENT_RESPONDER 0x04  // User has created eventResponders that use yield
 #define YIELD_CHECK_USB_SERIALUSB1  0x08  // Check for SerialUSB1
 #define YIELD_CHECK_USB_SERIALUSB2  0x10  // Check for SerialUSB2
+#define YIELD_CHECK_USB_MSC         0x20  // USB Mass Storage commands
 
 // Allow other functions to run.  Typically these will be serial event handlers
 // and functions call by certain libraries when lengthy operations complete.
@@ -2433,6 +2434,42 @@ extern volatile uint32_t F_BUS_ACTUAL;
 extern volatile uint32_t scale_cpu_cycles_to_microseconds;
 extern volatile uint32_t systick_millis_count;
 
+// Time in microseconds from reset until the end of each startup phase.
+// Phases not used on this board (external_ram on Teensy 4.0) are the same
+// as the phase before.  constructors is the time main() began.
+struct teensy_boot_time_struct {
+	volatile uint32_t memory_init;  // copy code to ITCM, data to DTCM, clear bss
+	volatile uint32_t clock_setup;  // cache, systick, PLLs, CPU speed, RTC
+	volatile uint32_t external_ram; // PSRAM detect and configure (Teensy 4.1)
+	volatile uint32_t peripherals;  // analog, pwm, tempmon, startup_middle_hook
+	volatile uint32_t usb_init;     // usb_init() and USB startup delay
+	volatile uint32_t constructors; // startup_late_hook and C++ constructors
+};
+extern struct teensy_boot_time_struct teensy_boot_time;
+
+// Automatic CPU speed control.  The governor measures load as the time
+// not spent in delay() (including yield() called by delay) and changes
+// the CPU clock between the given frequencies, lowest first.  Returns
+// 0 if none of the frequencies are usable.  PWM frequencies and
+// micros() stay correct across changes.  Serial, IntervalTimer and
+// SysTick use fixed 24 MHz based clocks, so they are not affected.
+int cpu_governor_begin(const uint32_t *frequencies, uint32_t count);
+void cpu_governor_end(void);  // go back to the highest frequency
+// load percent to go to the highest speed, below which to slow down,
+// and how often (milliseconds) to check the load
+void cpu_governor_config(uint32_t up_percent, uint32_t down_percent, uint32_t window_ms);
+uint32_t cpu_governor_load(void); // percent busy in the last window
+void cpu_governor_idle(uint32_t usec);
+void cpu_governor_update(void);
+extern volatile uint8_t cpu_governor_active;
+
+// Tickless idle.  When enabled, delay() sleeps with WFI instead of waking
+// every millisecond for SysTick.  tickless_sleep() can be used to wait
+// for any interrupt, at most usec microseconds, the same way.
+void tickless_idle(int enable);
+void tickless_sleep(uint32_t usec);
+extern volatile uint8_t tickless_idle_enabled;
+
 static inline uint32_t millis(void) __attribute__((always_inline, unused));
 // Returns the number of milliseconds since your program started running.
 // This 32 bit number will roll back to zero after about 49.7 days.  For a
@@ -2444,6 +2481,36 @@ static inline uint32_t millis(void)
 
 uint32_t micros(void);
 
+// SysTick keeps two copies of the cycles64() state.  It updates the copy
+// not in use, then increments cycle_count_seq to publish it, so a reader
+// in a higher priority interrupt always finds a consistent pair.
+struct cycle_count_state {
+	uint32_t high;
+	uint32_t last;
+};
+extern volatile struct cycle_count_state cycle_count[2];
+extern volatile uint32_t cycle_count_seq;
+static inline uint64_t cycles64(void) __attribute__((always_inline, unused));
+// Returns the number of CPU cycles since startup, as a 64 bit number which
+// never rolls over.  ARM_DWT_CYCCNT is the low 32 bits.  The high 32 bits
+// are counted by SysTick, which notices each rollover of ARM_DWT_CYCCNT.
+static inline uint64_t cycles64(void)
+{
+	uint32_t seq, high, last, now;
+	do {
+		seq = cycle_count_seq;
+		high = cycle_count[seq & 1].high;
+		last = cycle_count[seq & 1].last;
+		now = ARM_DWT_CYCCNT;
+	} while (seq != cycle_count_seq);
+	if (now < last) high++; // rolled over since the last SysTick
+	return ((uint64_t)high << 32) | now;
+}
+
+// Returns the number of nanoseconds since startup as a 64 bit number,
+// based on cycles64().  It remains correct when the CPU clock changes.
+uint64_t nanos64(void);
+
 static inline void delayMicroseconds(uint32_t) __attribute__((always_inline, unused));
 // Wait for a number of microseconds.  During this time, interrupts remain
 // active, but the rest of your program becomes effectively stalled.  For shorter
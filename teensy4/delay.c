@@ -7,6 +7,12 @@ volatile uint32_t systick_millis_count = 0;
 volatile uint32_t systick_cycle_count = 0;
 volatile uint32_t scale_cpu_cycles_to_microseconds = 0;
 uint32_t systick_safe_read;	 // micros() synchronization
+volatile struct cycle_count_state cycle_count[2]; // cycles64() state, see core_pins.h
+volatile uint32_t cycle_count_seq = 0;
+// nanos64() = nanos_base + (cycles64() - nanos_base_cycles) * nanos_scale / 2^32
+static uint64_t nanos_base = 0;
+static uint64_t nanos_base_cycles = 0;
+static uint64_t nanos_scale = ((uint64_t)1000000000 << 32) / 396000000;
 
 //The 24 MHz XTALOSC can be the external clock source of SYSTICK. 
 //Hardware devides this down to 100KHz. (RM Rev2, 13.3.21 PG 986)
@@ -59,12 +65,26 @@ void delay(uint32_t msec)
 
 	if (msec == 0) return;
 	start = micros();
+	uint32_t idle = start;
 	while (1) {
 		while ((micros() - start) >= 1000) {
-			if (--msec == 0) return;
+			if (--msec == 0) {
+				if (cpu_governor_active) cpu_governor_idle(micros() - idle);
+				return;
+			}
 			start += 1000;
 		}
 		yield();
+		if (tickless_idle_enabled && msec > 1) {
+			uint32_t elapsed = micros() - start;
+			if (elapsed < 1000) tickless_sleep(msec * 1000 - elapsed - 20);
+		}
+		if (cpu_governor_active) {
+			uint32_t now = micros();
+			cpu_governor_idle(now - idle);
+			idle = now;
+			cpu_governor_update();
+		}
 	}
 	// TODO...
 }
@@ -90,6 +110,33 @@ uint32_t micros(void)
 	return usec;
 }
 
+static inline uint64_t cycles_to_nanos(uint64_t cycles)
+{
+	// 64 x 33 bit multiply, keeping the upper 64 bits of the result
+	return (cycles >> 32) * nanos_scale + (((cycles & 0xFFFFFFFF) * (nanos_scale & 0xFFFFFFFF)) >> 32)
+		+ (cycles & 0xFFFFFFFF) * (nanos_scale >> 32);
+}
+
+uint64_t nanos64(void)
+{
+	uint32_t primask;
+	__asm__ volatile("mrs %0, primask\n" : "=r" (primask)::);
+	__disable_irq();
+	uint64_t ns = nanos_base + cycles_to_nanos(cycles64() - nanos_base_cycles);
+	if (!primask) __enable_irq();
+	return ns;
+}
+
+// called by set_arm_clock() with interrupts disabled, after the CPU clock
+// has changed to a new frequency
+void nanos_set_frequency(uint32_t frequency)
+{
+	uint64_t cycles = cycles64();
+	nanos_base += cycles_to_nanos(cycles - nanos_base_cycles);
+	nanos_base_cycles = cycles;
+	nanos_scale = ((uint64_t)1000000000 << 32) / frequency;
+}
+
 #if 0 // kept to compare test to cycle count micro()
 uint32_t micros(void)
 {
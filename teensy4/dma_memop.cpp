@@ -0,0 +1,286 @@
+/* Teensyduino Core Library
+ * http://www.pjrc.com/teensy/
+ * Copyright (c) 2018 PJRC.COM, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * 1. The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * 2. If the Software is incorporated into a build system that allows
+ * selection among a list of target devices, then similar target
+ * devices manufactured by PJRC.COM must be included in the list of
+ * target devices and selectable in the same manner.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "DMAChannel.h"
+#include "EventResponder.h"
+#include <string.h>
+
+// Asynchronous memcpy and memset.  Operations are kept in a single FIFO
+// queue and run on a small number of DMA channels, which are allocated
+// the first time a copy is too large to be done by the CPU.
+//
+// In cached memory the DMA only writes whole 32 byte cache rows.  The
+// partial rows at the start and end are done by the CPU when the operation
+// is queued, so deleting the destination from the cache afterwards can't
+// discard CPU writes to neighbouring variables.
+
+#define DMA_MEMOP_CHANNELS 2
+
+static DMAChannel memop_dma0(false);
+static DMAChannel memop_dma1(false);
+static DMAChannel * const memop_dma[DMA_MEMOP_CHANNELS] = {&memop_dma0, &memop_dma1};
+static dma_memop_t *memop_active[DMA_MEMOP_CHANNELS];
+static dma_memop_t *memop_head = nullptr;
+static dma_memop_t *memop_tail = nullptr;
+
+static void memop_isr0(void);
+static void memop_isr1(void);
+static void (* const memop_isr[DMA_MEMOP_CHANNELS])(void) = {memop_isr0, memop_isr1};
+static void memop_error_isr(void);
+static void (*memop_error_chain)(void) = nullptr;
+extern "C" void unused_interrupt_vector(void);
+
+static bool is_peripheral(const void *addr)
+{
+	return (uint32_t)addr >= 0x40000000 && (uint32_t)addr < 0x60000000;
+}
+
+static bool is_cached(const void *addr)
+{
+	return (uint32_t)addr >= 0x20200000 && !is_peripheral(addr);
+}
+
+static void memop_complete(dma_memop_t *op, uint8_t status)
+{
+	op->status = status;
+	if (op->callback) (*op->callback)(op);
+}
+
+// bytes at the start and end of the destination done by the CPU
+static uint32_t cpu_head(const dma_memop_t *op)
+{
+	if (!is_cached(op->dst)) return 0;
+	return -(uint32_t)op->dst & 31;
+}
+
+static uint32_t cpu_tail(const dma_memop_t *op)
+{
+	if (!is_cached(op->dst)) return 0;
+	return ((uint32_t)op->dst + op->len) & 31;
+}
+
+// DMA errors go to IRQ_DMA_ERROR, not the channel's interrupt
+static void memop_error_setup(void)
+{
+	void (*isr)(void) = _VectorsRam[IRQ_DMA_ERROR + 16];
+	if (isr == memop_error_isr) return;
+	if (isr != unused_interrupt_vector) memop_error_chain = isr;
+	attachInterruptVector(IRQ_DMA_ERROR, memop_error_isr);
+	NVIC_ENABLE_IRQ(IRQ_DMA_ERROR);
+}
+
+// start queued operations on any idle channels, called with interrupts off.
+// Returns a list of operations which could not be started, for the caller
+// to complete with memop_fail() after interrupts are enabled again.
+static dma_memop_t * memop_start(void)
+{
+	dma_memop_t *failed = nullptr;
+
+	for (int i=0; i < DMA_MEMOP_CHANNELS && memop_head; i++) {
+		if (memop_active[i]) continue;
+		DMAChannel *dma = memop_dma[i];
+		if (!dma->TCD) {
+			dma->begin();
+			if (!dma->TCD) continue;
+			dma->attachInterrupt(memop_isr[i]);
+			memop_error_setup();
+			DMA_SEEI = dma->channel;
+		}
+		dma_memop_t *op = memop_head;
+		memop_head = op->next;
+		if (!memop_head) memop_tail = nullptr;
+		op->next = nullptr;
+		uint32_t head = cpu_head(op);
+		uint32_t len = op->len - head - cpu_tail(op);
+		uint8_t *dst = (uint8_t *)op->dst + head;
+		bool ok;
+		// the interrupt is set in the TCD before the channel starts, so
+		// even a very short operation can't complete without it
+		if (op->src) {
+			ok = dma->copyMemory(dst, (const uint8_t *)op->src + head, len, true);
+		} else {
+			ok = dma->fillMemory(dst, op->pattern, len, true);
+		}
+		if (!ok) {
+			op->next = failed;
+			failed = op;
+			i--; // try again on this channel
+			continue;
+		}
+		op->status = DMA_MEMOP_RUNNING;
+		memop_active[i] = op;
+	}
+	return failed;
+}
+
+static void memop_fail(dma_memop_t *op)
+{
+	while (op) {
+		dma_memop_t *next = op->next;
+		op->next = nullptr;
+		memop_complete(op, DMA_MEMOP_ERROR);
+		op = next;
+	}
+}
+
+static void memop_finish(int i, uint8_t status)
+{
+	__disable_irq();
+	dma_memop_t *op = memop_active[i];
+	memop_active[i] = nullptr;
+	__enable_irq();
+	if (op) {
+		// discard anything read into the cache while the DMA was running
+		uint32_t head = cpu_head(op);
+		uint32_t len = op->len - head - cpu_tail(op);
+		if (is_cached(op->dst)) arm_dcache_delete((uint8_t *)op->dst + head, len);
+		memop_complete(op, status);
+	}
+	__disable_irq();
+	dma_memop_t *failed = memop_start();
+	__enable_irq();
+	memop_fail(failed);
+}
+
+static void memop_isr_common(int i)
+{
+	DMAChannel *dma = memop_dma[i];
+	dma->clearInterrupt();
+	memop_finish(i, DMA_MEMOP_DONE);
+}
+
+static void memop_error_isr(void)
+{
+	uint32_t err = DMA_ERR;
+	for (int i=0; i < DMA_MEMOP_CHANNELS; i++) {
+		DMAChannel *dma = memop_dma[i];
+		if (!dma->TCD || !(err & (1u << dma->channel))) continue;
+		dma->disable();
+		DMA_CERR = dma->channel;
+		err &= ~(1u << dma->channel);
+		memop_finish(i, DMA_MEMOP_ERROR);
+	}
+	if (err && memop_error_chain) (*memop_error_chain)();
+}
+
+static void memop_isr0(void)
+{
+	memop_isr_common(0);
+}
+
+static void memop_isr1(void)
+{
+	memop_isr_common(1);
+}
+
+static int memop_queue(dma_memop_t *op)
+{
+	op->next = nullptr;
+	op->status = DMA_MEMOP_QUEUED;
+	uint32_t primask;
+	__asm__ volatile("mrs %0, primask\n" : "=r" (primask)::);
+	__disable_irq();
+	if (memop_tail) {
+		memop_tail->next = op;
+	} else {
+		memop_head = op;
+	}
+	memop_tail = op;
+	dma_memop_t *failed = memop_start();
+	if (!(primask & 1)) __enable_irq();
+	memop_fail(failed);
+	return 1;
+}
+
+int dma_memcpy_async(dma_memop_t *op, void *dst, const void *src, uint32_t len,
+	void (*callback)(dma_memop_t *op))
+{
+	if (!op || !dst || !src) return 0;
+	op->dst = dst;
+	op->src = src;
+	op->len = len;
+	op->callback = callback;
+	if (len < DMA_MEMOP_MIN_LEN || is_peripheral(dst) || is_peripheral(src)) {
+		// too small to be worth the DMA setup, or peripheral memory
+		memcpy(dst, src, len);
+		memop_complete(op, DMA_MEMOP_DONE);
+		return 1;
+	}
+	uint32_t head = cpu_head(op);
+	uint32_t tail = cpu_tail(op);
+	memcpy(dst, src, head);
+	memcpy((uint8_t *)dst + len - tail, (const uint8_t *)src + len - tail, tail);
+	return memop_queue(op);
+}
+
+int dma_memset_async(dma_memop_t *op, void *dst, int c, uint32_t len,
+	void (*callback)(dma_memop_t *op))
+{
+	if (!op || !dst) return 0;
+	op->dst = dst;
+	op->src = nullptr;
+	op->len = len;
+	op->callback = callback;
+	if (len < DMA_MEMOP_MIN_LEN || is_peripheral(dst)) {
+		memset(dst, c, len);
+		memop_complete(op, DMA_MEMOP_DONE);
+		return 1;
+	}
+	memset(op->pattern, c, sizeof(op->pattern));
+	uint32_t tail = cpu_tail(op);
+	memset(dst, c, cpu_head(op));
+	memset((uint8_t *)dst + len - tail, c, tail);
+	return memop_queue(op);
+}
+
+void dma_memop_wait(const dma_memop_t *op)
+{
+	while (!dma_memop_done(op)) yield();
+}
+
+static void memop_event(dma_memop_t *op)
+{
+	EventResponder *event = (EventResponder *)op->context;
+	event->triggerEvent(op->status == DMA_MEMOP_DONE ? (int)op->len : -1, op);
+}
+
+int dma_memcpy_async(dma_memop_t *op, void *dst, const void *src, uint32_t len, EventResponder &event)
+{
+	if (!op) return 0;
+	op->context = &event;
+	return dma_memcpy_async(op, dst, src, len, memop_event);
+}
+
+int dma_memset_async(dma_memop_t *op, void *dst, int c, uint32_t len, EventResponder &event)
+{
+	if (!op) return 0;
+	op->context = &event;
+	return dma_memset_async(op, dst, c, len, memop_event);
+}
@@ -85,5 +85,45 @@ public:
 	elapsedMicros operator + (unsigned long val) const { elapsedMicros r(*this); r.us -= val; return r; }
 };
 
+// elapsedCycles acts as an integer which automatically increments with every CPU clock cycle.
+// It is 64 bits, so it does not roll over.  Reading it is very fast,
+// but the rate changes if the CPU clock is changed.
+class elapsedCycles
+{
+private:
+	uint64_t cycles;
+public:
+	elapsedCycles(void) { cycles = cycles64(); }
+	elapsedCycles(uint64_t val) { cycles = cycles64() - val; }
+	elapsedCycles(const elapsedCycles &orig) { cycles = orig.cycles; }
+	operator uint64_t () const { return cycles64() - cycles; }
+	elapsedCycles & operator = (const elapsedCycles &rhs) { cycles = rhs.cycles; return *this; }
+	elapsedCycles & operator = (uint64_t val) { cycles = cycles64() - val; return *this; }
+	elapsedCycles & operator -= (uint64_t val)      { cycles += val ; return *this; }
+	elapsedCycles & operator += (uint64_t val)      { cycles -= val ; return *this; }
+	elapsedCycles operator - (uint64_t val) const { elapsedCycles r(*this); r.cycles += val; return r; }
+	elapsedCycles operator + (uint64_t val) const { elapsedCycles r(*this); r.cycles -= val; return r; }
+};
+
+// elapsedNanos acts as an integer which automatically increments 1 billion times per
+// second.
+// It is 64 bits, so it does not roll over.  The resolution is one CPU cycle.
+class elapsedNanos
+{
+private:
+	uint64_t ns;
+public:
+	elapsedNanos(void) { ns = nanos64(); }
+	elapsedNanos(uint64_t val) { ns = nanos64() - val; }
+	elapsedNanos(const elapsedNanos &orig) { ns = orig.ns; }
+	operator uint64_t () const { return nanos64() - ns; }
+	elapsedNanos & operator = (const elapsedNanos &rhs) { ns = rhs.ns; return *this; }
+	elapsedNanos & operator = (uint64_t val) { ns = nanos64() - val; return *this; }
+	elapsedNanos & operator -= (uint64_t val)      { ns += val ; return *this; }
+	elapsedNanos & operator += (uint64_t val)      { ns -= val ; return *this; }
+	elapsedNanos operator - (uint64_t val) const { elapsedNanos r(*this); r.ns += val; return r; }
+	elapsedNanos operator + (uint64_t val) const { elapsedNanos r(*this); r.ns -= val; return r; }
+};
+
 #endif // __cplusplus
 #endif // elapsedMillis_h
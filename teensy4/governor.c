@@ -0,0 +1,141 @@
+/* Teensyduino Core Library
+ * http://www.pjrc.com/teensy/
+ * Copyright (c) 2021 PJRC.COM, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * 1. The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * 2. If the Software is incorporated into a build system that allows
+ * selection among a list of target devices, then similar target
+ * devices manufactured by PJRC.COM must be included in the list of
+ * target devices and selectable in the same manner.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "core_pins.h"
+#include "avr/pgmspace.h"
+#include "debug/printf.h"
+
+// The CPU governor steps the ARM clock between a few frequencies according
+// to load, similar to the Linux "ondemand" governor.  When the load goes
+// above up_percent, it goes to the highest frequency.  When it is below
+// down_percent, it goes to the lowest frequency which can do the same work
+// at less than up_percent load.  Frequency changes are only made from
+// delay() or between calls to loop(), never from an interrupt.
+
+#define MAX_LEVELS 8
+
+extern uint32_t set_arm_clock(uint32_t frequency); // clockspeed.c
+extern void pwm_bus_clock_changed(uint32_t old_bus); // pwm.c
+
+volatile uint8_t cpu_governor_active = 0;
+static uint8_t num_levels = 0;
+static uint8_t level = 0;
+static uint8_t up_percent = 80;
+static uint8_t down_percent = 30;
+static uint8_t last_load = 100;
+static uint32_t window_usec = 50000;
+static uint32_t window_start;
+static uint32_t idle_usec;
+static uint32_t levels[MAX_LEVELS];
+
+static void governor_set_level(uint32_t n)
+{
+	uint32_t old_bus = F_BUS_ACTUAL;
+	printf("governor: %u -> %u MHz\n", levels[level] / 1000000, levels[n] / 1000000);
+	set_arm_clock(levels[n]);
+	pwm_bus_clock_changed(old_bus);
+	level = n;
+}
+
+FLASHMEM
+int cpu_governor_begin(const uint32_t *frequencies, uint32_t count)
+{
+	uint32_t i, n = 0;
+
+	cpu_governor_active = 0;
+	for (i=0; i < count && n < MAX_LEVELS; i++) {
+		// only ascending speeds within what set_arm_clock supports
+		if (frequencies[i] < 24000000 || frequencies[i] > 1008000000) continue;
+		if (n > 0 && frequencies[i] <= levels[n - 1]) continue;
+		levels[n++] = frequencies[i];
+	}
+	if (n == 0) return 0;
+	num_levels = n;
+	level = n - 1;
+	if (F_CPU_ACTUAL != levels[level]) governor_set_level(level);
+	idle_usec = 0;
+	window_start = micros();
+	cpu_governor_active = 1;
+	return 1;
+}
+
+FLASHMEM
+void cpu_governor_end(void)
+{
+	if (!cpu_governor_active) return;
+	cpu_governor_active = 0;
+	if (level != num_levels - 1) governor_set_level(num_levels - 1);
+}
+
+FLASHMEM
+void cpu_governor_config(uint32_t up, uint32_t down, uint32_t window_ms)
+{
+	if (up > 100) up = 100;
+	if (down >= up) down = up / 2;
+	if (window_ms < 1) window_ms = 1;
+	up_percent = up;
+	down_percent = down;
+	window_usec = window_ms * 1000;
+}
+
+uint32_t cpu_governor_load(void)
+{
+	return last_load;
+}
+
+void cpu_governor_idle(uint32_t usec)
+{
+	idle_usec += usec;
+}
+
+void cpu_governor_update(void)
+{
+	uint32_t now = micros();
+	uint32_t elapsed = now - window_start;
+	if (elapsed < window_usec) return;
+	uint32_t idle = idle_usec;
+	if (idle > elapsed) idle = elapsed;
+	uint32_t load = 100 - (uint32_t)((uint64_t)idle * 100 / elapsed);
+	window_start = now;
+	idle_usec = 0;
+	last_load = load;
+
+	uint32_t n = level;
+	if (load > up_percent) {
+		n = num_levels - 1;
+	} else if (load < down_percent) {
+		// work per second at the current speed, in MHz * percent
+		uint32_t work = levels[level] / 1000000 * load;
+		for (n=0; n < level; n++) {
+			if (levels[n] / 1000000 * up_percent > work) break;
+		}
+	}
+	if (n != level) governor_set_level(n);
+}
@@ -10346,6 +10346,13 @@ struct arm_fault_info_struct {
 	uint32_t crc;  // crc must be last
 };
 
+// Crash backtrace stored just below the crash report info (at 0x2027FF00)
+struct arm_fault_backtrace_struct {
+	uint32_t count;
+	uint32_t addr[30]; // addr[0] is the fault, others are return addresses
+	uint32_t crc;      // crc must be last
+};
+
 // Breadcrumbs stored in the top 128 bytes of OCRAM (at 0x2027FFC0)
 struct crashreport_breadcrumbs_struct {
 	uint32_t bitmask;
@@ -52,6 +52,7 @@ extern "C" int main(void)
 	while (1) {
 		loop();
 		yield();
+		if (cpu_governor_active) cpu_governor_update();
 	}
 #endif
 }
@@ -297,6 +297,43 @@ void analogWriteFrequency(uint8_t pin, float frequency)
 	}
 }
 
+// After F_BUS_ACTUAL changes, set every running PWM back to the frequency
+// it had with the old bus clock.  Duty cycles are scaled to match.
+void pwm_bus_clock_changed(uint32_t old_bus)
+{
+	static IMXRT_FLEXPWM_t * const flexpwm[4] = {&IMXRT_FLEXPWM1,
+		&IMXRT_FLEXPWM2, &IMXRT_FLEXPWM3, &IMXRT_FLEXPWM4};
+	static IMXRT_TMR_t * const qtimer[4] = {&IMXRT_TMR1, &IMXRT_TMR2,
+		&IMXRT_TMR3, &IMXRT_TMR4};
+	static const uint32_t qtimer_clock[4] = {CCM_CCGR6_QTIMER1(3),
+		CCM_CCGR6_QTIMER2(3), CCM_CCGR6_QTIMER3(3), CCM_CCGR6_QTIMER4(3)};
+	const uint16_t qtimer_pwm_mask = TMR_CTRL_CM(7) | TMR_CTRL_PCS(8) | TMR_CTRL_LENGTH | TMR_CTRL_OUTMODE(7);
+	const uint16_t qtimer_pwm_mode = TMR_CTRL_CM(1) | TMR_CTRL_PCS(8) | TMR_CTRL_LENGTH | TMR_CTRL_OUTMODE(6);
+	int i, sm;
+
+	if (old_bus == F_BUS_ACTUAL) return;
+	for (i=0; i < 4; i++) {
+		if ((CCM_CCGR4 & CCM_CCGR4_PWM1(3) << (i * 2)) == 0) continue;
+		IMXRT_FLEXPWM_t *p = flexpwm[i];
+		for (sm=0; sm < 4; sm++) {
+			if (!(p->MCTRL & FLEXPWM_MCTRL_RUN(1 << sm))) continue;
+			uint32_t prescale = (p->SM[sm].CTRL >> 4) & 7;
+			uint32_t div = ((uint32_t)p->SM[sm].VAL1 + 1) << prescale;
+			flexpwmFrequency(p, sm, 0, (float)old_bus / (float)div);
+		}
+	}
+	for (i=0; i < 4; i++) {
+		if ((CCM_CCGR6 & qtimer_clock[i]) == 0) continue;
+		IMXRT_TMR_t *p = qtimer[i];
+		for (sm=0; sm < 4; sm++) {
+			if ((p->CH[sm].CTRL & qtimer_pwm_mask) != qtimer_pwm_mode) continue;
+			uint32_t prescale = (p->CH[sm].CTRL >> 9) & 7;
+			uint32_t div = (65537 - p->CH[sm].LOAD + p->CH[sm].CMPLD1) << prescale;
+			quadtimerFrequency(p, sm, (float)old_bus / (float)div);
+		}
+	}
+}
+
 void flexpwm_init(IMXRT_FLEXPWM_t *p)
 {
 	int i;
@@ -16,8 +16,12 @@ extern unsigned long _sdata;
 extern unsigned long _edata;
 extern unsigned long _sbss;
 extern unsigned long _ebss;
+extern unsigned long _sbss_ocram;
+extern unsigned long _ebss_ocram;
 extern unsigned long _flexram_bank_config;
 extern unsigned long _estack;
+extern unsigned long __exidx_start;
+extern unsigned long __exidx_end;
 extern unsigned long _extram_start;
 extern unsigned long _extram_end;
 
@@ -43,6 +47,8 @@ uint32_t set_arm_clock(uint32_t frequency); // clockspeed.c
 extern void __libc_init_array(void); // C++ standard library
 
 uint8_t external_psram_size = 0;
+uint8_t external_psram_clock = 0; // MHz
+struct teensy_boot_time_struct teensy_boot_time;
 #ifdef ARDUINO_TEENSY41
 struct smalloc_pool extmem_smalloc_pool;
 #endif
@@ -59,6 +65,18 @@ FLASHMEM void startup_debug_reset(void) { __asm__ volatile("nop"); }
 
 static void ResetHandler2(void);
 
+// Boot phase timestamps are derived from the cycle counter, which is started
+// at the beginning of ResetHandler2 and runs at whatever the CPU clock is.
+static uint32_t boot_time_us;
+static uint32_t boot_time_cycles;
+static void boot_phase(volatile uint32_t *phase)
+{
+	uint32_t cycles = ARM_DWT_CYCCNT;
+	boot_time_us += (cycles - boot_time_cycles) / (F_CPU_ACTUAL / 1000000);
+	boot_time_cycles = cycles;
+	*phase = boot_time_us;
+}
+
 __attribute__((section(".startup"), naked))
 void ResetHandler(void)
 {
@@ -79,6 +97,9 @@ static void ResetHandler2(void)
 {
 	unsigned int i;
 	__asm__ volatile("dsb":::"memory");
+	ARM_DEMCR |= ARM_DEMCR_TRCENA;
+	ARM_DWT_CYCCNT = 0;
+	ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
 #if 1
 	// Some optimization with LTO won't start without this delay, but why?
 	asm volatile("nop");
@@ -118,6 +139,8 @@ static void ResetHandler2(void)
 	memory_copy(&_stext, &_stextload, &_etext);
 	memory_copy(&_sdata, &_sdataload, &_edata);
 	memory_clear(&_sbss, &_ebss);
+	if (&_ebss_ocram > &_sbss_ocram) memory_clear(&_sbss_ocram, &_ebss_ocram);
+	boot_phase(&teensy_boot_time.memory_init);
 
 	// enable FPU
 	SCB_CPACR = 0x00F00000;
@@ -156,6 +179,7 @@ static void ResetHandler2(void)
 	configure_systick();
 	usb_pll_start();	
 	reset_PFD(); //TODO: is this really needed?
+	boot_phase(&teensy_boot_time.clock_setup); // cycles so far were at the old speed
 #ifdef F_CPU
 	set_arm_clock(F_CPU);
 #endif
@@ -176,14 +200,17 @@ static void ResetHandler2(void)
 		SNVS_LPCR |= SNVS_LPCR_SRTC_ENV;
 	}
 	SNVS_HPCR |= SNVS_HPCR_RTC_EN | SNVS_HPCR_HP_TS;
+	boot_phase(&teensy_boot_time.clock_setup);
 
 #ifdef ARDUINO_TEENSY41
 	configure_external_ram();
 #endif
+	boot_phase(&teensy_boot_time.external_ram);
 	analog_init();
 	pwm_init();
 	tempmon_init();
 	startup_middle_hook();
+	boot_phase(&teensy_boot_time.peripherals);
 
 #if !defined(TEENSY_INIT_USB_DELAY_BEFORE)
         #define TEENSY_INIT_USB_DELAY_BEFORE 20
@@ -195,13 +222,22 @@ static void ResetHandler2(void)
 	// https://forum.pjrc.com/threads/36606?p=113980&viewfull=1#post113980
 	// https://forum.pjrc.com/threads/31290?p=87273&viewfull=1#post87273
 
+#if defined(TEENSY_INIT_USB_FAST_BOOT)
+	// Don't wait.  USB enumeration happens in the background while C++
+	// constructors and setup() run.  Anything printed to Serial before the
+	// PC configures USB is buffered (see usb_serial.c).
+	usb_init();
+#else
 	while (millis() < TEENSY_INIT_USB_DELAY_BEFORE) ; // wait
 	usb_init();
 	while (millis() < TEENSY_INIT_USB_DELAY_AFTER + TEENSY_INIT_USB_DELAY_BEFORE) ; // wait
+#endif
+	boot_phase(&teensy_boot_time.usb_init);
 	//printf("before C++ constructors\n");
 	startup_debug_reset();
 	startup_late_hook();
 	__libc_init_array();
+	boot_phase(&teensy_boot_time.constructors);
 	//printf("after C++ constructors\n");
 	//printf("before setup\n");
 	main();
@@ -376,6 +412,125 @@ FLASHMEM static uint32_t flexspi2_psram_id(uint32_t addr)
 	return id & 0xFFFF;
 }
 
+// FlexSPI2 clock choices, fastest first.  The APS6404 PSRAM chips are rated
+// for 133 MHz, but signal quality on each board limits the usable speed, so
+// faster settings are tested before use.  Above 88 MHz, AHB prefetch and
+// bufferable writes are enabled for better memcpy bandwidth.
+static const struct {
+	uint8_t mhz;
+	uint8_t clk_sel;
+	uint8_t podf;
+} flexspi2_clocks[] = {
+	{132, 3, 3}, // PLL2 528 MHz / 4
+	{120, 1, 5}, // PLL3 PFD0 720 MHz / 6
+	{105, 3, 4}, // PLL2 528 MHz / 5
+	{88,  3, 5}, // PLL2 528 MHz / 6
+};
+#define FLEXSPI2_NUM_CLOCKS (sizeof(flexspi2_clocks) / sizeof(flexspi2_clocks[0]))
+
+#if !defined(TEENSY_EXTMEM_CLOCK)
+#define TEENSY_EXTMEM_CLOCK 88
+#endif
+
+FLASHMEM static void flexspi2_set_clock(unsigned int index)
+{
+	while ((FLEXSPI2_STS0 & (FLEXSPI_STS0_ARBIDLE | FLEXSPI_STS0_SEQIDLE))
+	  != (FLEXSPI_STS0_ARBIDLE | FLEXSPI_STS0_SEQIDLE)) ; // wait
+	FLEXSPI2_MCR0 |= FLEXSPI_MCR0_MDIS;
+	CCM_CCGR7 &= ~CCM_CCGR7_FLEXSPI2(CCM_CCGR_ON);
+	CCM_CBCMR = (CCM_CBCMR & ~(CCM_CBCMR_FLEXSPI2_PODF_MASK | CCM_CBCMR_FLEXSPI2_CLK_SEL_MASK))
+		| CCM_CBCMR_FLEXSPI2_PODF(flexspi2_clocks[index].podf)
+		| CCM_CBCMR_FLEXSPI2_CLK_SEL(flexspi2_clocks[index].clk_sel);
+	CCM_CCGR7 |= CCM_CCGR7_FLEXSPI2(CCM_CCGR_ON);
+	if (flexspi2_clocks[index].mhz > 88) {
+		FLEXSPI2_AHBCR |= FLEXSPI_AHBCR_PREFETCHEN | FLEXSPI_AHBCR_BUFFERABLEEN;
+	} else {
+		FLEXSPI2_AHBCR &= ~(FLEXSPI_AHBCR_PREFETCHEN | FLEXSPI_AHBCR_BUFFERABLEEN);
+	}
+	FLEXSPI2_MCR0 &= ~FLEXSPI_MCR0_MDIS;
+	external_psram_clock = flexspi2_clocks[index].mhz;
+}
+
+// Write and read back 1K crossing a 1K PSRAM page boundary in the middle of
+// each chip.  The original contents are restored (at whatever speed is in use
+// when this returns), so this is safe to run after variables are in PSRAM.
+#define PSRAM_TEST_WORDS 256
+FLASHMEM static int flexspi2_psram_test(unsigned int index, unsigned int fallback)
+{
+	uint32_t saved[2][PSRAM_TEST_WORDS];
+	int pass = 1;
+	unsigned int chip, nchips = external_psram_size / 8;
+
+	for (chip=0; chip < nchips; chip++) {
+		volatile uint32_t *p = (uint32_t *)(0x70400000 - 512 + chip * 0x800000);
+		arm_dcache_flush_delete((void *)p, PSRAM_TEST_WORDS * 4);
+		for (int i=0; i < PSRAM_TEST_WORDS; i++) saved[chip][i] = p[i];
+	}
+	flexspi2_set_clock(index);
+	for (int n=0; n < 2 && pass; n++) {
+		uint32_t pattern = n ? 0xA5C3691E : 0x5A3C96E1;
+		for (chip=0; chip < nchips; chip++) {
+			volatile uint32_t *p = (uint32_t *)(0x70400000 - 512 + chip * 0x800000);
+			for (int i=0; i < PSRAM_TEST_WORDS; i++) p[i] = pattern ^ (i * 0x9E3779B9);
+			arm_dcache_flush_delete((void *)p, PSRAM_TEST_WORDS * 4);
+			for (int i=0; i < PSRAM_TEST_WORDS; i++) {
+				if (p[i] != (pattern ^ (i * 0x9E3779B9))) pass = 0;
+			}
+			arm_dcache_delete((void *)p, PSRAM_TEST_WORDS * 4);
+		}
+	}
+	if (!pass) flexspi2_set_clock(fallback);
+	for (chip=0; chip < nchips; chip++) {
+		volatile uint32_t *p = (uint32_t *)(0x70400000 - 512 + chip * 0x800000);
+		for (int i=0; i < PSRAM_TEST_WORDS; i++) p[i] = saved[chip][i];
+		arm_dcache_flush_delete((void *)p, PSRAM_TEST_WORDS * 4);
+	}
+	return pass;
+}
+
+// Write every dirty row in the data cache to memory, by set and way.  This
+// takes about 1000 operations, no matter how large the memory is.
+FLASHMEM static void dcache_clean_all(void)
+{
+	SCB_ID_CSSELR = 0; // level 1 data cache
+	asm volatile("dsb");
+	uint32_t ccsidr = SCB_ID_CCSIDR;
+	uint32_t sets = ((ccsidr >> 13) & 0x7FFF) + 1;
+	uint32_t ways = ((ccsidr >> 3) & 0x3FF) + 1;
+	for (uint32_t set=0; set < sets; set++) {
+		for (uint32_t way=0; way < ways; way++) {
+			SCB_CACHE_DCCSW = (way << 30) | (set << 5);
+		}
+	}
+	asm volatile("dsb");
+	asm volatile("isb");
+}
+
+// Change the PSRAM clock to the fastest setting not above the requested MHz
+// which passes a read/write test on this board.  Returns the MHz in use.
+// DMA to or from PSRAM must not be running during the change.
+FLASHMEM uint32_t extmem_set_clock(uint32_t mhz)
+{
+	unsigned int i, current=FLEXSPI2_NUM_CLOCKS-1;
+
+	if (!external_psram_size) return 0;
+	for (i=0; i < FLEXSPI2_NUM_CLOCKS; i++) {
+		if (flexspi2_clocks[i].mhz == external_psram_clock) current = i;
+	}
+	__disable_irq();
+	// write any cached data to PSRAM at the known good speed
+	dcache_clean_all();
+	for (i=0; i < FLEXSPI2_NUM_CLOCKS - 1; i++) {
+		if (flexspi2_clocks[i].mhz > mhz) continue;
+		if (i == current || flexspi2_psram_test(i, current)) break;
+	}
+	if (i == FLEXSPI2_NUM_CLOCKS - 1 && i != current) {
+		flexspi2_set_clock(i); // slowest is always used without testing
+	}
+	__enable_irq();
+	return external_psram_clock;
+}
+
 FLASHMEM void configure_external_ram()
 {
 	// initialize pins
@@ -404,7 +559,7 @@ FLASHMEM void configure_external_ram()
 	IOMUXC_FLEXSPI2_IPP_IND_IO_FA_BIT3_SELECT_INPUT = 1; // GPIO_EMC_29 for Mode: ALT8
 	IOMUXC_FLEXSPI2_IPP_IND_SCK_FA_SELECT_INPUT = 1; // GPIO_EMC_25 for Mode: ALT8
 
-	// turn on clock  (TODO: increase clock speed later, slow & cautious for first release)
+	// turn on clock at 88 MHz, faster speeds are tested after PSRAM is found
 	CCM_CBCMR = (CCM_CBCMR & ~(CCM_CBCMR_FLEXSPI2_PODF_MASK | CCM_CBCMR_FLEXSPI2_CLK_SEL_MASK))
 		| CCM_CBCMR_FLEXSPI2_PODF(5) | CCM_CBCMR_FLEXSPI2_CLK_SEL(3); // 88 MHz
 	CCM_CCGR7 |= CCM_CCGR7_FLEXSPI2(CCM_CCGR_ON);
@@ -500,6 +655,8 @@ FLASHMEM void configure_external_ram()
 			// One PSRAM chip is present, 8 MByte
 			external_psram_size = 8;
 		}
+		external_psram_clock = 88;
+		if (TEENSY_EXTMEM_CLOCK > 88) extmem_set_clock(TEENSY_EXTMEM_CLOCK);
 		// TODO: zero uninitialized EXTMEM variables
 		// TODO: copy from flash to initialize EXTMEM variables
 		sm_set_pool(&extmem_smalloc_pool, &_extram_end,
@@ -512,6 +669,13 @@ FLASHMEM void configure_external_ram()
 	}
 }
 
+#else
+
+uint32_t extmem_set_clock(uint32_t mhz)
+{
+	return 0;
+}
+
 #endif // ARDUINO_TEENSY41
 
 
@@ -571,6 +735,187 @@ FLASHMEM void reset_PFD()
 
 extern void usb_isr(void);
 
+// Walk the stack using the ARM EHABI unwind tables (.ARM.exidx), which
+// the compiler creates with -funwind-tables.  Functions without tables
+// end the backtrace early.  Only the stack and code address ranges are
+// trusted, so corrupted stacks stop the walk instead of faulting again.
+struct unwind_state {
+	uint32_t vsp;
+	uint32_t lr;
+	uint32_t pc;
+	uint32_t reg[16];
+	uint16_t valid; // bitmask of known reg[] values
+};
+
+static int unwind_stack_ok(uint32_t addr)
+{
+	return addr >= 0x20000000 && addr < (uint32_t)&_estack && !(addr & 3);
+}
+
+static int unwind_code_ok(uint32_t addr)
+{
+	addr &= ~1;
+	return (addr >= 0x20 && addr < 0x00080000) || (addr >= 0x60000000 && addr < 0x70000000);
+}
+
+static uint32_t prel31(const uint32_t *p)
+{
+	return (uint32_t)p + ((int32_t)(*p << 1) >> 1);
+}
+
+FLASHMEM static const uint32_t * exidx_find(uint32_t pc)
+{
+	const uint32_t *first = (const uint32_t *)&__exidx_start;
+	const uint32_t *last = (const uint32_t *)&__exidx_end - 2;
+
+	if (first > last || pc < prel31(first)) return NULL;
+	while (first < last) {
+		const uint32_t *mid = first + (((last - first) / 2 + 1) & ~1);
+		if (pc < prel31(mid)) {
+			last = mid - 2;
+		} else {
+			first = mid;
+		}
+	}
+	return first;
+}
+
+FLASHMEM static int unwind_pop(struct unwind_state *u, uint32_t mask)
+{
+	for (int i=0; i < 16; i++) {
+		if (!(mask & (1 << i))) continue;
+		if (!unwind_stack_ok(u->vsp)) return 0;
+		u->reg[i] = *(uint32_t *)u->vsp;
+		u->valid |= 1 << i;
+		u->vsp += 4;
+	}
+	return 1;
+}
+
+// returns 1 if u->pc is now the caller's return address
+FLASHMEM static int unwind_frame(struct unwind_state *u, uint32_t addr)
+{
+	const uint32_t *entry, *ops;
+	uint32_t nbytes, i;
+
+	entry = exidx_find(addr);
+	if (!entry || entry[1] == 1) return 0; // no table or EXIDX_CANTUNWIND
+	if (entry[1] & 0x80000000) {
+		ops = entry + 1; // personality 0, 3 opcodes inline
+		if ((*ops >> 24) != 0x80) return 0;
+		nbytes = 3;
+	} else {
+		ops = (const uint32_t *)prel31(entry + 1);
+		if (!(*ops & 0x80000000)) {
+			ops++; // skip generic personality routine
+			nbytes = 3 + ((*ops >> 24) * 4);
+		} else if ((*ops >> 24) == 0x80) {
+			nbytes = 3;
+		} else if ((*ops >> 24) == 0x81 || (*ops >> 24) == 0x82) {
+			nbytes = 2 + (((*ops >> 16) & 0xFF) * 4);
+		} else {
+			return 0;
+		}
+	}
+	// opcode bytes are read most significant first, skipping the header
+	i = (nbytes % 4 == 3) ? 1 : 2;
+	nbytes += i;
+	u->valid = (1 << 13) | (1 << 14);
+	u->reg[13] = u->vsp;
+	u->reg[14] = u->lr;
+	u->reg[15] = 0;
+	while (i < nbytes) {
+		#define UNWIND_BYTE() ((ops[i / 4] >> (24 - (i % 4) * 8)) & 0xFF)
+		uint32_t op = UNWIND_BYTE();
+		i++;
+		if ((op & 0xC0) == 0x00) {
+			u->vsp += ((op & 0x3F) << 2) + 4;
+		} else if ((op & 0xC0) == 0x40) {
+			u->vsp -= ((op & 0x3F) << 2) + 4;
+		} else if ((op & 0xF0) == 0x80) {
+			uint32_t mask = ((op & 0x0F) << 12) | (UNWIND_BYTE() << 4);
+			i++;
+			if (mask == 0) return 0; // refuse to unwind
+			if (!unwind_pop(u, mask)) return 0;
+			if (mask & (1 << 13)) u->vsp = u->reg[13];
+		} else if ((op & 0xF0) == 0x90) {
+			if ((op & 0x0F) == 13 || (op & 0x0F) == 15) return 0;
+			if (!(u->valid & (1 << (op & 0x0F)))) return 0;
+			u->vsp = u->reg[op & 0x0F];
+		} else if ((op & 0xF0) == 0xA0) {
+			uint32_t mask = ((1 << ((op & 0x07) + 1)) - 1) << 4;
+			if (op & 0x08) mask |= 1 << 14;
+			if (!unwind_pop(u, mask)) return 0;
+		} else if (op == 0xB0) {
+			break; // finish
+		} else if (op == 0xB1) {
+			uint32_t mask = UNWIND_BYTE();
+			i++;
+			if (mask == 0 || (mask & 0xF0)) return 0;
+			if (!unwind_pop(u, mask)) return 0;
+		} else if (op == 0xB2) {
+			uint32_t n = 0, shift = 0, b;
+			do {
+				b = UNWIND_BYTE();
+				i++;
+				n |= (b & 0x7F) << shift;
+				shift += 7;
+			} while ((b & 0x80) && i < nbytes);
+			u->vsp += 0x204 + (n << 2);
+		} else if (op == 0xB3 || op == 0xC8 || op == 0xC9) {
+			u->vsp += ((UNWIND_BYTE() & 0x0F) + 1) * 8 + (op == 0xB3 ? 4 : 0);
+			i++;
+		} else if ((op & 0xF8) == 0xB8) {
+			u->vsp += ((op & 0x07) + 1) * 8 + 4;
+		} else if ((op & 0xF8) == 0xD0) {
+			u->vsp += ((op & 0x07) + 1) * 8;
+		} else {
+			return 0; // spare or iWMMX opcodes, not used on Cortex-M
+		}
+		#undef UNWIND_BYTE
+	}
+	u->lr = u->reg[14];
+	u->pc = (u->valid & (1 << 15)) ? u->reg[15] : u->lr;
+	return unwind_stack_ok(u->vsp) && unwind_code_ok(u->pc);
+}
+
+FLASHMEM static void unwind_backtrace(const uint32_t *stack, uint32_t exc_return)
+{
+	struct arm_fault_backtrace_struct *bt;
+	struct unwind_state u;
+	uint32_t n = 0, crc, i;
+	const uint32_t *p, *end;
+
+	bt = (struct arm_fault_backtrace_struct *)0x2027FF00;
+	u.vsp = (uint32_t)(stack + 8);
+	if (!(exc_return & 0x10)) u.vsp += 18 * 4; // floating point context
+	if (stack[7] & (1 << 9)) u.vsp += 4; // stack was realigned
+	u.lr = stack[5];
+	u.pc = stack[6];
+	bt->addr[n++] = u.pc;
+	if (!exidx_find(u.pc & ~1) && unwind_code_ok(u.lr)) {
+		bt->addr[n++] = u.lr; // probably the caller, if this is a leaf function
+	}
+	for (int first=1; n < 30; first=0) {
+		uint32_t prev = u.vsp;
+		// return addresses are after the call, so look up the call instruction
+		if (!unwind_frame(&u, (u.pc & ~1) - (first ? 0 : 2))) break;
+		if (u.vsp < prev) break;
+		bt->addr[n++] = u.pc;
+		if (u.vsp == prev && u.pc == bt->addr[n - 2]) break;
+	}
+	bt->count = n;
+	crc = 0xFFFFFFFF;
+	p = (uint32_t *)bt;
+	end = p + (sizeof(*bt) / 4 - 1);
+	while (p < end) {
+		crc ^= *p++;
+		for (i=0; i < 32; i++) crc = (crc >> 1) ^ (crc & 1)*0xEDB88320;
+	}
+	bt->crc = crc;
+	arm_dcache_flush_delete(bt, sizeof(*bt));
+}
+
 // Stack frame
 //  xPSR
 //  ReturnAddress
@@ -586,7 +931,7 @@ extern void usb_isr(void);
 __attribute__((naked))
 void unused_interrupt_vector(void)
 {
-	uint32_t i, ipsr, crc, count;
+	uint32_t i, ipsr, crc, count, exc_return;
 	const uint32_t *stack;
 	struct arm_fault_info_struct *info;
 	const uint32_t *p, *end;
@@ -597,6 +942,7 @@ void unused_interrupt_vector(void)
 	asm volatile("mrs %0, ipsr\n" : "=r" (ipsr) :: "memory");
 	info = (struct arm_fault_info_struct *)0x2027FF80;
 	info->ipsr = ipsr;
+	asm volatile("mov %0, lr\n" : "=r" (exc_return) :: "memory");
 	asm volatile("tst lr, #4\nite eq\nmrseq %0, msp\nmrsne %0, psp\n" : "=r" (stack) :: "memory");
 	info->cfsr = SCB_CFSR;
 	info->hfsr = SCB_HFSR;
@@ -617,6 +963,7 @@ void unused_interrupt_vector(void)
 	}
 	info->crc = crc;
 	arm_dcache_flush_delete(info, sizeof(*info));
+	unwind_backtrace(stack, exc_return);
 
 	// LED blink can show fault mode - by default we don't mess with pin 13
 	//IOMUXC_SW_MUX_CTL_PAD_GPIO_B0_03 = 5; // pin 13
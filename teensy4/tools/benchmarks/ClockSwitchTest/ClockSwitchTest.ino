@@ -0,0 +1,104 @@
+// Switch the CPU clock many times, directly with set_arm_clock() and
+// with the CPU governor, and check that micros() never goes backwards
+// and keeps pace with millis().  micros() is also read from a priority 0
+// IntervalTimer, which can interrupt a clock change.
+//
+// This example code is in the public domain.
+
+extern "C" uint32_t set_arm_clock(uint32_t frequency);
+
+const uint32_t speeds[] = {24000000, 150000000, 396000000, 600000000};
+#define NUM_SPEEDS (sizeof(speeds) / sizeof(speeds[0]))
+
+IntervalTimer timer;
+volatile uint32_t isr_prev;
+volatile uint32_t isr_count;
+volatile uint32_t isr_errors;
+
+uint32_t loop_prev;
+uint32_t loop_errors;
+
+void timer_isr()
+{
+	uint32_t now = micros();
+	if ((int32_t)(now - isr_prev) < 0) isr_errors++;
+	isr_prev = now;
+	isr_count++;
+}
+
+// read micros() in a tight loop for a while
+void check_micros(uint32_t usec)
+{
+	uint32_t begin = micros();
+	uint32_t now;
+	do {
+		now = micros();
+		if ((int32_t)(now - loop_prev) < 0) {
+			if (loop_errors < 5) {
+				Serial.printf("  micros() went back %lu us at %lu MHz\n",
+					loop_prev - now, F_CPU_ACTUAL / 1000000);
+			}
+			loop_errors++;
+		}
+		loop_prev = now;
+	} while (now - begin < usec);
+}
+
+void report(const char *name, uint32_t switches, uint32_t us, uint32_t ms)
+{
+	// millis() has 1 ms resolution, allow 2 ms either way
+	int32_t drift = (int32_t)(us / 1000 - ms);
+	Serial.printf("%s: %lu switches, micros %lu ms, millis %lu ms, errors: loop %lu, interrupt %lu, %s\n",
+		name, switches, us / 1000, ms, loop_errors, isr_errors,
+		(loop_errors || isr_errors || drift > 2 || drift < -2) ? "FAILED" : "ok");
+}
+
+void setup()
+{
+	while (!Serial) ;
+	Serial.println("Clock switch test");
+	loop_prev = isr_prev = micros();
+	timer.priority(0);
+	timer.begin(timer_isr, 3.1);
+
+	// direct changes, every pair of speeds in both directions
+	uint32_t us = micros(), ms = millis(), switches = 0;
+	for (uint32_t n=0; n < 2000; n++) {
+		set_arm_clock(speeds[n % NUM_SPEEDS]);
+		switches++;
+		check_micros(100 + n % 700);
+		set_arm_clock(speeds[(n * 7 + 3) % NUM_SPEEDS]);
+		switches++;
+		check_micros(50);
+	}
+	set_arm_clock(600000000);
+	report("set_arm_clock", switches, micros() - us, millis() - ms);
+
+	// the governor, with load changing every few windows
+	Serial.flush();
+	loop_errors = isr_errors = 0;
+	cpu_governor_config(80, 30, 5);
+	cpu_governor_begin(speeds, NUM_SPEEDS);
+	us = micros();
+	ms = millis();
+	uint32_t changes = 0, prev_speed = F_CPU_ACTUAL;
+	for (uint32_t n=0; n < 400; n++) {
+		if (n & 1) {
+			check_micros(12000); // busy
+		} else {
+			delay(12); // idle
+		}
+		check_micros(10);
+		if (F_CPU_ACTUAL != prev_speed) {
+			prev_speed = F_CPU_ACTUAL;
+			changes++;
+		}
+	}
+	cpu_governor_end();
+	report("governor", changes, micros() - us, millis() - ms);
+	Serial.printf("%lu interrupt reads\n", isr_count);
+}
+
+void loop()
+{
+}
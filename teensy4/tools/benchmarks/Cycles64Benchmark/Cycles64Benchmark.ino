@@ -0,0 +1,69 @@
+// Measure the cost of cycles64(), nanos64() and micros(), and check that
+// cycles64() never goes backwards, even when read from an interrupt with
+// higher priority than SysTick.
+//
+// ARM_DWT_CYCCNT rolls over every 7.2 seconds at 600 MHz, so let this run
+// for a minute or more to see several rollovers.
+//
+// This example code is in the public domain.
+
+IntervalTimer timer;
+
+volatile uint64_t isr_prev;
+volatile uint32_t isr_count;
+volatile uint32_t isr_errors;
+
+// priority 0 preempts SysTick while it is updating the cycles64() state
+void timer_isr()
+{
+	uint64_t now = cycles64();
+	if (now < isr_prev) isr_errors++;
+	isr_prev = now;
+	isr_count++;
+}
+
+template <typename F>
+float cost(F func)
+{
+	const uint32_t n = 100000;
+	uint32_t begin = ARM_DWT_CYCCNT;
+	for (uint32_t i = 0; i < n; i++) func();
+	return (float)(ARM_DWT_CYCCNT - begin) / n;
+}
+
+volatile uint64_t sink64;
+volatile uint32_t sink32;
+
+void setup()
+{
+	while (!Serial) ;
+	Serial.println("cycles64() benchmark");
+	Serial.printf("cycles64(): %.1f cycles\n", cost([] { sink64 = cycles64(); }));
+	Serial.printf("nanos64():  %.1f cycles\n", cost([] { sink64 = nanos64(); }));
+	Serial.printf("micros():   %.1f cycles\n", cost([] { sink32 = micros(); }));
+	Serial.println();
+
+	// an odd period, so the timer drifts across the SysTick interrupt
+	isr_prev = cycles64();
+	timer.priority(0);
+	timer.begin(timer_isr, 2.7);
+}
+
+void loop()
+{
+	static uint64_t prev = cycles64();
+	static uint32_t errors = 0;
+	static uint32_t high = 0;
+	static elapsedMillis report;
+
+	uint64_t now = cycles64();
+	if (now < prev) errors++;
+	prev = now;
+
+	if ((uint32_t)(now >> 32) != high || report >= 5000) {
+		high = now >> 32;
+		report = 0;
+		Serial.printf("high %lu, interrupt reads %lu, errors: loop %lu, interrupt %lu\n",
+			high, isr_count, errors, isr_errors);
+	}
+}
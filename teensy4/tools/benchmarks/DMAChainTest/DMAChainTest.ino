@@ -0,0 +1,91 @@
+// Stress test for DMAChain with memory to memory copies.  Many thousands
+// of segments of random length and alignment are added while the chain
+// is running, so most are linked onto a TCD the channel already loaded.
+// The result is compared against the same copies done by the CPU.
+//
+// This example code is in the public domain.
+
+#include <DMAChannel.h>
+
+#define SEGMENTS 20000
+
+static uint8_t dtcm_src[8192] __attribute__ ((aligned(32)));
+static uint8_t dtcm_dst[8192] __attribute__ ((aligned(32)));
+DMAMEM static uint8_t ocram_src[8192] __attribute__ ((aligned(32)));
+DMAMEM static uint8_t ocram_dst[8192] __attribute__ ((aligned(32)));
+static uint8_t expect[8192];
+
+DMAChannel dma;
+DMAChain<64> chain(dma, 4);
+
+static uint32_t seed;
+
+static uint32_t random32()
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+static void test(const char *name, uint8_t *dst, uint8_t *src, uint32_t size)
+{
+	for (uint32_t i=0; i < size; i++) {
+		src[i] = i * 7 + (i >> 8);
+		dst[i] = 0;
+	}
+	memset(expect, 0, size);
+	arm_dcache_flush_delete(dst, size);
+	seed = 12345;
+	uint32_t first = chain.completed();
+	uint32_t full = 0, bytes = 0;
+	uint32_t begin = ARM_DWT_CYCCNT;
+	for (uint32_t n=0; n < SEGMENTS; n++) {
+		// mostly short segments, so the channel is often mid TCD load
+		uint32_t len = (random32() & 3) ? (random32() & 63) + 1 : (random32() & 1023) + 1;
+		uint32_t s = random32() % (size - len + 1);
+		uint32_t d = random32() % (size - len + 1);
+		if (chain.full()) {
+			full++;
+			while (chain.full()) ;
+		}
+		if (!chain.add(dst + d, src + s, len)) {
+			Serial.printf("%s: add failed at segment %lu\n", name, n);
+			return;
+		}
+		memcpy(expect + d, src + s, len);
+		bytes += len;
+	}
+	while (!chain.done()) ;
+	uint32_t cycles = ARM_DWT_CYCCNT - begin;
+	arm_dcache_delete(dst, size);
+
+	uint32_t errors = 0;
+	for (uint32_t i=0; i < size; i++) {
+		if (dst[i] != expect[i]) {
+			if (errors < 5) Serial.printf("  offset %lu: %02X, expected %02X\n", i, dst[i], expect[i]);
+			errors++;
+		}
+	}
+	Serial.printf("%s: %lu segments, %lu completed, %lu bytes, chain full %lu times\n",
+		name, SEGMENTS, chain.completed() - first, bytes, full);
+	Serial.printf("  %.2f us per segment, %s\n",
+		(float)cycles / SEGMENTS / (F_CPU_ACTUAL / 1000000),
+		errors ? "FAILED" : "ok");
+	if (errors) Serial.printf("  %lu bytes differ\n", errors);
+}
+
+void setup()
+{
+	while (!Serial) ;
+	Serial.println("DMAChain memory to memory test");
+	dma.begin();
+	test("DTCM", dtcm_dst, dtcm_src, sizeof(dtcm_dst));
+	test("OCRAM", ocram_dst, ocram_src, sizeof(ocram_dst));
+	test("DTCM to OCRAM", ocram_dst, dtcm_src, sizeof(ocram_dst));
+	test("OCRAM to DTCM", dtcm_dst, ocram_src, sizeof(dtcm_dst));
+}
+
+void loop()
+{
+}
@@ -0,0 +1,110 @@
+// Measure how much CPU time dma_memcpy_async() and dma_memset_async() give
+// back compared to memcpy() and memset().
+//
+// For each size, the CPU copy is timed first.  Then the same copy is
+// started with DMA while the CPU runs a counting loop until it is done.
+// The counting rate without DMA is measured once, so the count during the
+// DMA copy shows how much of the copy time was available to the program.
+//
+// This example code is in the public domain.
+
+#include <DMAChannel.h>
+
+DMAMEM static uint8_t ocram_src[65536] __attribute__ ((aligned(32)));
+DMAMEM static uint8_t ocram_dst[65536] __attribute__ ((aligned(32)));
+static uint8_t dtcm_buf[32768] __attribute__ ((aligned(32)));
+
+static dma_memop_t op;
+static volatile uint32_t work;
+
+// the work done while waiting, something the compiler can't remove
+static uint32_t count_until_done()
+{
+	uint32_t n = 0;
+	while (!dma_memop_done(&op)) {
+		work = work * 1664525 + 1013904223;
+		n++;
+	}
+	return n;
+}
+
+// counting loop iterations per CPU cycle with nothing else running
+static float count_rate()
+{
+	uint32_t begin = ARM_DWT_CYCCNT;
+	uint32_t n = 0;
+	while (ARM_DWT_CYCCNT - begin < 6000000) {
+		work = work * 1664525 + 1013904223;
+		n++;
+	}
+	return (float)n / (float)(ARM_DWT_CYCCNT - begin);
+}
+
+// CPU free is the part of the DMA copy time the counting loop could use
+static void report(const char *name, uint32_t len, uint32_t cpu_cycles,
+	uint32_t dma_cycles, uint32_t count, float rate)
+{
+	float mhz = F_CPU_ACTUAL / 1e6f;
+	Serial.printf("%-20s %6lu  %8.1f MB/s  %8.1f MB/s  %5.1f%%\n", name, len,
+		(float)len * mhz / (float)cpu_cycles,
+		(float)len * mhz / (float)dma_cycles,
+		100.0f * (float)count / rate / (float)dma_cycles);
+}
+
+static void test_copy(const char *name, void *dst, const void *src, uint32_t len, float rate)
+{
+	uint32_t begin = ARM_DWT_CYCCNT;
+	memcpy(dst, src, len);
+	uint32_t cpu_cycles = ARM_DWT_CYCCNT - begin;
+
+	begin = ARM_DWT_CYCCNT;
+	dma_memcpy_async(&op, dst, src, len, nullptr);
+	uint32_t count = count_until_done();
+	uint32_t dma_cycles = ARM_DWT_CYCCNT - begin;
+	if (op.status != DMA_MEMOP_DONE || memcmp(dst, src, len) != 0) {
+		Serial.printf("%s %lu: copy failed\n", name, len);
+		return;
+	}
+	report(name, len, cpu_cycles, dma_cycles, count, rate);
+}
+
+static void test_fill(const char *name, void *dst, uint32_t len, float rate)
+{
+	uint32_t begin = ARM_DWT_CYCCNT;
+	memset(dst, 0x11, len);
+	uint32_t cpu_cycles = ARM_DWT_CYCCNT - begin;
+
+	begin = ARM_DWT_CYCCNT;
+	dma_memset_async(&op, dst, 0x5A, len, nullptr);
+	uint32_t count = count_until_done();
+	uint32_t dma_cycles = ARM_DWT_CYCCNT - begin;
+	for (uint32_t i=0; i < len; i++) {
+		if (((uint8_t *)dst)[i] != 0x5A) {
+			Serial.printf("%s %lu: fill failed\n", name, len);
+			return;
+		}
+	}
+	report(name, len, cpu_cycles, dma_cycles, count, rate);
+}
+
+void setup()
+{
+	while (!Serial) ;
+	for (uint32_t i=0; i < sizeof(ocram_src); i++) ocram_src[i] = i * 7;
+	float rate = count_rate();
+	Serial.printf("CPU %lu MHz, %.3f loops per cycle\n", F_CPU_ACTUAL / 1000000, rate);
+	Serial.println("test                  bytes           CPU           DMA  CPU free");
+	static const uint32_t sizes[] = {256, 1024, 4096, 16384, 32768};
+	for (uint32_t len : sizes) {
+		test_copy("memcpy OCRAM->OCRAM", ocram_dst, ocram_src, len, rate);
+		test_copy("memcpy OCRAM->DTCM", dtcm_buf, ocram_src, len, rate);
+		test_copy("memcpy DTCM->OCRAM", ocram_dst, dtcm_buf, len, rate);
+		test_copy("memcpy unaligned", ocram_dst + 3, ocram_src + 5, len - 9, rate);
+		test_fill("memset OCRAM", ocram_dst, len, rate);
+		test_fill("memset DTCM", dtcm_buf, len, rate);
+	}
+}
+
+void loop()
+{
+}
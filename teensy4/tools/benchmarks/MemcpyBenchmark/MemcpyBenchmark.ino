@@ -0,0 +1,107 @@
+// Measure memcpy(), memset() and DMAChannel::copyMemory() throughput for
+// a range of sizes and alignments, in DTCM and OCRAM.  A simple word loop
+// is included for comparison.  memcpy() and memset() are also checked
+// against byte by byte results at every alignment.
+//
+// This example code is in the public domain.
+
+#include <DMAChannel.h>
+
+static uint8_t dtcm_a[32768 + 64] __attribute__ ((aligned(32)));
+static uint8_t dtcm_b[32768 + 64] __attribute__ ((aligned(32)));
+DMAMEM static uint8_t ocram_a[32768 + 64] __attribute__ ((aligned(32)));
+DMAMEM static uint8_t ocram_b[32768 + 64] __attribute__ ((aligned(32)));
+
+const uint32_t sizes[] = {16, 64, 256, 1024, 4096, 32768};
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+DMAChannel dma;
+
+// keep the compiler from turning this back into a memcpy() call
+__attribute__((noinline, optimize("no-tree-loop-distribute-patterns")))
+void word_copy(uint32_t *dst, const uint32_t *src, uint32_t len)
+{
+	for (uint32_t i=0; i < len / 4; i++) dst[i] = src[i];
+}
+
+// MB/s for one function, repeated to about 1 ms
+template <typename F>
+float rate(uint32_t len, F func)
+{
+	uint32_t n = 600000 / (len + 64) + 1;
+	func(); // warm the cache and branch predictor
+	uint32_t begin = ARM_DWT_CYCCNT;
+	for (uint32_t i=0; i < n; i++) func();
+	uint32_t cycles = ARM_DWT_CYCCNT - begin;
+	return (float)len * n / ((float)cycles / F_CPU_ACTUAL) / 1e6f;
+}
+
+void table(const char *name, uint8_t *dst, uint8_t *src)
+{
+	Serial.printf("\n%s\n", name);
+	Serial.println("  bytes   align   memcpy  word loop   memset  copyMemory  (MB/s)");
+	for (uint32_t i=0; i < NUM_SIZES; i++) {
+		uint32_t len = sizes[i];
+		for (uint32_t a=0; a < 3; a++) {
+			// aligned, dst misaligned, both misaligned differently
+			uint32_t doff = (a == 0) ? 0 : 3;
+			uint32_t soff = (a == 2) ? 1 : 0;
+			uint8_t *d = dst + doff, *s = src + soff;
+			float m = rate(len, [=] { memcpy(d, s, len); });
+			float w = (a == 0) ? rate(len, [=] { word_copy((uint32_t *)d, (uint32_t *)s, len); }) : 0;
+			float f = rate(len, [=] { memset(d, 0x5A, len); });
+			float c = rate(len, [=] {
+				dma.copyMemory(d, s, len);
+				while (!dma.complete()) ;
+				dma.clearComplete();
+			});
+			Serial.printf("  %5lu  %s  %7.1f  ", len, (a == 0) ? "aligned" : (a == 1) ? "dst + 3" : "d3, s1 ", m);
+			if (a == 0) Serial.printf("%9.1f", w); else Serial.print("        -");
+			Serial.printf("  %7.1f  %10.1f\n", f, c);
+		}
+	}
+}
+
+bool check()
+{
+	static uint8_t a[160], b[160], ref[160];
+	for (uint32_t len=0; len < 96; len++) {
+		for (uint32_t doff=0; doff < 8; doff++) {
+			for (uint32_t soff=0; soff < 8; soff++) {
+				for (uint32_t i=0; i < sizeof(a); i++) {
+					a[i] = i + 1;
+					b[i] = ref[i] = 0xEE;
+				}
+				memcpy(b + doff, a + soff, len);
+				for (uint32_t i=0; i < len; i++) ref[doff + i] = a[soff + i];
+				if (memcmp(b, ref, sizeof(b)) != 0) {
+					Serial.printf("memcpy error: len %lu, dst+%lu, src+%lu\n", len, doff, soff);
+					return false;
+				}
+				memset(b + doff, soff, len);
+				for (uint32_t i=0; i < len; i++) ref[doff + i] = soff;
+				if (memcmp(b, ref, sizeof(b)) != 0) {
+					Serial.printf("memset error: len %lu, dst+%lu\n", len, doff);
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void setup()
+{
+	while (!Serial) ;
+	Serial.printf("memcpy benchmark, CPU at %lu MHz\n", F_CPU_ACTUAL / 1000000);
+	Serial.printf("correctness check: %s\n", check() ? "ok" : "FAILED");
+	dma.begin();
+	table("DTCM to DTCM", dtcm_b, dtcm_a);
+	table("OCRAM to OCRAM", ocram_b, ocram_a);
+	table("OCRAM to DTCM", dtcm_b, ocram_a);
+	table("DTCM to OCRAM", ocram_b, dtcm_a);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,114 @@
+// Measure PSRAM throughput at each clock extmem_set_clock() supports.
+// Requires Teensy 4.1 with PSRAM.  The test buffer is much larger than
+// the 32K data cache, so the numbers show the PSRAM itself.
+//
+// This example code is in the public domain.
+
+extern "C" uint8_t external_psram_size;
+
+#define BUFSIZE (1024 * 1024)
+
+const uint32_t clocks[] = {88, 105, 120, 132};
+
+uint32_t *buf;
+static uint32_t local[8192] __attribute__ ((aligned(32)));
+volatile uint32_t sink;
+
+float mbytes_per_sec(uint32_t bytes, uint32_t cycles)
+{
+	return (float)bytes / ((float)cycles / F_CPU_ACTUAL) / 1e6f;
+}
+
+float test_read()
+{
+	arm_dcache_flush_delete(buf, BUFSIZE);
+	uint32_t sum = 0;
+	uint32_t begin = ARM_DWT_CYCCNT;
+	for (uint32_t i=0; i < BUFSIZE / 4; i += 4) {
+		sum += buf[i] + buf[i+1] + buf[i+2] + buf[i+3];
+	}
+	uint32_t cycles = ARM_DWT_CYCCNT - begin;
+	sink = sum;
+	return mbytes_per_sec(BUFSIZE, cycles);
+}
+
+float test_write()
+{
+	arm_dcache_flush_delete(buf, BUFSIZE);
+	uint32_t begin = ARM_DWT_CYCCNT;
+	for (uint32_t i=0; i < BUFSIZE / 4; i++) buf[i] = i;
+	arm_dcache_flush(buf, BUFSIZE); // include writing back the last rows
+	uint32_t cycles = ARM_DWT_CYCCNT - begin;
+	return mbytes_per_sec(BUFSIZE, cycles);
+}
+
+float test_copy()
+{
+	arm_dcache_flush_delete(buf, BUFSIZE);
+	uint32_t begin = ARM_DWT_CYCCNT;
+	for (uint32_t n=0; n < BUFSIZE; n += sizeof(local)) {
+		memcpy(local, (uint8_t *)buf + n, sizeof(local));
+	}
+	uint32_t cycles = ARM_DWT_CYCCNT - begin;
+	return mbytes_per_sec(BUFSIZE, cycles);
+}
+
+// average cycles for a dependent read of a random uncached word
+float test_latency()
+{
+	arm_dcache_flush_delete(buf, BUFSIZE);
+	uint32_t index = 0, n = 20000;
+	uint32_t begin = ARM_DWT_CYCCNT;
+	for (uint32_t i=0; i < n; i++) {
+		index = (index * 1103515245 + 12345 + buf[index]) & (BUFSIZE / 4 - 1);
+	}
+	uint32_t cycles = ARM_DWT_CYCCNT - begin;
+	sink = index;
+	return (float)cycles / n;
+}
+
+bool verify()
+{
+	for (uint32_t i=0; i < BUFSIZE / 4; i++) buf[i] = i * 2654435761u;
+	arm_dcache_flush_delete(buf, BUFSIZE);
+	for (uint32_t i=0; i < BUFSIZE / 4; i++) {
+		if (buf[i] != i * 2654435761u) return false;
+	}
+	return true;
+}
+
+void setup()
+{
+	while (!Serial) ;
+	Serial.println("PSRAM clock benchmark");
+	if (!external_psram_size) {
+		Serial.println("no PSRAM found");
+		return;
+	}
+	buf = (uint32_t *)extmem_malloc(BUFSIZE);
+	if (!buf) {
+		Serial.println("extmem_malloc failed");
+		return;
+	}
+	Serial.printf("%d MB PSRAM, CPU at %lu MHz\n\n", external_psram_size, F_CPU_ACTUAL / 1000000);
+	Serial.println("  MHz    read MB/s  write MB/s  copy MB/s  latency cycles  data");
+	for (uint32_t i=0; i < sizeof(clocks) / sizeof(clocks[0]); i++) {
+		uint32_t mhz = extmem_set_clock(clocks[i]);
+		if (mhz != clocks[i]) {
+			Serial.printf("  %3lu    not usable on this board, runs at %lu\n", clocks[i], mhz);
+			continue;
+		}
+		bool ok = verify();
+		float r = test_read();
+		float w = test_write();
+		float c = test_copy();
+		float l = test_latency();
+		Serial.printf("  %3lu  %10.1f  %10.1f  %9.1f  %14.1f  %s\n",
+			mhz, r, w, c, l, ok ? "ok" : "ERRORS");
+	}
+	extmem_free(buf);
+}
+
+void loop()
+{
+}
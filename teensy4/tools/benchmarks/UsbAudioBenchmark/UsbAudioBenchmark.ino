@@ -0,0 +1,111 @@
+// Measure the CPU time the USB audio packet handlers use for the stream
+// format chosen by USB_AUDIO_CHANNELS and USB_AUDIO_SUBFRAME_SIZE.
+//
+// Select Tools > USB Type > Audio (or another type with audio).  The USB
+// interrupt is disabled while the handlers are called directly with one
+// millisecond of audio each, so the host does not need to be streaming.
+// Run it once with and once without AudioMemory_F32() to see the cost of
+// full resolution float blocks with 24 or 32 bit samples.
+//
+// This example code is in the public domain.
+
+#include <AudioStream.h>
+
+#define PACKETS 1000
+
+// Sends a test tone on every channel, as 16 bit and float blocks
+class ToneSource : public AudioStream
+{
+public:
+	ToneSource() : AudioStream(0, NULL) { }
+	virtual void update(void) {
+		for (int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+			audio_block_t *b = allocate();
+			if (b) {
+				for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) b->data[i] = (i * 512) - ch;
+				transmit(b, ch);
+				release(b);
+			}
+			audio_block_f32_t *f = allocate_f32();
+			if (f) {
+				for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) f->data[i] = i * (1.0f / AUDIO_BLOCK_SAMPLES);
+				transmit(f, ch);
+				release(f);
+			}
+		}
+	}
+};
+
+AudioInputUSB usbIn;
+AudioOutputUSB usbOut;
+ToneSource source;
+AudioConnection *cords[USB_AUDIO_CHANNELS];
+#if defined(USB_AUDIO_F32)
+AudioConnection_F32 *cords_f32[USB_AUDIO_CHANNELS];
+#endif
+
+static void report(const char *name, uint32_t cycles)
+{
+	float us = (float)cycles / PACKETS / (F_CPU_ACTUAL / 1e6f);
+	// each packet is 1 ms of audio, so us per packet / 10 = percent CPU
+	Serial.printf("%-10s %8.2f us per ms of audio  (%.2f%% CPU)\n", name, us, us / 10.0f);
+}
+
+static void run(void)
+{
+#ifdef USB_AUDIO_48KHZ
+	const unsigned int frames = 48;
+#else
+	const unsigned int frames = 44;
+#endif
+	uint32_t rx_cycles = 0, tx_cycles = 0;
+
+	NVIC_DISABLE_IRQ(IRQ_USB1);
+	usb_audio_transmit_setting = 1;
+	for (int n=0; n < PACKETS; n++) {
+		uint32_t begin = ARM_DWT_CYCCNT;
+		usb_audio_receive_callback(frames * USB_AUDIO_FRAME_SIZE);
+		rx_cycles += ARM_DWT_CYCCNT - begin;
+
+		begin = ARM_DWT_CYCCNT;
+		usb_audio_transmit_callback();
+		tx_cycles += ARM_DWT_CYCCNT - begin;
+
+		// run the audio library about as often as real time would
+		if ((n % (AUDIO_BLOCK_SAMPLES / frames + 1)) == 0) {
+			source.update();
+			usbOut.update();
+			usbIn.update();
+		}
+	}
+	usb_audio_transmit_setting = 0;
+	NVIC_ENABLE_IRQ(IRQ_USB1);
+
+	report("receive", rx_cycles);
+	report("transmit", tx_cycles);
+}
+
+void setup()
+{
+	while (!Serial) ;
+	AudioMemory(12 * USB_AUDIO_CHANNELS);
+	for (int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+		cords[ch] = new AudioConnection(source, ch, usbOut, ch);
+	}
+	Serial.printf("USB audio: %d channels, %d bit, %lu MHz\n", USB_AUDIO_CHANNELS,
+		USB_AUDIO_SUBFRAME_SIZE * 8, F_CPU_ACTUAL / 1000000);
+	Serial.println("16 bit blocks:");
+	run();
+#if defined(USB_AUDIO_F32)
+	AudioMemory_F32(12 * USB_AUDIO_CHANNELS);
+	for (int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+		cords_f32[ch] = new AudioConnection_F32(source, ch, usbOut, ch);
+	}
+	Serial.println("16 bit and full resolution float blocks:");
+	run();
+#endif
+}
+
+void loop()
+{
+}
@@ -0,0 +1,255 @@
+#!/usr/bin/env python3
+# Teensy 4.x CrashReport line table generator
+# Copyright (c) 2021 PJRC.COM, LLC.
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# 1. The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# 2. If the Software is incorporated into a build system that allows
+# selection among a list of target devices, then similar target
+# devices manufactured by PJRC.COM must be included in the list of
+# target devices and selectable in the same manner.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+# BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+# ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""Add function names and line numbers to CrashReport.
+
+CrashReport prints addresses, which are only meaningful next to the ELF
+file of the exact build that crashed.  This script reads the debug info
+from the ELF file and writes a compact table of function names and line
+numbers into flash space reserved by the sketch, so CrashReport can print
+"function + offset, file:line" for the fault and each backtrace frame.
+
+The sketch reserves the space (64K is enough for most programs):
+
+  #include <CrashReport.h>
+  CRASHREPORT_LINE_TABLE(65536);
+
+Build with debug info (-g, the default for Teensy) and run this after
+linking, before the .hex file is created.  With the Teensy Makefile,
+set CRASHREPORT_LINES=1 to do this automatically.  If the table does not
+fit, line numbers are limited to files matching --files, and then left
+out completely, so at least function names are always available.
+
+Example:
+  crashreport_lines.py -e sketch.elf
+"""
+
+import argparse
+import os
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+
+SECTION = '.text.crashreport'
+MAGIC = 0x544C5243  # "CRLT"
+ROWS_PER_BLOCK = 64
+HEADER_WORDS = 9
+
+
+def tool(args, name):
+	if args.tools:
+		return os.path.join(args.tools, 'arm-none-eabi-' + name)
+	return 'arm-none-eabi-' + name
+
+
+def run(cmd):
+	return subprocess.run(cmd, check=True, stdout=subprocess.PIPE,
+		universal_newlines=True).stdout
+
+
+def code_address(addr):
+	return addr < 0x00080000 or 0x60000000 <= addr < 0x70000000
+
+
+def reserved_size(args):
+	for line in run([tool(args, 'objdump'), '-h', args.elf]).splitlines():
+		f = line.split()
+		if len(f) >= 3 and f[1] == SECTION:
+			return int(f[2], 16)
+	return 0
+
+
+def read_functions(args):
+	funcs = {}
+	out = run([tool(args, 'nm'), '-S', '-C', '--defined-only', args.elf])
+	for line in out.splitlines():
+		# demangled names may contain spaces
+		f = line.split(None, 3)
+		if len(f) != 4 or f[2] not in 'tTwW':
+			continue
+		addr, size, name = int(f[0], 16) & ~1, int(f[1], 16), f[3]
+		if size == 0 or name.startswith('$') or not code_address(addr):
+			continue
+		funcs.setdefault(addr, (size, name))
+	return sorted((a, s, n) for a, (s, n) in funcs.items())
+
+
+def read_lines(args):
+	rows = {}
+	out = run([tool(args, 'objdump'), '--dwarf=decodedline', args.elf])
+	pattern = re.compile(r'^(\S+)\s+(\d+|-)\s+(0x[0-9a-f]+)')
+	for line in out.splitlines():
+		m = pattern.match(line)
+		if not m:
+			continue
+		addr = int(m.group(3), 16) & ~1
+		if not code_address(addr):
+			continue
+		# "-" marks the end of a sequence, line 0 means no info
+		number = 0 if m.group(2) == '-' else int(m.group(2))
+		if number == 0 and addr in rows:
+			continue
+		rows[addr] = (m.group(1), number)
+	return sorted((a, f, n) for a, (f, n) in rows.items())
+
+
+def uleb128(n):
+	out = bytearray()
+	while True:
+		b = n & 0x7F
+		n >>= 7
+		if n:
+			out.append(b | 0x80)
+		else:
+			out.append(b)
+			return out
+
+
+def sleb128(n):
+	out = bytearray()
+	while True:
+		b = n & 0x7F
+		n >>= 7
+		if (n == 0 and not b & 0x40) or (n == -1 and b & 0x40):
+			out.append(b)
+			return out
+		out.append(b | 0x80)
+
+
+def align4(data):
+	while len(data) % 4:
+		data.append(0)
+
+
+def encode(funcs, rows):
+	strings = bytearray()
+	string_offsets = {}
+
+	def string(s):
+		if s not in string_offsets:
+			string_offsets[s] = len(strings)
+			strings.extend(s.encode('utf-8', 'replace') + b'\0')
+		return string_offsets[s]
+
+	func_table = bytearray()
+	for addr, size, name in funcs:
+		func_table += struct.pack('<III', addr, size, string(name))
+
+	files = []
+	file_numbers = {}
+	blocks = []
+	stream = bytearray()
+	for i in range(0, len(rows), ROWS_PER_BLOCK):
+		block = rows[i:i + ROWS_PER_BLOCK]
+		addr, file, line = block[0][0], 0, 0
+		blocks.append((addr, len(stream)))
+		for row_addr, row_file, row_line in block:
+			if row_file not in file_numbers:
+				file_numbers[row_file] = len(files)
+				files.append(string(row_file))
+			number = file_numbers[row_file]
+			changed = 1 if number != file else 0
+			stream += uleb128((row_addr - addr) << 1 | changed)
+			if changed:
+				stream += uleb128(number)
+			stream += sleb128(row_line - line)
+			addr, file, line = row_addr, number, row_line
+	if not files:
+		files.append(string(''))
+
+	off_funcs = HEADER_WORDS * 4
+	off_blocks = off_funcs + len(func_table)
+	off_files = off_blocks + len(blocks) * 8
+	off_strings = off_files + len(files) * 4
+	align4(strings)
+	off_stream = off_strings + len(strings)
+	stream_end = off_stream + len(stream)
+
+	table = bytearray()
+	table += struct.pack('<9I', MAGIC, 0, len(funcs), off_funcs,
+		len(blocks), off_blocks, off_files, off_strings, stream_end)
+	table += func_table
+	for addr, offset in blocks:
+		table += struct.pack('<II', addr, off_stream + offset)
+	for offset in files:
+		table += struct.pack('<I', offset)
+	table += strings
+	table += stream
+	align4(table)
+	struct.pack_into('<I', table, 4, len(table))
+	return table
+
+
+def main():
+	ap = argparse.ArgumentParser(description=__doc__,
+		formatter_class=argparse.RawDescriptionHelpFormatter)
+	ap.add_argument('-e', '--elf', required=True, help='compiled program, updated in place')
+	ap.add_argument('--tools', help='directory with arm-none-eabi-objdump, nm and objcopy')
+	ap.add_argument('--files', help='regular expression, only keep line numbers for matching files')
+	args = ap.parse_args()
+
+	size = reserved_size(args)
+	if size == 0:
+		print('crashreport_lines: no CRASHREPORT_LINE_TABLE in %s, nothing to do' % args.elf)
+		return
+	funcs = read_functions(args)
+	rows = read_lines(args)
+	if args.files:
+		match = re.compile(args.files)
+		rows = [r for r in rows if match.search(r[1])]
+
+	table = encode(funcs, rows)
+	if len(table) > size and rows and not args.files:
+		# try again with only the sketch and library sources
+		core = re.compile(r'(^|/)(cores|teensy4|hardware/tools)/')
+		rows = [r for r in rows if not core.search(r[1])]
+		table = encode(funcs, rows)
+	if len(table) > size:
+		rows = []
+		table = encode(funcs, rows)
+	if len(table) > size:
+		sys.exit('crashreport_lines: table needs %d bytes, only %d reserved by CRASHREPORT_LINE_TABLE'
+			% (len(table), size))
+	print('crashreport_lines: %d functions, %d line rows, %d of %d bytes' % (len(funcs), len(rows), len(table), size))
+	table += bytes(size - len(table))
+
+	with tempfile.NamedTemporaryFile(suffix='.bin', delete=False) as f:
+		f.write(table)
+		name = f.name
+	try:
+		run([tool(args, 'objcopy'), '--update-section', SECTION + '=' + name, args.elf])
+	finally:
+		os.unlink(name)
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,302 @@
+#!/usr/bin/env python3
+# Teensy 4.x FlexRAM layout planner
+# Copyright (c) 2021 PJRC.COM, LLC.
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# 1. The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# 2. If the Software is incorporated into a build system that allows
+# selection among a list of target devices, then similar target
+# devices manufactured by PJRC.COM must be included in the list of
+# target devices and selectable in the same manner.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+# BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+# ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Choose the FlexRAM ITCM/DTCM bank split from an execution profile.
+
+The 512K of FlexRAM is 16 banks of 32K.  The linker script gives ITCM as
+many banks as the code in .text.itcm needs and DTCM gets the rest, so every
+function not marked FLASHMEM costs DTCM.  This script reads a compiled ELF
+and a profile of where the program spends its time, keeps the hot code in
+ITCM and writes a new linker script which moves the cold code to flash.
+Optionally, the largest zero initialized variables can be moved from DTCM
+to OCRAM (RAM2) when DTCM is too small.
+
+The profile is a text file with one "samples function" pair per line, as
+written by the sampling profiler (tools/profile_capture.py) or by
+"sort | uniq -c" of any list of function names.  Functions never seen in
+the profile are treated as cold.
+
+Example:
+  flexram_layout.py -e sketch.elf -m sketch.map -p profile.txt -l imxrt1062.ld -o fast.ld
+
+Then build again using fast.ld as the linker script.  The program must be
+compiled with -ffunction-sections -fdata-sections (the default for Teensy)
+and linked with -Wl,-Map=sketch.map.  The map file tells which input
+section each function came from.  Only functions in their own .text.name
+section can be moved, so FASTRUN functions (.fastrun) and code in assembly
+files (.text) stay in ITCM.  Functions with an unwind table entry also
+stay, because .ARM.exidx remains in ITCM and its 31 bit offsets can not
+reach flash.  The .ARM.exidx size is counted as ITCM which can't be freed.
+"""
+
+import argparse
+import subprocess
+import sys
+
+BANK_SIZE = 32768
+NUM_BANKS = 16
+ICACHE_SIZE = 32768
+
+ITCM_START, ITCM_END = 0x00000000, 0x00080000
+DTCM_START, DTCM_END = 0x20000000, 0x20080000
+FLASH_START, FLASH_END = 0x60000000, 0x70000000
+
+
+class Symbol:
+	def __init__(self, name, addr, size, kind):
+		self.name = name
+		self.addr = addr
+		self.size = size
+		self.kind = kind
+		self.samples = 0
+
+
+def read_symbols(nm, elf):
+	out = subprocess.run([nm, '-S', '--defined-only', elf],
+		check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+	symbols = {}
+	absolute = {}
+	for line in out.splitlines():
+		f = line.split()
+		if len(f) == 3:
+			# linker symbols like _stext and _ebss have no size
+			absolute[f[2]] = int(f[0], 16)
+		if len(f) != 4:
+			continue
+		addr, size, kind, name = int(f[0], 16), int(f[1], 16), f[2], f[3]
+		if name.startswith('$'):
+			continue
+		symbols[name] = Symbol(name, addr, size, kind)
+		absolute.setdefault(name, addr)
+	return symbols, absolute
+
+
+def read_map(filename):
+	# Input sections from a GNU ld map file.  Long section names are on a
+	# line of their own, with the address, size and file on the next line.
+	# Returns the total size of each .text.name section placed in ITCM and
+	# the names which also have a .ARM.exidx.text.name unwind entry.
+	text = {}
+	exidx = set()
+	with open(filename) as f:
+		lines = iter(f.read().splitlines())
+	for line in lines:
+		if line.startswith('Linker script and memory map'):
+			break
+	name = None
+	for line in lines:
+		f = line.split()
+		if len(f) == 1 and line.startswith(' .'):
+			name = f[0]
+			continue
+		if len(f) >= 3 and line.startswith(' .'):
+			name, f = f[0], f[1:]
+		elif name is None or not line.startswith('  '):
+			name = None
+			continue
+		try:
+			addr, size = int(f[0], 16), int(f[1], 16)
+		except (ValueError, IndexError):
+			name = None
+			continue
+		if name.startswith('.text.') and in_range_addr(addr, ITCM_START, ITCM_END):
+			text[name[6:]] = text.get(name[6:], 0) + size
+		elif name.startswith('.ARM.exidx.text.') and size > 0:
+			exidx.add(name[16:])
+		name = None
+	return text, exidx
+
+
+def read_profile(filename, symbols):
+	total = 0
+	unknown = 0
+	with open(filename) as f:
+		for line in f:
+			fields = line.split()
+			if len(fields) < 2 or line.startswith('#'):
+				continue
+			try:
+				count, name = int(fields[0]), fields[1]
+			except ValueError:
+				continue
+			total += count
+			if name in symbols:
+				symbols[name].samples += count
+			else:
+				unknown += count
+	return total, unknown
+
+
+def in_range_addr(addr, start, end):
+	return start <= addr < end
+
+
+def in_range(sym, start, end):
+	return in_range_addr(sym.addr, start, end)
+
+
+def banks_for(nbytes):
+	return (nbytes + BANK_SIZE - 1) // BANK_SIZE
+
+
+def cache_estimate(functions, total):
+	# Code executed from flash goes through the 32K 2-way instruction
+	# cache.  When the hot flash code fits in the cache only the first
+	# execution misses.  When it doesn't, assume misses in proportion to
+	# the part which can't stay resident.  This is only a rough guide.
+	hot = [s for s in functions if s.samples > 0]
+	samples = sum(s.samples for s in hot)
+	footprint = sum(s.size for s in hot)
+	if footprint <= ICACHE_SIZE // 2:
+		missrate = 0.0
+	else:
+		missrate = 1.0 - min(1.0, (ICACHE_SIZE // 2) / footprint)
+	fraction = samples / total if total else 0.0
+	return fraction, footprint, fraction * missrate
+
+
+def main():
+	ap = argparse.ArgumentParser(description=__doc__,
+		formatter_class=argparse.RawDescriptionHelpFormatter)
+	ap.add_argument('-e', '--elf', required=True, help='compiled program')
+	ap.add_argument('-m', '--map', required=True, help='linker map file of the same build')
+	ap.add_argument('-p', '--profile', required=True, help='samples per function')
+	ap.add_argument('-l', '--ld', help='linker script to modify, imxrt1062.ld or imxrt1062_t41.ld')
+	ap.add_argument('-o', '--output', help='new linker script to write')
+	ap.add_argument('--nm', default='arm-none-eabi-nm')
+	ap.add_argument('--keep', type=float, default=0.999,
+		help='fraction of samples which must stay in ITCM (default 0.999)')
+	ap.add_argument('--stack', type=int, default=16384,
+		help='bytes of DTCM to leave for the stack (default 16384)')
+	ap.add_argument('--move-data', action='store_true',
+		help='move large zero initialized variables to OCRAM if DTCM is short')
+	args = ap.parse_args()
+
+	symbols, absolute = read_symbols(args.nm, args.elf)
+	sections, unwind = read_map(args.map)
+	total, unknown = read_profile(args.profile, symbols)
+	if total == 0:
+		sys.exit('profile has no samples')
+
+	text = [s for s in symbols.values() if s.kind in 'tTwW']
+	itcm = [s for s in text if in_range(s, ITCM_START, ITCM_END)]
+	flash = [s for s in text if in_range(s, FLASH_START, FLASH_END)]
+	# _etext includes .ARM.exidx, which stays in ITCM
+	if '_etext' in absolute and '_stext' in absolute:
+		itcm_bytes = absolute['_etext'] - absolute['_stext']
+	else:
+		itcm_bytes = sum(s.size for s in itcm)
+		if '__exidx_end' in absolute and '__exidx_start' in absolute:
+			itcm_bytes += absolute['__exidx_end'] - absolute['__exidx_start']
+	# only code in its own .text.name input section can be moved
+	movable = [s for s in itcm if s.name in sections and s.name not in unwind]
+	for s in movable:
+		s.size = sections[s.name]
+	pinned = len(itcm) - len(movable)
+	data_bytes = 0
+	if '_sdata' in absolute and '_ebss' in absolute:
+		data_bytes = absolute['_ebss'] - absolute['_sdata']
+
+	# keep the hottest code (by samples per byte) until enough samples
+	# are covered, everything else can run from flash
+	keep_samples = total * args.keep
+	covered = sum(s.samples for s in flash)
+	moved = []
+	for s in sorted(movable, key=lambda s: s.samples / max(s.size, 1), reverse=True):
+		if covered < keep_samples and s.samples > 0:
+			covered += s.samples
+		elif s.size > 0:
+			moved.append(s)
+	moved_bytes = sum(s.size for s in moved)
+
+	old_banks = banks_for(itcm_bytes)
+	new_banks = banks_for(max(itcm_bytes - moved_bytes, 32))
+	old_dtcm = (NUM_BANKS - old_banks) * BANK_SIZE
+	new_dtcm = (NUM_BANKS - new_banks) * BANK_SIZE
+
+	# variables moved to OCRAM, largest first, only if DTCM is short
+	moved_data = []
+	shortfall = data_bytes + args.stack - new_dtcm
+	if shortfall > 0 and args.move_data:
+		bss = [s for s in symbols.values() if s.kind in 'bB' and in_range(s, DTCM_START, DTCM_END)]
+		for s in sorted(bss, key=lambda s: s.size, reverse=True):
+			if shortfall <= 0:
+				break
+			moved_data.append(s)
+			shortfall -= s.size
+
+	old_flash, old_foot, old_miss = cache_estimate(flash, total)
+	new_flash, new_foot, new_miss = cache_estimate(flash + moved, total)
+
+	print('profile: %d samples, %d (%.1f%%) outside known functions' % (total, unknown, 100.0 * unknown / total))
+	print()
+	print('                          default      profiled')
+	print('ITCM code bytes     %12d  %12d' % (itcm_bytes, itcm_bytes - moved_bytes))
+	print('ITCM banks          %12d  %12d' % (old_banks, new_banks))
+	print('DTCM bytes          %12d  %12d' % (old_dtcm, new_dtcm))
+	print('DTCM free for stack %12d  %12d' % (old_dtcm - data_bytes,
+		new_dtcm - data_bytes + sum(s.size for s in moved_data)))
+	print('time in flash code  %11.2f%%  %11.2f%%' % (100.0 * old_flash, 100.0 * new_flash))
+	print('hot flash footprint %12d  %12d' % (old_foot, new_foot))
+	print('est. cache misses   %11.2f%%  %11.2f%%' % (100.0 * old_miss, 100.0 * new_miss))
+	print('  (percent of samples likely to stall on a flash cache miss)')
+	print()
+	print('%d functions (%d bytes) move to flash, %d must stay in ITCM' % (len(moved), moved_bytes, pinned))
+	for s in sorted(moved, key=lambda s: s.samples, reverse=True)[:10]:
+		if s.samples == 0:
+			break
+		print('  %-40s %8d bytes %8d samples' % (s.name, s.size, s.samples))
+	if moved_data:
+		print('%d variables (%d bytes) move to OCRAM' % (len(moved_data), sum(s.size for s in moved_data)))
+		print('  check these are not used for DMA without cache maintenance:')
+		for s in moved_data:
+			print('  %-40s %8d bytes' % (s.name, s.size))
+	elif shortfall > 0:
+		print('warning: DTCM is %d bytes short of the requested stack, try --move-data' % shortfall)
+
+	if args.output:
+		if not args.ld:
+			sys.exit('--ld is required with --output')
+		with open(args.ld) as f:
+			script = f.read()
+		code = ''.join('\t\t*(.text.%s)\n' % s.name for s in moved)
+		data = ''.join('\t\t*(.bss.%s)\n' % s.name for s in moved_data)
+		anchor = '\t\t*(.flashmem*)\n'
+		if anchor not in script or '.bss.ocram (NOLOAD) : {\n' not in script:
+			sys.exit('%s does not look like a Teensy 4 linker script' % args.ld)
+		script = script.replace(anchor, anchor + code, 1)
+		script = script.replace('.bss.ocram (NOLOAD) : {\n', '.bss.ocram (NOLOAD) : {\n' + data, 1)
+		with open(args.output, 'w') as f:
+			f.write(script)
+		print()
+		print('wrote %s' % args.output)
+
+
+if __name__ == '__main__':
+	main()
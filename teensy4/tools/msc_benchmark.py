@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+# Teensy 4.x USB disk throughput benchmark
+# Copyright (c) 2021 PJRC.COM, LLC.
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# 1. The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# 2. If the Software is incorporated into a build system that allows
+# selection among a list of target devices, then similar target
+# devices manufactured by PJRC.COM must be included in the list of
+# target devices and selectable in the same manner.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+# BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+# ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""Measure USB Mass Storage throughput of a Teensy RAM disk.
+
+Build a sketch with Tools > USB Type set to a Disk type (USB_MSC or
+USB_MSC_SERIAL) which uses a RAM disk, so only USB and the driver are
+measured, for example:
+
+  EXTMEM uint8_t disk[8 * 1024 * 1024]; // Teensy 4.1 with PSRAM
+  void setup() { MSC.ramDisk(disk, sizeof(disk)); }
+  void loop() { }
+
+Then run this script with the disk's raw device.  Reads use O_DIRECT
+where available, so the operating system's cache is not measured.  The
+write test overwrites the disk and only runs with --write.
+
+Example:
+  msc_benchmark.py /dev/sdX --write
+"""
+
+import argparse
+import mmap
+import os
+import sys
+import time
+
+SIZES = [4096, 16384, 65536, 131072]
+
+
+def open_device(path, flags):
+	try:
+		return os.open(path, flags | getattr(os, 'O_DIRECT', 0)), True
+	except OSError:
+		return os.open(path, flags), False
+
+
+def device_size(fd):
+	size = os.lseek(fd, 0, os.SEEK_END)
+	os.lseek(fd, 0, os.SEEK_SET)
+	return size
+
+
+def run(fd, direct, chunk, total, write):
+	# O_DIRECT needs page aligned buffers, which mmap provides
+	buf = mmap.mmap(-1, chunk)
+	if write:
+		buf.write(os.urandom(chunk))
+	os.lseek(fd, 0, os.SEEK_SET)
+	if not direct and hasattr(os, 'posix_fadvise'):
+		os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+	done = 0
+	begin = time.perf_counter()
+	while done < total:
+		if write:
+			n = os.write(fd, buf)
+		else:
+			n = os.readv(fd, [buf])
+		if n <= 0:
+			break
+		done += n
+	if write:
+		os.fsync(fd)
+	elapsed = time.perf_counter() - begin
+	buf.close()
+	return done, elapsed
+
+
+def main():
+	ap = argparse.ArgumentParser(description=__doc__,
+		formatter_class=argparse.RawDescriptionHelpFormatter)
+	ap.add_argument('device', help='raw disk device, eg /dev/sdb or /dev/rdisk4')
+	ap.add_argument('-m', '--megabytes', type=float, default=0,
+		help='amount to transfer per test (default whole disk, up to 64)')
+	ap.add_argument('-c', '--chunk', type=int, action='append',
+		help='transfer size in bytes, may be repeated (default %s)' % SIZES)
+	ap.add_argument('--write', action='store_true',
+		help='also test writing, destroys all data on the disk')
+	args = ap.parse_args()
+
+	flags = os.O_RDWR if args.write else os.O_RDONLY
+	fd, direct = open_device(args.device, flags)
+	size = device_size(fd)
+	if size == 0:
+		sys.exit('%s has no size, is it a disk?' % args.device)
+	total = int(args.megabytes * 1048576) if args.megabytes else min(size, 64 * 1048576)
+	total = min(total, size)
+	print('%s: %d bytes, testing %d bytes%s' % (args.device, size, total,
+		'' if direct else ' (no O_DIRECT, results may include caching)'))
+	print()
+	print('  chunk     read MB/s   write MB/s')
+	for chunk in args.chunk or SIZES:
+		if chunk % 512 or total < chunk:
+			continue
+		n = total - total % chunk
+		done, t = run(fd, direct, chunk, n, False)
+		rd = done / t / 1e6 if t > 0 else 0.0
+		wr = ''
+		if args.write:
+			done, t = run(fd, direct, chunk, n, True)
+			wr = '%10.2f' % (done / t / 1e6 if t > 0 else 0.0)
+		print('%7d   %10.2f   %s' % (chunk, rd, wr))
+	os.close(fd)
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+# Teensy 4.x sampling profiler capture
+# Copyright (c) 2021 PJRC.COM, LLC.
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# 1. The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# 2. If the Software is incorporated into a build system that allows
+# selection among a list of target devices, then similar target
+# devices manufactured by PJRC.COM must be included in the list of
+# target devices and selectable in the same manner.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+# BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+# ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""Capture and symbolize a profile from the Teensy 4 sampling profiler.
+
+The program being profiled starts the profiler and prints the result:
+
+  Profiler.begin(2000);    // samples per second
+  ...
+  Serial.print(Profiler);
+
+This script reads that output from the serial port (needs pyserial) or
+from a saved file, looks up each sampled address in the ELF file and
+writes a report.  The default "flat" report is one "samples function"
+line per function, which tools/flexram_layout.py reads.  The "collapsed"
+report is "caller;function samples", the input format for flame graph
+tools.  The caller comes from LR at the time of the sample, which is not
+always the real caller once a function has called something else.
+
+Examples:
+  profile_capture.py -e sketch.elf -p /dev/ttyACM0 -o profile.txt
+  profile_capture.py -e sketch.elf -i saved.txt --format collapsed
+"""
+
+import argparse
+import bisect
+import subprocess
+import sys
+
+
+def read_functions(nm, elf, demangle):
+	cmd = [nm, '-S', '--defined-only', elf]
+	if demangle:
+		cmd.insert(1, '-C')
+	out = subprocess.run(cmd, check=True, stdout=subprocess.PIPE,
+		universal_newlines=True).stdout
+	funcs = {}
+	for line in out.splitlines():
+		f = line.split(None, 3)
+		if len(f) != 4 or f[2] not in 'tTwW' or f[3].startswith('$'):
+			continue
+		addr, size = int(f[0], 16) & ~1, int(f[1], 16)
+		if size > 0:
+			funcs.setdefault(addr, (size, f[3]))
+	starts = sorted(funcs)
+	return starts, [funcs[a] for a in starts]
+
+
+class Symbolizer:
+	def __init__(self, starts, funcs):
+		self.starts = starts
+		self.funcs = funcs
+
+	def name(self, addr):
+		if addr >= 0xFFFFFF00:
+			return '[exception]'
+		addr &= ~1
+		i = bisect.bisect_right(self.starts, addr) - 1
+		if i >= 0:
+			size, name = self.funcs[i]
+			if addr < self.starts[i] + size:
+				return name
+		return '0x%08X' % addr
+
+
+def read_capture(lines):
+	header = None
+	samples = []
+	for line in lines:
+		line = line.strip()
+		if line.startswith('# profile'):
+			header = dict(f.split('=', 1) for f in line.split()[2:] if '=' in f)
+			samples = []
+		elif header is None:
+			continue
+		elif line == '# end':
+			return header, samples
+		else:
+			f = line.split()
+			try:
+				samples.append((int(f[0], 16), int(f[1], 16), int(f[2])))
+			except (IndexError, ValueError):
+				pass
+	if header is None:
+		sys.exit('no "# profile" found in input')
+	print('warning: profile is incomplete, no "# end" line', file=sys.stderr)
+	return header, samples
+
+
+def serial_lines(port, baud):
+	try:
+		import serial
+	except ImportError:
+		sys.exit('reading a serial port needs pyserial (pip install pyserial)')
+	with serial.Serial(port, baud, timeout=30) as s:
+		while True:
+			line = s.readline()
+			if not line:
+				sys.exit('timeout waiting for profile on %s' % port)
+			yield line.decode('ascii', 'replace')
+
+
+def main():
+	ap = argparse.ArgumentParser(description=__doc__,
+		formatter_class=argparse.RawDescriptionHelpFormatter)
+	ap.add_argument('-e', '--elf', required=True, help='compiled program')
+	ap.add_argument('-p', '--port', help='serial port to read the profile from')
+	ap.add_argument('-b', '--baud', type=int, default=115200)
+	ap.add_argument('-i', '--input', help='file with the printed profile (default stdin)')
+	ap.add_argument('-o', '--output', help='report file (default stdout)')
+	ap.add_argument('-f', '--format', choices=['flat', 'collapsed'], default='flat')
+	ap.add_argument('-C', '--demangle', action='store_true',
+		help='demangle C++ names (flexram_layout.py needs them mangled)')
+	ap.add_argument('--nm', default='arm-none-eabi-nm')
+	args = ap.parse_args()
+
+	if args.port:
+		header, samples = read_capture(serial_lines(args.port, args.baud))
+	elif args.input:
+		with open(args.input) as f:
+			header, samples = read_capture(f)
+	else:
+		header, samples = read_capture(sys.stdin)
+
+	sym = Symbolizer(*read_functions(args.nm, args.elf, args.demangle))
+	counts = {}
+	for pc, lr, count in samples:
+		if args.format == 'flat':
+			key = sym.name(pc)
+		else:
+			key = sym.name(lr) + ';' + sym.name(pc)
+		counts[key] = counts.get(key, 0) + count
+	report = sorted(counts.items(), key=lambda kv: kv[1], reverse=True)
+
+	total = sum(counts.values())
+	out = open(args.output, 'w') if args.output else sys.stdout
+	if args.format == 'flat':
+		print('# %d samples at %s per second, %s dropped, %s cycles in profiler' % (total,
+			header.get('rate', '?'), header.get('dropped', '?'), header.get('cycles', '?')), file=out)
+		for name, count in report:
+			print('%d %s' % (count, name), file=out)
+	else:
+		for name, count in report:
+			print('%s %d' % (name, count), file=out)
+	if args.output:
+		out.close()
+		for name, count in report[:10]:
+			print('%6.2f%%  %s' % (100.0 * count / total, name))
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+# Teensy 4.x CrashReport line table test
+# Copyright (c) 2021 PJRC.COM, LLC.
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# 1. The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# 2. If the Software is incorporated into a build system that allows
+# selection among a list of target devices, then similar target
+# devices manufactured by PJRC.COM must be included in the list of
+# target devices and selectable in the same manner.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+# BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+# ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""Round trip test for tools/crashreport_lines.py.
+
+Encodes synthetic function and line tables, then decodes every address
+with a Python copy of print_location() from CrashReport.cpp and checks the
+result against a simple search of the input.  Keep decode() in step with
+the C++ code when either changes.
+
+Run from the teensy4 directory or anywhere else:
+  python3 tools/test_crashreport_lines.py
+"""
+
+import os
+import random
+import struct
+import sys
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import crashreport_lines as crl
+
+
+# same as uleb128(), sleb128() and table_search() in CrashReport.cpp
+def uleb128(table, pos, end):
+	n = shift = 0
+	while pos < end:
+		b = table[pos]
+		pos += 1
+		n |= (b & 0x7F) << shift
+		shift += 7
+		if not b & 0x80:
+			break
+	return n & 0xFFFFFFFF, pos
+
+
+def sleb128(table, pos, end):
+	n = shift = b = 0
+	while pos < end:
+		b = table[pos]
+		pos += 1
+		n |= (b & 0x7F) << shift
+		shift += 7
+		if not b & 0x80:
+			break
+	if b & 0x40 and shift < 32:
+		n |= (0xFFFFFFFF << shift)
+	n &= 0xFFFFFFFF
+	return (n - (1 << 32) if n & 0x80000000 else n), pos
+
+
+def word(table, offset):
+	return struct.unpack_from('<I', table, offset)[0]
+
+
+def table_search(table, offset, count, stride, addr):
+	if count == 0 or addr < word(table, offset):
+		return None
+	low, high = 0, count
+	while high - low > 1:
+		mid = (low + high) // 2
+		if word(table, offset + mid * stride * 4) <= addr:
+			low = mid
+		else:
+			high = mid
+	return offset + low * stride * 4
+
+
+def string(table, offset):
+	end = table.index(0, offset)
+	return table[offset:end].decode('utf-8')
+
+
+# same as print_location() in CrashReport.cpp, returns
+# (function, offset, file, line) with file and line None when unknown
+def decode(table, addr):
+	hdr = struct.unpack_from('<9I', table, 0)
+	if hdr[0] != crl.MAGIC:
+		return None
+	addr &= ~1
+	func = table_search(table, hdr[3], hdr[2], 3, addr)
+	if func is None:
+		return None
+	faddr, fsize, fname = struct.unpack_from('<III', table, func)
+	if addr >= faddr + fsize:
+		return None
+	result = [string(table, hdr[7] + fname), addr - faddr, None, None]
+	block = table_search(table, hdr[5], hdr[4], 2, addr)
+	if block is not None:
+		s = word(table, block + 4)
+		if block + 8 < hdr[5] + hdr[4] * 8:
+			end = word(table, block + 12)
+		else:
+			end = hdr[8]
+		a = word(table, block)
+		file = line = found_file = found_line = 0
+		while s < end:
+			delta, s = uleb128(table, s, end)
+			a += delta >> 1
+			if a > addr:
+				break
+			if delta & 1:
+				file, s = uleb128(table, s, end)
+			n, s = sleb128(table, s, end)
+			line = (line + n) & 0xFFFFFFFF
+			found_file = file
+			found_line = line
+		nfiles = (hdr[7] - hdr[6]) // 4
+		if found_line and found_file < nfiles:
+			result[2] = string(table, hdr[7] + word(table, hdr[6] + found_file * 4))
+			result[3] = found_line
+	return tuple(result)
+
+
+# what decode() should find, by linear search of the input
+def expected(funcs, rows, addr):
+	addr &= ~1
+	func = [f for f in funcs if f[0] <= addr]
+	if not func or addr >= func[-1][0] + func[-1][1]:
+		return None
+	faddr, fsize, fname = func[-1]
+	row = [r for r in rows if r[0] <= addr]
+	if not row or row[-1][2] == 0:
+		return (fname, addr - faddr, None, None)
+	return (fname, addr - faddr, row[-1][1], row[-1][2])
+
+
+def synthetic(seed, nfuncs, start):
+	rand = random.Random(seed)
+	files = ['sketch.ino', 'src/lib.cpp', 'teensy4/usb.c', 'ünïcode.h']
+	funcs = []
+	rows = []
+	addr = start
+	for i in range(nfuncs):
+		size = rand.choice([2, 4, 6, 40, 300, 5000, 70000])
+		funcs.append((addr, size, 'func%d(int, char*)' % i))
+		a = addr
+		line = rand.randint(1, 20000)
+		while a < addr + size:
+			if rand.random() < 0.05:
+				rows.append((a, rand.choice(files), 0))
+			else:
+				rows.append((a, rand.choice(files), line))
+			line = max(1, line + rand.randint(-300, 300))
+			a += rand.choice([2, 2, 4, 8, 130, 20000])
+		# gaps between functions have no function, but the last row
+		# still covers them in the line table
+		addr += size + rand.choice([0, 0, 2, 8])
+	return funcs, rows
+
+
+class RoundTrip(unittest.TestCase):
+
+	def check(self, funcs, rows, extra=()):
+		table = bytes(crl.encode(funcs, rows))
+		self.assertEqual(len(table) % 4, 0)
+		self.assertEqual(word(table, 4), len(table))
+		addrs = set(extra)
+		for a, size, name in funcs:
+			addrs.update((a - 2, a, a + 1, a + size - 2, a + size))
+		for a, file, line in rows:
+			addrs.update((a - 2, a, a + 2))
+		for addr in sorted(addrs):
+			if addr < 0 or addr > 0xFFFFFFFF:
+				continue
+			self.assertEqual(decode(table, addr), expected(funcs, rows, addr),
+				'address 0x%08X' % addr)
+
+	def test_leb128(self):
+		for n in [0, 1, 63, 64, 127, 128, 300, 16383, 16384, 0xFFFFFFF, 0xFFFFFFFF]:
+			data = bytes(crl.uleb128(n))
+			self.assertEqual(uleb128(data, 0, len(data)), (n, len(data)))
+		for n in [0, 1, -1, 63, -64, 64, -65, 8191, -8192, 100000, -100000, 2**31 - 1, -2**31]:
+			data = bytes(crl.sleb128(n))
+			self.assertEqual(sleb128(data, 0, len(data)), (n, len(data)))
+
+	def test_empty(self):
+		self.check([], [], extra=[0, 0x60001000])
+		self.check([(0x60001000, 16, 'f')], [], extra=[0x60001008])
+
+	def test_single_block(self):
+		funcs = [(0x60001000, 32, 'setup'), (0x60001020, 64, 'loop')]
+		rows = [(0x60001000, 'a.ino', 10), (0x60001008, 'a.ino', 12),
+			(0x60001020, 'b.cpp', 5), (0x60001030, 'b.cpp', 0),
+			(0x60001040, 'a.ino', 99999)]
+		self.check(funcs, rows)
+
+	def test_many_blocks_flash(self):
+		funcs, rows = synthetic(1, 400, 0x60002000)
+		self.assertGreater(len(rows), 4 * crl.ROWS_PER_BLOCK)
+		self.check(funcs, rows)
+
+	def test_itcm_and_flash(self):
+		# ITCM code starts at address 0, then flash
+		f1, r1 = synthetic(2, 50, 0x00000000)
+		f2, r2 = synthetic(3, 50, 0x60002000)
+		self.check(f1 + f2, r1 + r2)
+
+	def test_block_boundary(self):
+		# rows exactly ROWS_PER_BLOCK apart, file change as first row of a block
+		n = crl.ROWS_PER_BLOCK
+		funcs = [(0x60000000, 4 * n * 3, 'big')]
+		rows = [(0x60000000 + 4 * i, 'x.c' if i < n else 'y.c', i + 1) for i in range(n * 3)]
+		self.check(funcs, rows)
+
+
+if __name__ == '__main__':
+	unittest.main()
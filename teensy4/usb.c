@@ -12,6 +12,7 @@
 #include "usb_midi.h"
 #include "usb_audio.h"
 #include "usb_mtp.h"
+#include "usb_msc.h"
 #include "core_pins.h" // for delay()
 #include "avr/pgmspace.h"
 #include <string.h>
@@ -483,6 +484,9 @@ static void endpoint0_setup(uint64_t setupdata)
 		#if defined(MTP_INTERFACE)
 		usb_mtp_configure();
 		#endif
+		#if defined(MSC_INTERFACE)
+		usb_msc_configure();
+		#endif
 		#if defined(EXPERIMENTAL_INTERFACE)
 		memset(endpoint_queue_head + 2, 0, sizeof(endpoint_t) * 2);
 		endpoint_queue_head[2].pointer4 = 0xB8C6CF5D;
@@ -526,10 +530,13 @@ static void endpoint0_setup(uint64_t setupdata)
 		endpoint = setup.wIndex & 0x7F;
 		if (endpoint > 7) break;
 		dir = setup.wIndex & 0x80;
+		// clearing halt also resets the data toggle to DATA0
 		if (dir) {
-			*((volatile uint32_t *)&USB1_ENDPTCTRL0 + endpoint) &= ~USB_ENDPTCTRL_TXS;
+			*((volatile uint32_t *)&USB1_ENDPTCTRL0 + endpoint) = (*((volatile uint32_t *)&USB1_ENDPTCTRL0 + endpoint)
+				& ~USB_ENDPTCTRL_TXS) | USB_ENDPTCTRL_TXR;
 		} else {
-			*((volatile uint32_t *)&USB1_ENDPTCTRL0 + endpoint) &= ~USB_ENDPTCTRL_RXS;
+			*((volatile uint32_t *)&USB1_ENDPTCTRL0 + endpoint) = (*((volatile uint32_t *)&USB1_ENDPTCTRL0 + endpoint)
+				& ~USB_ENDPTCTRL_RXS) | USB_ENDPTCTRL_RXR;
 		}
 		endpoint0_receive(NULL, 0, 0);
 		return;
@@ -695,6 +702,22 @@ static void endpoint0_setup(uint64_t setupdata)
 		}
 		break;
 #endif
+#if defined(MSC_INTERFACE)
+	  case 0xFEA1: // Get Max LUN, Bulk-Only Transport 1.0, 3.2, page 7
+		if (setup.wIndex == MSC_INTERFACE && setup.wLength >= 1) {
+			endpoint0_buffer[0] = 0;
+			endpoint0_transmit(endpoint0_buffer, 1, 0);
+			return;
+		}
+		break;
+	  case 0xFF21: // Bulk-Only Mass Storage Reset, 3.1, page 7
+		if (setup.wIndex == MSC_INTERFACE) {
+			usb_msc_reset();
+			endpoint0_receive(NULL, 0, 0);
+			return;
+		}
+		break;
+#endif
 #if defined(MTP_INTERFACE)
 	  case 0x6421: // Cancel Request, Still Image Class 1.0, 5.2.1, page 8
 		if (setup.wLength == 6) {
@@ -1091,6 +1114,21 @@ void usb_receive(int endpoint_number, transfer_t *transfer)
 	schedule_transfer(endpoint, mask, transfer);
 }
 
+void usb_stall(int endpoint_number, int tx)
+{
+	if (endpoint_number < 2 || endpoint_number > NUM_ENDPOINTS) return;
+	volatile uint32_t *ctrl = (volatile uint32_t *)&USB1_ENDPTCTRL0 + endpoint_number;
+	*ctrl |= (tx ? USB_ENDPTCTRL_TXS : USB_ENDPTCTRL_RXS);
+}
+
+// the host clears the stall with CLEAR_FEATURE
+int usb_stalled(int endpoint_number, int tx)
+{
+	if (endpoint_number < 2 || endpoint_number > NUM_ENDPOINTS) return 0;
+	uint32_t ctrl = *((volatile uint32_t *)&USB1_ENDPTCTRL0 + endpoint_number);
+	return (ctrl & (tx ? USB_ENDPTCTRL_TXS : USB_ENDPTCTRL_RXS)) ? 1 : 0;
+}
+
 uint32_t usb_transfer_status(const transfer_t *transfer)
 {
 #if defined(USB_MTPDISK) || defined(USB_MTPDISK_SERIAL)
@@ -46,8 +46,9 @@ static void tx_event(transfer_t *t);
 /*static*/ transfer_t rx_transfer __attribute__ ((used, aligned(32)));
 /*static*/ transfer_t sync_transfer __attribute__ ((used, aligned(32)));
 /*static*/ transfer_t tx_transfer __attribute__ ((used, aligned(32)));
-DMAMEM static uint8_t rx_buffer[AUDIO_RX_SIZE] __attribute__ ((aligned(32)));
-DMAMEM static uint8_t tx_buffer[AUDIO_RX_SIZE] __attribute__ ((aligned(32)));
+#define AUDIO_RX_BUFSIZE (AUDIO_RX_SIZE * USB_AUDIO_PACKET_MULT)
+#define AUDIO_TX_BUFSIZE (AUDIO_TX_SIZE * USB_AUDIO_PACKET_MULT)
+DMAMEM static uint8_t rx_buffer[AUDIO_RX_BUFSIZE] __attribute__ ((aligned(32)));
 DMAMEM uint32_t usb_audio_sync_feedback __attribute__ ((aligned(32)));
 
 uint8_t usb_audio_receive_setting=0;
@@ -65,12 +66,12 @@ volatile int16_t buffer_counter = 0;  // used to monitor the current buffer fill
 static void rx_event(transfer_t *t)
 {
 	if (t) {
-		int len = AUDIO_RX_SIZE - ((rx_transfer.status >> 16) & 0x7FFF);
+		int len = AUDIO_RX_BUFSIZE - ((rx_transfer.status >> 16) & 0x7FFF);
 		printf("rx %u\n", len);
 		usb_audio_receive_callback(len);
 	}
-	usb_prepare_transfer(&rx_transfer, rx_buffer, AUDIO_RX_SIZE, 0);
-	arm_dcache_delete(&rx_buffer, AUDIO_RX_SIZE);
+	usb_prepare_transfer(&rx_transfer, rx_buffer, AUDIO_RX_BUFSIZE, 0);
+	arm_dcache_delete(&rx_buffer, AUDIO_RX_BUFSIZE);
 	usb_receive(AUDIO_RX_ENDPOINT, &rx_transfer);
 }
 
@@ -109,6 +110,160 @@ static void copy_to_buffers(const uint32_t *src, int16_t *left, int16_t *right,
 	}
 }
 
+// Unaligned 16 bit access, a single LDRH / STRH on Cortex-M7
+static inline uint32_t load16(const uint8_t *p)
+{
+	uint16_t n;
+	memcpy(&n, p, 2);
+	return n;
+}
+
+static inline void store16(uint8_t *p, uint32_t n)
+{
+	uint16_t h = n;
+	memcpy(p, &h, 2);
+}
+
+#if defined(USB_AUDIO_F32)
+#define F32_SCALE (1.0f / 2147483648.0f)
+
+// A whole subframe as a full scale 32 bit sample (24 bit in the upper bits)
+static inline int32_t load_sample(const uint8_t *p)
+{
+#if USB_AUDIO_SUBFRAME_SIZE == 4
+	int32_t n;
+	memcpy(&n, p, 4);
+	return n;
+#else
+	return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+#endif
+}
+
+static inline void store_sample(uint8_t *p, int32_t n)
+{
+#if USB_AUDIO_SUBFRAME_SIZE == 4
+	memcpy(p, &n, 4);
+#else
+	p[0] = n >> 8;
+	store16(p + 1, (uint32_t)n >> 16);
+#endif
+}
+
+static inline int32_t float_to_sample(float f)
+{
+	float x = f * 2147483648.0f;
+	if (x >= 2147483647.0f) return 0x7FFFFFFF;
+	if (x <= -2147483648.0f) return (int32_t)0x80000000;
+	return (int32_t)x;
+}
+#endif
+
+#if defined(USB_AUDIO_FEEDBACK_SOF)
+#if USB_AUDIO_SUBFRAME_SIZE == 2 && (USB_AUDIO_CHANNELS % 2) == 0 && USB_AUDIO_CHANNELS > 2
+// Like copy_to_buffers(), for one pair of channels in frames of "stride"
+// 32 bit words.  Each word holds both channels of the pair.
+static void copy_pair_to_buffers(const uint32_t *src, unsigned int stride,
+	int16_t *a, int16_t *b, unsigned int len)
+{
+	if (((uintptr_t)a & 0x02) && len > 0) {
+		uint32_t n = *src;
+		*a++ = n & 0xFFFF;
+		*b++ = n >> 16;
+		src += stride;
+		len--;
+	}
+	while (len >= 2) {
+		uint32_t n1 = src[0];
+		uint32_t n2 = src[stride];
+		*(uint32_t *)a = (n1 & 0xFFFF) | (n2 << 16);
+		*(uint32_t *)b = (n1 >> 16) | (n2 & 0xFFFF0000);
+		a += 2;
+		b += 2;
+		src += stride * 2;
+		len -= 2;
+	}
+	if (len > 0) {
+		uint32_t n = *src;
+		*a = n & 0xFFFF;
+		*b = n >> 16;
+	}
+}
+#endif
+
+// Copy interleaved USB audio frames into one audio block per channel.  Each
+// subframe is little endian, so its most significant 16 bits are the last 2
+// bytes.  Pairs of samples are combined into 32 bit writes (PKHBT/PKHTB).
+// Float blocks, when present, get the whole 24 or 32 bit sample.
+static void copy_to_blocks(const uint8_t *src, audio_block_t * const *blocks,
+	audio_block_f32_t * const *fblocks, unsigned int offset, unsigned int len)
+{
+#if USB_AUDIO_CHANNELS == 2 && USB_AUDIO_SUBFRAME_SIZE == 2
+	copy_to_buffers((const uint32_t *)src, blocks[0]->data + offset,
+		blocks[1]->data + offset, len);
+#elif USB_AUDIO_SUBFRAME_SIZE == 2 && (USB_AUDIO_CHANNELS % 2) == 0
+	for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch += 2) {
+		copy_pair_to_buffers((const uint32_t *)src + ch / 2, USB_AUDIO_CHANNELS / 2,
+			blocks[ch]->data + offset, blocks[ch + 1]->data + offset, len);
+	}
+#else
+	for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+		const uint8_t *p = src + ch * USB_AUDIO_SUBFRAME_SIZE;
+		int16_t *dst = blocks[ch]->data + offset;
+		unsigned int n = len;
+#if defined(USB_AUDIO_F32)
+		if (fblocks[ch]) {
+			float *f = fblocks[ch]->data + offset;
+			while (n > 0) {
+				int32_t sample = load_sample(p);
+				*dst++ = sample >> 16;
+				*f++ = (float)sample * F32_SCALE;
+				p += USB_AUDIO_FRAME_SIZE;
+				n--;
+			}
+			continue;
+		}
+#endif
+#if USB_AUDIO_SUBFRAME_SIZE == 4
+		// frames are whole words, the upper halves of 2 words pack into one
+		const uint32_t *w = (const uint32_t *)p;
+		if (((uintptr_t)dst & 0x02) && n > 0) {
+			*dst++ = *w >> 16;
+			w += USB_AUDIO_CHANNELS;
+			n--;
+		}
+		while (n >= 2) {
+			*(uint32_t *)dst = (w[0] >> 16) | (w[USB_AUDIO_CHANNELS] & 0xFFFF0000);
+			dst += 2;
+			w += USB_AUDIO_CHANNELS * 2;
+			n -= 2;
+		}
+		if (n > 0) *dst = *w >> 16;
+#else
+		p += USB_AUDIO_SUBFRAME_SIZE - 2;
+		if (((uintptr_t)dst & 0x02) && n > 0) {
+			*dst++ = load16(p);
+			p += USB_AUDIO_FRAME_SIZE;
+			n--;
+		}
+		while (n >= 2) {
+			uint32_t s1 = load16(p);
+			uint32_t s2 = load16(p + USB_AUDIO_FRAME_SIZE);
+			*(uint32_t *)dst = s1 | (s2 << 16);
+			dst += 2;
+			p += USB_AUDIO_FRAME_SIZE * 2;
+			n -= 2;
+		}
+		if (n > 0) *dst = load16(p);
+#endif
+	}
+#endif
+}
+#else
+#if USB_AUDIO_CHANNELS != 2 || USB_AUDIO_SUBFRAME_SIZE != 2
+#error "Multichannel and 24/32 bit USB audio requires USB_AUDIO_FEEDBACK_SOF"
+#endif
+#endif
+
 //
 // For very small audio block sizes, the original code cannot work
 // so we must use the DL1YCF version (since FEEDBACK_SOF) requires
@@ -143,12 +298,16 @@ static const uint32_t USB_AUDIO_FEEDBACK_MAX  = 740210769; // 44.120 * 2^24
 static const uint32_t USB_AUDIO_FEEDBACK_MIN  = 739539681; // 44.080 * 2^24
 #endif
 
+#if !defined(USB_AUDIO_ASRC)
 // Static in this context (outside of a function) means the variable scope is this file only
-static audio_block_t *ready_left[USB_AUDIO_INPUT_BUFFERS];
-static audio_block_t *ready_right[USB_AUDIO_INPUT_BUFFERS];
+static audio_block_t *ready[USB_AUDIO_INPUT_BUFFERS][USB_AUDIO_CHANNELS];
+static audio_block_f32_t *ready_f32[USB_AUDIO_INPUT_BUFFERS][USB_AUDIO_CHANNELS];
 static volatile uint16_t write_index = 0;
 static volatile uint16_t read_index = 0;
 static volatile uint16_t write_count = 0;
+#else
+static void asrc_reset(void);
+#endif
 
 //static uint32_t usb_audio_near_overrun_count = 0;
 //static uint32_t usb_audio_near_underrun_count = 0;
@@ -166,10 +325,16 @@ void usb_audio_configure(void)
 {
 	feedback_accumulator = USB_AUDIO_FEEDBACK_INIT;
 
+#if !defined(USB_AUDIO_ASRC)
 	for (uint16_t i = 0; i<USB_AUDIO_INPUT_BUFFERS; i++) {
-		ready_right[i] = NULL;
-		ready_left[i] = NULL;
+		for (uint16_t ch = 0; ch<USB_AUDIO_CHANNELS; ch++) {
+			ready[i][ch] = NULL;
+			ready_f32[i][ch] = NULL;
+		}
 	}
+#else
+	asrc_reset();
+#endif
 
 	// Microsoft windows still expects 10.14 when UAC1 even at high speed
 	// Linux accepts this too
@@ -180,18 +345,24 @@ void usb_audio_configure(void)
 		usb_audio_sync_nbytes = 3;
 		usb_audio_sync_rshift = 10;
 	//}
+	// high bandwidth (more than 1 packet per microframe) is only for 480 Mbit
+	int mult = usb_high_speed ? USB_AUDIO_PACKET_MULT : 1;
+#if USB_AUDIO_PACKET_SIZE > 1023
+	if (!usb_high_speed) return; // USB_AUDIO_HIGH_SPEED_ONLY
+#endif
 	memset(&rx_transfer, 0, sizeof(rx_transfer));
-	usb_config_rx_iso(AUDIO_RX_ENDPOINT, AUDIO_RX_SIZE, 1, rx_event);
+	usb_config_rx_iso(AUDIO_RX_ENDPOINT, AUDIO_RX_SIZE, mult, rx_event);
 	rx_event(NULL);
 	memset(&sync_transfer, 0, sizeof(sync_transfer));
 	usb_config_tx_iso(AUDIO_SYNC_ENDPOINT, usb_audio_sync_nbytes, 1, sync_event);
 	sync_event(NULL);
 	memset(&tx_transfer, 0, sizeof(tx_transfer));
-	usb_config_tx_iso(AUDIO_TX_ENDPOINT, AUDIO_TX_SIZE, 1, tx_event);
+	usb_config_tx_iso(AUDIO_TX_ENDPOINT, AUDIO_TX_SIZE, mult, tx_event);
 	tx_event(NULL);
 	usb_start_sof_interrupts(AUDIO_INTERFACE);
 }
 
+#if !defined(USB_AUDIO_ASRC)
 void AudioInputUSB::begin(void)
 {
 	// update_responsibility = update_setup();
@@ -208,28 +379,34 @@ void AudioInputUSB::begin(void)
 //
 void usb_audio_receive_callback(unsigned int len)
 {
-	static audio_block_t *left = NULL;
-	static audio_block_t *right = NULL;
-	const uint32_t *data;
+	static audio_block_t *incoming[USB_AUDIO_CHANNELS];
+	static audio_block_f32_t *incoming_f32[USB_AUDIO_CHANNELS];
+	const uint8_t *data;
 	uint16_t avail;
 
-	len >>= 2; // 1 sample = 4 bytes: 2 left, 2 right
-	data = (const uint32_t *)rx_buffer;
+	len /= USB_AUDIO_FRAME_SIZE; // 1 sample = 1 subframe for each channel
+	data = rx_buffer;
 
-	if (left == NULL) {
-		left = AudioStream::allocate();
-		if (left == NULL) return;
+	for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+		if (incoming[ch] == NULL) {
+			incoming[ch] = AudioStream::allocate();
+			if (incoming[ch] == NULL) return;
+		}
 	}
-	if (right == NULL) {
-		right = AudioStream::allocate();
-		if (right == NULL) return;
+#if defined(USB_AUDIO_F32)
+	// float blocks are optional, only begun with an empty 16 bit block
+	if (write_count == 0) {
+		for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+			if (incoming_f32[ch] == NULL) incoming_f32[ch] = AudioStream::allocate_f32();
+		}
 	}
+#endif
 
 	while (len > 0) {
 
 		avail = AUDIO_BLOCK_SAMPLES - write_count;
 		if (len < avail) {
-			copy_to_buffers(data, left->data + write_count, right->data + write_count, len);
+			copy_to_blocks(data, incoming, incoming_f32, write_count, len);
 			buffer_counter += len;
 			write_count = write_count + len;
 
@@ -237,19 +414,19 @@ void usb_audio_receive_callback(unsigned int len)
 			//if ((avail - len) >= USB_AUDIO_GUARD_RAIL) return;
 
 			//// Within guard rail so check if possible to send now
-			//if (ready_left[write_index] || ready_right[write_index]) {
+			//if (ready[write_index][0]) {
 			//	usb_audio_near_overrun_count++;
 			//	usb_audio_samples_consumed -= uint64_t(usb_audio_samples_consumed >> 25);
 			//}
 			return;
 
 		} else if (avail > 0) {
-			copy_to_buffers(data, left->data + write_count, right->data + write_count, avail);
+			copy_to_blocks(data, incoming, incoming_f32, write_count, avail);
 			buffer_counter += avail;
-			data += avail;
+			data += avail * USB_AUDIO_FRAME_SIZE;
 			len -= avail;
 
-			if (ready_left[write_index] || ready_right[write_index]) {
+			if (ready[write_index][0]) {
 				// buffer overrun, PC sending too fast
 				write_count = write_count + avail;
 				if (len > 0) {
@@ -267,28 +444,38 @@ void usb_audio_receive_callback(unsigned int len)
 			
 			send:
 
-
-			ready_left[write_index] = left;
-			ready_right[write_index] = right;
+			for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+				ready[write_index][ch] = incoming[ch];
+				incoming[ch] = NULL;
+				ready_f32[write_index][ch] = incoming_f32[ch];
+				incoming_f32[ch] = NULL;
+			}
 
 			write_count = 0;
 
 			write_index++;
 			if (write_index >= USB_AUDIO_INPUT_BUFFERS) write_index = 0;
-	
-			left = AudioStream::allocate();
-			if (left == NULL) {
-				return;
+
+			for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+				incoming[ch] = AudioStream::allocate();
+				if (incoming[ch] == NULL) {
+					while (ch > 0) {
+						ch--;
+						AudioStream::release(incoming[ch]);
+						incoming[ch] = NULL;
+					}
+					return;
+				}
 			}
-			right = AudioStream::allocate();
-			if (right == NULL) {
-				AudioStream::release(left);
-				return;
+#if defined(USB_AUDIO_F32)
+			for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+				incoming_f32[ch] = AudioStream::allocate_f32();
 			}
+#endif
 
 		} else {
 
-			if (ready_left[write_index] || ready_right[write_index]) {
+			if (ready[write_index][0]) {
 				// Continued overrun, dropping full length
 				usb_audio_overrun_count++;
 				return;
@@ -301,7 +488,8 @@ void usb_audio_receive_callback(unsigned int len)
 
 void AudioInputUSB::update(void)
 {
-	audio_block_t *left, *right;
+	audio_block_t *blocks[USB_AUDIO_CHANNELS];
+	audio_block_f32_t *fblocks[USB_AUDIO_CHANNELS];
 	static uint16_t rate_errors = 0;
 
 	uint16_t next_read_index;
@@ -310,11 +498,13 @@ void AudioInputUSB::update(void)
 
 	//uint16_t local_write_index = write_index;
 	//uint16_t local_write_count = write_count;
-	left = ready_left[read_index];
-	ready_left[read_index] = NULL;
-	right = ready_right[read_index];
-	ready_right[read_index] = NULL;
-	if (left && right) buffer_counter -= AUDIO_BLOCK_SAMPLES;
+	for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+		blocks[ch] = ready[read_index][ch];
+		ready[read_index][ch] = NULL;
+		fblocks[ch] = ready_f32[read_index][ch];
+		ready_f32[read_index][ch] = NULL;
+	}
+	if (blocks[0]) buffer_counter -= AUDIO_BLOCK_SAMPLES;
 	uint16_t local_buf_cnt = buffer_counter;
 
 	uint32_t frames_counted = usb_audio_frames_counted;
@@ -393,7 +583,7 @@ void AudioInputUSB::update(void)
 		next_read_index = 0;
 	}
 
-	if (!left || !right) {
+	if (!blocks[0]) {
 		usb_audio_underrun_count++;
 		// Don't adjust samples here as when there is no audio for host there will be underruns
 	} 
@@ -406,18 +596,220 @@ void AudioInputUSB::update(void)
 	//	}
 	//}
 
-	if (left) {
+	if (blocks[0]) {
 		read_index = next_read_index;
-		transmit(left, 0);
-		release(left);
+		for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+			transmit(blocks[ch], ch);
+			release(blocks[ch]);
+		}
 	}
-	if (right) {
-		transmit(right, 1);
-		release(right);
+	for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+		if (fblocks[ch]) {
+			transmit(fblocks[ch], ch);
+			release(fblocks[ch]);
+		}
 	}
 }
 
 
+#else // USB_AUDIO_ASRC
+
+// Asynchronous sample rate conversion.  Received samples are kept in a FIFO
+// per channel and resampled to the rate update() is called, which may be
+// from an I2S master or any other clock unrelated to the USB host.  The
+// resampling ratio is steered by a PI loop that holds the FIFO fill level
+// near ASRC_TARGET_FILL.  A polyphase windowed sinc filter interpolates
+// between input samples, with linear interpolation between phases.  The
+// feedback endpoint reports the nominal rate, so this works no matter
+// which side is the clock master.
+
+#define ASRC_FIFO_SIZE    1024  // samples per channel, must be power of 2
+#define ASRC_TAPS         8     // filter length, must be even
+#define ASRC_PHASES       64    // filter phases between input samples
+#define ASRC_TARGET_FILL  (AUDIO_BLOCK_SAMPLES * 2 + ASRC_TAPS)
+#define ASRC_MAX_ADJUST   0.005f  // ratio limit, +/- 0.5%
+
+#if defined(USB_AUDIO_F32)
+typedef int32_t asrc_sample_t;     // full scale 32 bit samples
+#define ASRC_INT16_SCALE (1.0f / 65536.0f)
+#else
+typedef int16_t asrc_sample_t;
+#define ASRC_INT16_SCALE 1.0f
+#endif
+DMAMEM static asrc_sample_t asrc_fifo[USB_AUDIO_CHANNELS][ASRC_FIFO_SIZE] __attribute__ ((aligned(32)));
+static float asrc_filter[ASRC_PHASES + 1][ASRC_TAPS];
+static volatile uint32_t asrc_write_pos = 0; // total samples written, wraps
+static volatile uint32_t asrc_read_pos = 0;  // integer part of read position
+static float asrc_read_frac = 0.0f;          // fractional part, 0 to 1.0
+static float asrc_ratio = 1.0f;              // input samples per output sample
+static float asrc_integral = 0.0f;
+static volatile uint8_t asrc_running = 0;
+
+static void asrc_reset(void)
+{
+	asrc_running = 0;
+	asrc_write_pos = 0;
+	asrc_read_pos = 0;
+	asrc_read_frac = 0.0f;
+}
+
+float AudioInputUSB::resampleRatio(void)
+{
+	return asrc_ratio;
+}
+
+void AudioInputUSB::begin(void)
+{
+	// windowed sinc, cutoff 0.45 * sample rate, Blackman window
+	const float fc = 0.9f;
+	for (int p=0; p <= ASRC_PHASES; p++) {
+		float sum = 0.0f;
+		for (int k=0; k < ASRC_TAPS; k++) {
+			float d = (float)(k - (ASRC_TAPS/2 - 1)) - (float)p / (float)ASRC_PHASES;
+			float x = (float)M_PI * fc * d;
+			float h = (d == 0.0f) ? 1.0f : sinf(x) / x;
+			float w = 2.0f * (float)M_PI * (d / (float)ASRC_TAPS + 0.5f);
+			h *= 0.42f - 0.5f * cosf(w) + 0.08f * cosf(2.0f * w);
+			asrc_filter[p][k] = h;
+			sum += h;
+		}
+		for (int k=0; k < ASRC_TAPS; k++) {
+			asrc_filter[p][k] /= sum; // unity gain at DC for every phase
+		}
+	}
+	update_responsibility = false;
+}
+
+// Called from the USB interrupt when an isochronous packet arrives
+// we must completely remove it from the receive buffer before returning
+//
+void usb_audio_receive_callback(unsigned int len)
+{
+	const uint8_t *data = rx_buffer;
+	uint32_t wpos = asrc_write_pos;
+
+	len /= USB_AUDIO_FRAME_SIZE;
+	if (len == 0) return;
+	// keep ASRC_TAPS of history behind the read position
+	if (asrc_running && (wpos + len) - asrc_read_pos > ASRC_FIFO_SIZE - ASRC_TAPS) {
+		usb_audio_overrun_count++;
+		return;
+	}
+	for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+		const uint8_t *p = data + ch * USB_AUDIO_SUBFRAME_SIZE;
+		asrc_sample_t *fifo = asrc_fifo[ch];
+		uint32_t pos = wpos;
+		for (unsigned int i=0; i < len; i++) {
+#if defined(USB_AUDIO_F32)
+			fifo[pos++ & (ASRC_FIFO_SIZE - 1)] = load_sample(p);
+#else
+			fifo[pos++ & (ASRC_FIFO_SIZE - 1)] = load16(p);
+#endif
+			p += USB_AUDIO_FRAME_SIZE;
+		}
+	}
+	asrc_write_pos = wpos + len;
+}
+
+void AudioInputUSB::update(void)
+{
+	audio_block_t *blocks[USB_AUDIO_CHANNELS];
+	audio_block_f32_t *fblocks[USB_AUDIO_CHANNELS];
+	float coef[ASRC_TAPS];
+	unsigned int ch;
+
+	uint32_t wpos = asrc_write_pos;
+	uint32_t rpos = asrc_read_pos;
+	if (!asrc_running) {
+		// wait for the FIFO to fill to the target level, then begin
+		if (wpos < ASRC_TARGET_FILL) return;
+		rpos = wpos - ASRC_TARGET_FILL + ASRC_TAPS/2;
+		asrc_read_frac = 0.0f;
+		asrc_integral = 0.0f;
+		asrc_ratio = 1.0f;
+		asrc_read_pos = rpos;
+		asrc_running = 1;
+	}
+	float fill = (float)(int32_t)(wpos - rpos) - asrc_read_frac;
+	if (fill < AUDIO_BLOCK_SAMPLES * (1.0f + ASRC_MAX_ADJUST) + ASRC_TAPS/2) {
+		// PC stopped sending or is far too slow, start over
+		usb_audio_underrun_count++;
+		__disable_irq();
+		asrc_reset();
+		__enable_irq();
+		return;
+	}
+
+	// PI control of the ratio, to keep the fill level at target
+	float err = (fill - (float)(ASRC_TARGET_FILL - ASRC_TAPS/2)) * (1.0f / AUDIO_BLOCK_SAMPLES);
+	asrc_integral += err * 2.0e-6f;
+	if (asrc_integral > ASRC_MAX_ADJUST) asrc_integral = ASRC_MAX_ADJUST;
+	if (asrc_integral < -ASRC_MAX_ADJUST) asrc_integral = -ASRC_MAX_ADJUST;
+	float adjust = asrc_integral + err * 1.0e-4f;
+	if (adjust > ASRC_MAX_ADJUST) adjust = ASRC_MAX_ADJUST;
+	if (adjust < -ASRC_MAX_ADJUST) adjust = -ASRC_MAX_ADJUST;
+	asrc_ratio = 1.0f + adjust;
+
+	for (ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+		blocks[ch] = allocate();
+		if (blocks[ch] == NULL) {
+			while (ch > 0) release(blocks[--ch]);
+			return;
+		}
+	}
+	for (ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+#if defined(USB_AUDIO_F32)
+		fblocks[ch] = allocate_f32();
+#else
+		fblocks[ch] = NULL;
+#endif
+	}
+
+	float frac = asrc_read_frac;
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		float phase = frac * ASRC_PHASES;
+		int n = (int)phase;
+		float t = phase - (float)n;
+		const float *c0 = asrc_filter[n];
+		const float *c1 = asrc_filter[n + 1];
+		for (int k=0; k < ASRC_TAPS; k++) {
+			coef[k] = c0[k] + (c1[k] - c0[k]) * t;
+		}
+		uint32_t first = rpos - (ASRC_TAPS/2 - 1);
+		for (ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+			const asrc_sample_t *fifo = asrc_fifo[ch];
+			float sum = 0.0f;
+			for (int k=0; k < ASRC_TAPS; k++) {
+				sum += coef[k] * (float)fifo[(first + k) & (ASRC_FIFO_SIZE - 1)];
+			}
+#if defined(USB_AUDIO_F32)
+			if (fblocks[ch]) fblocks[ch]->data[i] = sum * F32_SCALE;
+#endif
+			sum *= ASRC_INT16_SCALE;
+			if (sum > 32767.0f) sum = 32767.0f;
+			if (sum < -32768.0f) sum = -32768.0f;
+			blocks[ch]->data[i] = (int16_t)sum;
+		}
+		frac += asrc_ratio;
+		int advance = (int)frac;
+		rpos += advance;
+		frac -= (float)advance;
+	}
+	asrc_read_frac = frac;
+	asrc_read_pos = rpos;
+
+	for (ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+		transmit(blocks[ch], ch);
+		release(blocks[ch]);
+		if (fblocks[ch]) {
+			transmit(fblocks[ch], ch);
+			release(fblocks[ch]);
+		}
+	}
+}
+
+#endif // USB_AUDIO_ASRC
+
 #elif defined(USB_AUDIO_FEEDBACK_DL1YCF)
 
 static const uint16_t USB_AUDIO_INPUT_BUFFERS=4;
@@ -479,13 +871,13 @@ void usb_audio_configure(void)
 				usb_audio_sync_rshift = 10;
 		}
 		memset(&rx_transfer, 0, sizeof(rx_transfer));
-		usb_config_rx_iso(AUDIO_RX_ENDPOINT, AUDIO_RX_SIZE, 1, rx_event);
+		usb_config_rx_iso(AUDIO_RX_ENDPOINT, AUDIO_RX_SIZE, USB_AUDIO_PACKET_MULT, rx_event);
 		rx_event(NULL);
 		memset(&sync_transfer, 0, sizeof(sync_transfer));
 		usb_config_tx_iso(AUDIO_SYNC_ENDPOINT, usb_audio_sync_nbytes, 1, sync_event);
 		sync_event(NULL);
 		memset(&tx_transfer, 0, sizeof(tx_transfer));
-		usb_config_tx_iso(AUDIO_TX_ENDPOINT, AUDIO_TX_SIZE, 1, tx_event);
+		usb_config_tx_iso(AUDIO_TX_ENDPOINT, AUDIO_TX_SIZE, USB_AUDIO_PACKET_MULT, tx_event);
 		tx_event(NULL);
 		usb_start_sof_interrupts(AUDIO_INTERFACE);
 }
@@ -767,13 +1159,13 @@ void usb_audio_configure(void)
 		usb_audio_sync_rshift = 10;
 	}
 	memset(&rx_transfer, 0, sizeof(rx_transfer));
-	usb_config_rx_iso(AUDIO_RX_ENDPOINT, AUDIO_RX_SIZE, 1, rx_event);
+	usb_config_rx_iso(AUDIO_RX_ENDPOINT, AUDIO_RX_SIZE, USB_AUDIO_PACKET_MULT, rx_event);
 	rx_event(NULL);
 	memset(&sync_transfer, 0, sizeof(sync_transfer));
 	usb_config_tx_iso(AUDIO_SYNC_ENDPOINT, usb_audio_sync_nbytes, 1, sync_event);
 	sync_event(NULL);
 	memset(&tx_transfer, 0, sizeof(tx_transfer));
-	usb_config_tx_iso(AUDIO_TX_ENDPOINT, AUDIO_TX_SIZE, 1, tx_event);
+	usb_config_tx_iso(AUDIO_TX_ENDPOINT, AUDIO_TX_SIZE, USB_AUDIO_PACKET_MULT, tx_event);
 	tx_event(NULL);
 	usb_start_sof_interrupts(AUDIO_INTERFACE);
 }
@@ -965,7 +1357,7 @@ void AudioInputUSB::update(void)
 
 
 
-/*DMAMEM*/ uint16_t usb_audio_transmit_buffer[AUDIO_TX_SIZE/2] __attribute__ ((used, aligned(32)));
+/*DMAMEM*/ uint16_t usb_audio_transmit_buffer[AUDIO_TX_BUFSIZE/2] __attribute__ ((used, aligned(32)));
 
 
 static void tx_event(transfer_t *t)
@@ -979,13 +1371,98 @@ static void tx_event(transfer_t *t)
 
 static void copy_from_buffers(uint32_t *dst, int16_t *left, int16_t *right, unsigned int len)
 {
-	// TODO: optimize...
-	while (len > 0) {
+	if (((uintptr_t)left & 0x02) && len > 0) {
 		*dst++ = (*right++ << 16) | (*left++ & 0xFFFF);
 		len--;
 	}
+	// left & right now 32 bit aligned, interleave 2 samples at a time
+	// (compiles to PKHBT / PKHTB)
+	while (len >= 2) {
+		uint32_t l = *(uint32_t *)left;
+		uint32_t r = *(uint32_t *)right;
+		*dst++ = (l & 0xFFFF) | (r << 16);
+		*dst++ = (l >> 16) | (r & 0xFFFF0000);
+		left += 2;
+		right += 2;
+		len -= 2;
+	}
+	if (len > 0) {
+		*dst = (*right << 16) | (*left & 0xFFFF);
+	}
 }
 
+#if defined(USB_AUDIO_FEEDBACK_SOF)
+#if USB_AUDIO_SUBFRAME_SIZE == 2 && (USB_AUDIO_CHANNELS % 2) == 0 && USB_AUDIO_CHANNELS > 2
+// Like copy_from_buffers(), for one pair of channels in frames of "stride"
+// 32 bit words.
+static void copy_pair_from_buffers(uint32_t *dst, unsigned int stride,
+	const int16_t *a, const int16_t *b, unsigned int len)
+{
+	if (((uintptr_t)a & 0x02) && len > 0) {
+		*dst = (*b++ << 16) | (*a++ & 0xFFFF);
+		dst += stride;
+		len--;
+	}
+	while (len >= 2) {
+		uint32_t l = *(const uint32_t *)a;
+		uint32_t r = *(const uint32_t *)b;
+		dst[0] = (l & 0xFFFF) | (r << 16);
+		dst[stride] = (l >> 16) | (r & 0xFFFF0000);
+		dst += stride * 2;
+		a += 2;
+		b += 2;
+		len -= 2;
+	}
+	if (len > 0) {
+		*dst = (*b << 16) | (*a & 0xFFFF);
+	}
+}
+#endif
+
+// Interleave one audio block per channel into USB audio frames.  16 bit
+// samples become the most significant bits of each subframe, low bytes
+// zero.  A float block, when present, is used instead at full resolution.
+static void copy_from_blocks(uint8_t *dst, audio_block_t * const *blocks,
+	audio_block_f32_t * const *fblocks, unsigned int offset, unsigned int len)
+{
+#if USB_AUDIO_CHANNELS == 2 && USB_AUDIO_SUBFRAME_SIZE == 2
+	copy_from_buffers((uint32_t *)dst, blocks[0]->data + offset,
+		blocks[1]->data + offset, len);
+#elif USB_AUDIO_SUBFRAME_SIZE == 2 && (USB_AUDIO_CHANNELS % 2) == 0
+	for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch += 2) {
+		copy_pair_from_buffers((uint32_t *)dst + ch / 2, USB_AUDIO_CHANNELS / 2,
+			blocks[ch]->data + offset, blocks[ch + 1]->data + offset, len);
+	}
+#else
+	for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+		uint8_t *p = dst + ch * USB_AUDIO_SUBFRAME_SIZE;
+#if defined(USB_AUDIO_F32)
+		if (fblocks[ch]) {
+			const float *f = fblocks[ch]->data + offset;
+			for (unsigned int i=0; i < len; i++) {
+				store_sample(p, float_to_sample(*f++));
+				p += USB_AUDIO_FRAME_SIZE;
+			}
+			continue;
+		}
+#endif
+		const int16_t *src = blocks[ch]->data + offset;
+		for (unsigned int i=0; i < len; i++) {
+#if USB_AUDIO_SUBFRAME_SIZE == 4
+			*(uint32_t *)p = (uint32_t)*src++ << 16; // frames are whole words
+#elif USB_AUDIO_SUBFRAME_SIZE == 3
+			*p = 0;
+			store16(p + 1, *src++);
+#else
+			store16(p, *src++);
+#endif
+			p += USB_AUDIO_FRAME_SIZE;
+		}
+	}
+#endif
+}
+#endif
+
 bool AudioOutputUSB::update_responsibility;
 
 
@@ -1000,8 +1477,8 @@ static const uint16_t USB_AUDIO_OUTPUT_BUFFERS=4;
 
 
 // Static in this context (outside of a function) means the variable scope is this file only
-static audio_block_t *out_ready_left[USB_AUDIO_OUTPUT_BUFFERS];
-static audio_block_t *out_ready_right[USB_AUDIO_OUTPUT_BUFFERS];
+static audio_block_t *out_ready[USB_AUDIO_OUTPUT_BUFFERS][USB_AUDIO_CHANNELS];
+static audio_block_f32_t *out_ready_f32[USB_AUDIO_OUTPUT_BUFFERS][USB_AUDIO_CHANNELS];
 static volatile uint16_t out_write_index = 0;
 static volatile uint16_t out_read_index = 0;
 static volatile uint16_t out_read_count = 0;
@@ -1015,52 +1492,58 @@ void AudioOutputUSB::begin(void)
 
 void AudioOutputUSB::update(void)
 {
-	audio_block_t *left, *right;
-	//uint16_t i;
+	audio_block_t *blocks[USB_AUDIO_CHANNELS];
+	audio_block_f32_t *fblocks[USB_AUDIO_CHANNELS];
+	unsigned int ch;
 
 	// TODO: we shouldn't be writing to these......
-	//left = receiveReadOnly(0); // input 0 = left channel
-	//right = receiveReadOnly(1); // input 1 = right channel
-	left = receiveWritable(0); // input 0 = left channel
-	right = receiveWritable(1); // input 1 = right channel
+	//blocks[ch] = receiveReadOnly(ch);
+	for (ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+		blocks[ch] = receiveWritable(ch); // input 0 = left channel, 1 = right, ...
+#if defined(USB_AUDIO_F32)
+		fblocks[ch] = receiveReadOnly_f32(ch);
+#else
+		fblocks[ch] = NULL;
+#endif
+	}
 	if (usb_audio_transmit_setting == 0) {
-		if (left) release(left);
-		if (right) release(right);
+		for (ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+			if (blocks[ch]) release(blocks[ch]);
+			if (fblocks[ch]) release(fblocks[ch]);
+		}
 		//for (i = 0; i<USB_AUDIO_OUTPUT_BUFFERS; i++) {
-		//	left = out_ready_left[i];
-		//	if (left) { release(left); out_ready_left[i] = NULL; }
-		//	right = out_ready_right[i];
-		//	if (right) { release(right); out_ready_right[i] = NULL; }
+		//	release and clear out_ready[i][...]
 		//}
 		//out_buffer_counter = 0;
 		return;
 	}
-	if (left == NULL) {
-		left = allocate();
-		if (left == NULL) {
-			if (right) release(right);
-			return;
-		}
-		memset(left->data, 0, sizeof(left->data));
-	}
-	if (right == NULL) {
-		right = allocate();
-		if (right == NULL) {
-			release(left);
-			return;
+	for (ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+		if (blocks[ch] == NULL) {
+			blocks[ch] = allocate();
+			if (blocks[ch] == NULL) {
+				for (unsigned int i=0; i < USB_AUDIO_CHANNELS; i++) {
+					if (blocks[i]) release(blocks[i]);
+					if (fblocks[i]) release(fblocks[i]);
+				}
+				return;
+			}
+			memset(blocks[ch]->data, 0, sizeof(blocks[ch]->data));
 		}
-		memset(right->data, 0, sizeof(right->data));
 	}
 	__disable_irq();
-	if (out_ready_left[out_write_index] || out_ready_right[out_write_index]) {
+	if (out_ready[out_write_index][0]) {
 		// Buffer overrun - PC is consuming too slowly
-		release(left);
-		release(right);
+		for (ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+			release(blocks[ch]);
+			if (fblocks[ch]) release(fblocks[ch]);
+		}
 		usb_audio_out_overrun_count++;
 	} else {
 		// Store in ring buffer
-		out_ready_left[out_write_index] = left;
-		out_ready_right[out_write_index] = right;
+		for (ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+			out_ready[out_write_index][ch] = blocks[ch];
+			out_ready_f32[out_write_index][ch] = fblocks[ch];
+		}
 
 		out_buffer_counter += AUDIO_BLOCK_SAMPLES;
 		out_write_index++;
@@ -1078,7 +1561,8 @@ unsigned int usb_audio_transmit_callback(void)
 {
 
 	uint32_t avail, num, target, len=0;
-	audio_block_t *left, *right;
+	audio_block_t **blocks;
+	uint8_t *dst = (uint8_t *)usb_audio_transmit_buffer;
 
 #ifdef USB_AUDIO_48KHZ
 
@@ -1101,6 +1585,9 @@ unsigned int usb_audio_transmit_callback(void)
 		target = 45;
 	}
 #endif
+	// never more than the endpoint's wMaxPacketSize allows
+	uint32_t max_frames = (usb_high_speed ? AUDIO_TX_BUFSIZE : AUDIO_TX_SIZE) / USB_AUDIO_FRAME_SIZE;
+	if (target > max_frames) target = max_frames;
 
 
 #if 0
@@ -1133,12 +1620,11 @@ unsigned int usb_audio_transmit_callback(void)
 
 		num = target - len;
 
-		left = out_ready_left[out_read_index];
-		right = out_ready_right[out_read_index];
+		blocks = out_ready[out_read_index];
 
-		if (left == NULL || right == NULL) {
+		if (blocks[0] == NULL) {
 			// buffer underrun - PC is consuming too quickly
-			memset(usb_audio_transmit_buffer + len, 0, num * 4);
+			memset(dst + len * USB_AUDIO_FRAME_SIZE, 0, num * USB_AUDIO_FRAME_SIZE);
 			out_read_count = 0;
 			usb_audio_out_underrun_count++;
 			break;
@@ -1147,23 +1633,26 @@ unsigned int usb_audio_transmit_callback(void)
 		avail = AUDIO_BLOCK_SAMPLES - out_read_count;
 		if (num > avail) num = avail;
 
-		copy_from_buffers((uint32_t *)usb_audio_transmit_buffer + len,
-			left->data + out_read_count, right->data + out_read_count, num);
+		copy_from_blocks(dst + len * USB_AUDIO_FRAME_SIZE, blocks,
+			out_ready_f32[out_read_index], out_read_count, num);
 		len += num;
 		out_read_count += num;
 		out_buffer_counter -= num;
 		if (out_read_count >= AUDIO_BLOCK_SAMPLES) {
-			out_ready_left[out_read_index] = NULL;
-			out_ready_right[out_read_index] = NULL;
-			AudioStream::release(left);
-			AudioStream::release(right);
+			for (unsigned int ch=0; ch < USB_AUDIO_CHANNELS; ch++) {
+				AudioStream::release(blocks[ch]);
+				blocks[ch] = NULL;
+				audio_block_f32_t *f = out_ready_f32[out_read_index][ch];
+				if (f) AudioStream::release(f);
+				out_ready_f32[out_read_index][ch] = NULL;
+			}
 			out_read_count = 0;
 			out_read_index++;
 			if (out_read_index >= USB_AUDIO_OUTPUT_BUFFERS) out_read_index = 0;
 		}
 	}
 
-	return target * 4;
+	return target * USB_AUDIO_FRAME_SIZE;
 }
 
 
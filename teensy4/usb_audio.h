@@ -39,6 +39,25 @@
 #define USB_AUDIO_FEEDBACK_SOF
 //#define USB_AUDIO_FEEDBACK_DL1YCF
 
+// Resample received audio to the audio library's clock (requires
+// USB_AUDIO_FEEDBACK_SOF).  Use this when the audio library runs from
+// an external I2S master, or whenever feedback alone can't track the
+// host's clock without dropped or repeated blocks.
+//#define USB_AUDIO_ASRC
+
+#if defined(USB_AUDIO_ASRC) && !defined(USB_AUDIO_FEEDBACK_SOF)
+#error "USB_AUDIO_ASRC requires USB_AUDIO_FEEDBACK_SOF"
+#endif
+
+// 24 and 32 bit samples keep their full resolution in floating point
+// blocks.  AudioInputUSB transmits a 16 bit and a float block on each
+// output, and AudioOutputUSB has float inputs, which take priority over
+// the 16 bit input of the same channel.  Use AudioConnection_F32 and
+// AudioMemory_F32() for these.  Without float blocks, samples carry 16 bits.
+#if USB_AUDIO_SUBFRAME_SIZE > 2
+#define USB_AUDIO_F32
+#endif
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -85,6 +104,10 @@ public:
 		if (features.mute) return 0.0;
 		return (float)(features.volume) * (1.0 / (float)FEATURE_MAX_VOLUME);
 	}
+#if defined(USB_AUDIO_ASRC)
+	// Input samples consumed per output sample, near 1.0
+	static float resampleRatio(void);
+#endif
 
 private:
 
@@ -103,7 +126,12 @@ private:
 class AudioOutputUSB : public AudioStream
 {
 public:
-	AudioOutputUSB(void) : AudioStream(2, inputQueueArray) { begin(); }
+#if defined(USB_AUDIO_F32)
+	AudioOutputUSB(void) : AudioStream(USB_AUDIO_CHANNELS, inputQueueArray,
+		USB_AUDIO_CHANNELS, inputQueueArray_f32) { begin(); }
+#else
+	AudioOutputUSB(void) : AudioStream(USB_AUDIO_CHANNELS, inputQueueArray) { begin(); }
+#endif
 	virtual void update(void);
 	void begin(void);
 	friend unsigned int usb_audio_transmit_callback(void);
@@ -117,7 +145,10 @@ private:
 	static audio_block_t *right_2nd;
 	static uint16_t offset_1st;
 #endif
-	audio_block_t *inputQueueArray[2];
+	audio_block_t *inputQueueArray[USB_AUDIO_CHANNELS];
+#if defined(USB_AUDIO_F32)
+	audio_block_f32_t *inputQueueArray_f32[USB_AUDIO_CHANNELS];
+#endif
 };
 #endif // __cplusplus
 
@@ -480,10 +480,10 @@ static uint8_t rawhid_report_desc[] = {
         0x75, 0x08,                     //   report size = 8 bits
         0x15, 0x00,                     //   logical minimum = 0
         0x26, 0xFF, 0x00,               //   logical maximum = 255
-        0x95, RAWHID_TX_SIZE,           //   report count
+        0x96, LSB(RAWHID_TX_SIZE), MSB(RAWHID_TX_SIZE), //   report count
         0x09, 0x01,                     //   usage
         0x81, 0x02,                     //   Input (array)
-        0x95, RAWHID_RX_SIZE,           //   report count
+        0x96, LSB(RAWHID_RX_SIZE), MSB(RAWHID_RX_SIZE), //   report count
         0x09, 0x02,                     //   usage
         0x91, 0x02,                     //   Output (array)
         0xC0                            // end collection
@@ -591,6 +591,9 @@ static uint8_t microsoft_os_compatible_id_desc[] = {
 #ifdef  RAWHID_INTERFACE
 #define RAWHID_INTERFACE_DESC_SIZE	9+9+7+7
 #define RAWHID_HID_DESC_OFFSET		RAWHID_INTERFACE_DESC_POS+9
+// high bandwidth interrupt endpoints: wMaxPacketSize bits 12:11
+#define RAWHID_TX_MULT_BITS		((RAWHID_TX_MULT - 1) << 3)
+#define RAWHID_RX_MULT_BITS		((RAWHID_RX_MULT - 1) << 3)
 #else
 #define RAWHID_INTERFACE_DESC_SIZE	0
 #endif
@@ -626,7 +629,14 @@ static uint8_t microsoft_os_compatible_id_desc[] = {
 #define MTP_INTERFACE_DESC_SIZE	0
 #endif
 
-#define KEYMEDIA_INTERFACE_DESC_POS	MTP_INTERFACE_DESC_POS+MTP_INTERFACE_DESC_SIZE
+#define MSC_INTERFACE_DESC_POS		MTP_INTERFACE_DESC_POS+MTP_INTERFACE_DESC_SIZE
+#ifdef  MSC_INTERFACE
+#define MSC_INTERFACE_DESC_SIZE		9+7+7
+#else
+#define MSC_INTERFACE_DESC_SIZE	0
+#endif
+
+#define KEYMEDIA_INTERFACE_DESC_POS	MSC_INTERFACE_DESC_POS+MSC_INTERFACE_DESC_SIZE
 #ifdef  KEYMEDIA_INTERFACE
 #define KEYMEDIA_INTERFACE_DESC_SIZE	9+9+7
 #define KEYMEDIA_HID_DESC_OFFSET	KEYMEDIA_INTERFACE_DESC_POS+9
@@ -636,7 +646,22 @@ static uint8_t microsoft_os_compatible_id_desc[] = {
 
 #define AUDIO_INTERFACE_DESC_POS	KEYMEDIA_INTERFACE_DESC_POS+KEYMEDIA_INTERFACE_DESC_SIZE
 #ifdef  AUDIO_INTERFACE
-#define AUDIO_INTERFACE_DESC_SIZE	8 + 9+10+12+9+12+10+9 + 9+9+7+11+9+7 + 9+9+7+11+9+7+9
+#define AUDIO_FEATURE_DESC_SIZE		(8+USB_AUDIO_CHANNELS)
+#define AUDIO_INTERFACE_DESC_SIZE	8 + 9+10+12+9+12+AUDIO_FEATURE_DESC_SIZE+9 + 9+9+7+11+9+7 + 9+9+7+11+9+7+9
+// high bandwidth isochronous endpoints: wMaxPacketSize bits 12:11
+#define AUDIO_PACKET_MULT_BITS		((USB_AUDIO_PACKET_MULT - 1) << 3)
+// one volume control byte per channel in the feature unit
+#define AUDIO_FEATURE_CHANNEL_CONTROLS_1	0x02,
+#define AUDIO_FEATURE_CHANNEL_CONTROLS_2	AUDIO_FEATURE_CHANNEL_CONTROLS_1 0x02,
+#define AUDIO_FEATURE_CHANNEL_CONTROLS_3	AUDIO_FEATURE_CHANNEL_CONTROLS_2 0x02,
+#define AUDIO_FEATURE_CHANNEL_CONTROLS_4	AUDIO_FEATURE_CHANNEL_CONTROLS_3 0x02,
+#define AUDIO_FEATURE_CHANNEL_CONTROLS_5	AUDIO_FEATURE_CHANNEL_CONTROLS_4 0x02,
+#define AUDIO_FEATURE_CHANNEL_CONTROLS_6	AUDIO_FEATURE_CHANNEL_CONTROLS_5 0x02,
+#define AUDIO_FEATURE_CHANNEL_CONTROLS_7	AUDIO_FEATURE_CHANNEL_CONTROLS_6 0x02,
+#define AUDIO_FEATURE_CHANNEL_CONTROLS_8	AUDIO_FEATURE_CHANNEL_CONTROLS_7 0x02,
+#define AUDIO_FEATURE_CHANNEL_CONTROLS_N(n)	AUDIO_FEATURE_CHANNEL_CONTROLS_##n
+#define AUDIO_FEATURE_CHANNEL_CONTROLS_X(n)	AUDIO_FEATURE_CHANNEL_CONTROLS_N(n)
+#define AUDIO_FEATURE_CHANNEL_CONTROLS	AUDIO_FEATURE_CHANNEL_CONTROLS_X(USB_AUDIO_CHANNELS)
 #else
 #define AUDIO_INTERFACE_DESC_SIZE	0
 #endif
@@ -1222,14 +1247,14 @@ PROGMEM const uint8_t usb_config_descriptor_480[CONFIG_DESC_SIZE] = {
         5,                                      // bDescriptorType
         RAWHID_TX_ENDPOINT | 0x80,              // bEndpointAddress
         0x03,                                   // bmAttributes (0x03=intr)
-        RAWHID_TX_SIZE, 0,                      // wMaxPacketSize
+        LSB(RAWHID_TX_SIZE_480), MSB(RAWHID_TX_SIZE_480) | RAWHID_TX_MULT_BITS, // wMaxPacketSize
         RAWHID_TX_INTERVAL,                     // bInterval
         // endpoint descriptor, USB spec 9.6.6, page 269-271, Table 9-13
         7,                                      // bLength
         5,                                      // bDescriptorType
         RAWHID_RX_ENDPOINT,                     // bEndpointAddress
         0x03,                                   // bmAttributes (0x03=intr)
-        RAWHID_RX_SIZE, 0,                      // wMaxPacketSize
+        LSB(RAWHID_RX_SIZE_480), MSB(RAWHID_RX_SIZE_480) | RAWHID_RX_MULT_BITS, // wMaxPacketSize
         RAWHID_RX_INTERVAL,			// bInterval
 #endif // RAWHID_INTERFACE
 
@@ -1372,6 +1397,34 @@ PROGMEM const uint8_t usb_config_descriptor_480[CONFIG_DESC_SIZE] = {
         MTP_EVENT_INTERVAL_480,                 // bInterval
 #endif // MTP_INTERFACE
 
+#ifdef MSC_INTERFACE
+	// configuration for 480 Mbit/sec speed
+        // interface descriptor, USB spec 9.6.5, page 267-269, Table 9-12
+        9,                                      // bLength
+        4,                                      // bDescriptorType
+        MSC_INTERFACE,                          // bInterfaceNumber
+        0,                                      // bAlternateSetting
+        2,                                      // bNumEndpoints
+        0x08,                                   // bInterfaceClass (0x08 = Mass Storage)
+        0x06,                                   // bInterfaceSubClass (0x06 = SCSI)
+        0x50,                                   // bInterfaceProtocol (0x50 = Bulk-Only)
+        0,                                      // iInterface
+        // endpoint descriptor, USB spec 9.6.6, page 269-271, Table 9-13
+        7,                                      // bLength
+        5,                                      // bDescriptorType
+        MSC_TX_ENDPOINT | 0x80,                 // bEndpointAddress
+        0x02,                                   // bmAttributes (0x02=bulk)
+        LSB(MSC_TX_SIZE_480),MSB(MSC_TX_SIZE_480),// wMaxPacketSize
+        0,                                      // bInterval
+        // endpoint descriptor, USB spec 9.6.6, page 269-271, Table 9-13
+        7,                                      // bLength
+        5,                                      // bDescriptorType
+        MSC_RX_ENDPOINT,                        // bEndpointAddress
+        0x02,                                   // bmAttributes (0x02=bulk)
+        LSB(MSC_RX_SIZE_480),MSB(MSC_RX_SIZE_480),// wMaxPacketSize
+        0,                                      // bInterval
+#endif // MSC_INTERFACE
+
 #ifdef KEYMEDIA_INTERFACE
 	// configuration for 480 Mbit/sec speed
         // interface descriptor, USB spec 9.6.5, page 267-269, Table 9-12
@@ -1430,7 +1483,7 @@ PROGMEM const uint8_t usb_config_descriptor_480[CONFIG_DESC_SIZE] = {
 	0x24,					// bDescriptorType, 0x24 = CS_INTERFACE
 	0x01,					// bDescriptorSubtype, 1 = HEADER
 	0x00, 0x01,				// bcdADC (version 1.0)
-	LSB(62), MSB(62),			// wTotalLength
+	LSB(52+AUDIO_FEATURE_DESC_SIZE), MSB(52+AUDIO_FEATURE_DESC_SIZE), // wTotalLength
 	2,					// bInCollection
 	AUDIO_INTERFACE+1,			// baInterfaceNr(1) - Transmit to PC
 	AUDIO_INTERFACE+2,			// baInterfaceNr(2) - Receive from PC
@@ -1444,8 +1497,8 @@ PROGMEM const uint8_t usb_config_descriptor_480[CONFIG_DESC_SIZE] = {
 	//0x03, 0x06,				// wTerminalType, 0x0603 = Line Connector
 	0x02, 0x06,				// wTerminalType, 0x0602 = Digital Audio
 	0,					// bAssocTerminal, 0 = unidirectional
-	2,					// bNrChannels
-	0x03, 0x00,				// wChannelConfig, 0x0003 = Left & Right Front
+	USB_AUDIO_CHANNELS,			// bNrChannels
+	LSB(USB_AUDIO_CHANNEL_CONFIG), MSB(USB_AUDIO_CHANNEL_CONFIG), // wChannelConfig
 	0,					// iChannelNames
 	0, 					// iTerminal
 	// Output Terminal Descriptor
@@ -1466,20 +1519,19 @@ PROGMEM const uint8_t usb_config_descriptor_480[CONFIG_DESC_SIZE] = {
 	3,					// bTerminalID
 	0x01, 0x01,				// wTerminalType, 0x0101 = USB_STREAMING
 	0,					// bAssocTerminal, 0 = unidirectional
-	2,					// bNrChannels
-	0x03, 0x00,				// wChannelConfig, 0x0003 = Left & Right Front
+	USB_AUDIO_CHANNELS,			// bNrChannels
+	LSB(USB_AUDIO_CHANNEL_CONFIG), MSB(USB_AUDIO_CHANNEL_CONFIG), // wChannelConfig
 	0,					// iChannelNames
 	0, 					// iTerminal
 	// Volume feature descriptor
-	10,					// bLength
+	AUDIO_FEATURE_DESC_SIZE,		// bLength
 	0x24, 				// bDescriptorType = CS_INTERFACE
 	0x06, 				// bDescriptorSubType = FEATURE_UNIT
 	0x31, 				// bUnitID
 	0x03, 				// bSourceID (Input Terminal)
-	0x01, 				// bControlSize (each channel is 1 byte, 3 channels)
+	0x01, 				// bControlSize (each channel is 1 byte)
 	0x01, 				// bmaControls(0) Master: Mute
-	0x02, 				// bmaControls(1) Left: Volume
-	0x02, 				// bmaControls(2) Right: Volume
+	AUDIO_FEATURE_CHANNEL_CONTROLS		// bmaControls(1..n) Volume
 	0x00,				// iFeature
 	// Output Terminal Descriptor
 	// USB DCD for Audio Devices 1.0, Table 4-4, page 40
@@ -1528,9 +1580,9 @@ PROGMEM const uint8_t usb_config_descriptor_480[CONFIG_DESC_SIZE] = {
 	0x24,					// bDescriptorType = CS_INTERFACE
 	2,					// bDescriptorSubtype = FORMAT_TYPE
 	1,					// bFormatType = FORMAT_TYPE_I
-	2,					// bNrChannels = 2
-	2,					// bSubFrameSize = 2 byte
-	16,					// bBitResolution = 16 bits
+	USB_AUDIO_CHANNELS,			// bNrChannels
+	USB_AUDIO_SUBFRAME_SIZE,		// bSubFrameSize
+	USB_AUDIO_SUBFRAME_SIZE * 8,		// bBitResolution
 	1,					// bSamFreqType = 1 frequency
 #ifdef USB_AUDIO_48KHZ
 	LSB(48000), MSB(48000), 0,
@@ -1543,7 +1595,7 @@ PROGMEM const uint8_t usb_config_descriptor_480[CONFIG_DESC_SIZE] = {
 	5, 					// bDescriptorType, 5 = ENDPOINT_DESCRIPTOR
 	AUDIO_TX_ENDPOINT | 0x80,		// bEndpointAddress
 	0x09, 					// bmAttributes = isochronous, adaptive
-	LSB(AUDIO_TX_SIZE), MSB(AUDIO_TX_SIZE),	// wMaxPacketSize
+	LSB(AUDIO_TX_SIZE), MSB(AUDIO_TX_SIZE) | AUDIO_PACKET_MULT_BITS, // wMaxPacketSize
 	4,			 		// bInterval, 4 = every 8 micro-frames
 	0,					// bRefresh
 	0,					// bSynchAddress
@@ -1591,9 +1643,9 @@ PROGMEM const uint8_t usb_config_descriptor_480[CONFIG_DESC_SIZE] = {
 	0x24,					// bDescriptorType = CS_INTERFACE
 	2,					// bDescriptorSubtype = FORMAT_TYPE
 	1,					// bFormatType = FORMAT_TYPE_I
-	2,					// bNrChannels = 2
-	2,					// bSubFrameSize = 2 byte
-	16,					// bBitResolution = 16 bits
+	USB_AUDIO_CHANNELS,			// bNrChannels
+	USB_AUDIO_SUBFRAME_SIZE,		// bSubFrameSize
+	USB_AUDIO_SUBFRAME_SIZE * 8,		// bBitResolution
 	1,					// bSamFreqType = 1 frequency
 #ifdef USB_AUDIO_48KHZ
     LSB(48000), MSB(48000), 0,
@@ -1606,7 +1658,7 @@ PROGMEM const uint8_t usb_config_descriptor_480[CONFIG_DESC_SIZE] = {
 	5, 					// bDescriptorType, 5 = ENDPOINT_DESCRIPTOR
 	AUDIO_RX_ENDPOINT,			// bEndpointAddress
 	0x05, 					// bmAttributes = isochronous, asynchronous
-	LSB(AUDIO_RX_SIZE), MSB(AUDIO_RX_SIZE),	// wMaxPacketSize
+	LSB(AUDIO_RX_SIZE), MSB(AUDIO_RX_SIZE) | AUDIO_PACKET_MULT_BITS, // wMaxPacketSize
 	// USB_AUDIO_48KHZ Change below to receive audio packets every 125us instead of 1ms
 	4,			 		// bInterval, 4 = every 8 micro-frames
 	0,					// bRefresh
@@ -2245,14 +2297,14 @@ PROGMEM const uint8_t usb_config_descriptor_12[CONFIG_DESC_SIZE] = {
         5,                                      // bDescriptorType
         RAWHID_TX_ENDPOINT | 0x80,              // bEndpointAddress
         0x03,                                   // bmAttributes (0x03=intr)
-        RAWHID_TX_SIZE, 0,                      // wMaxPacketSize
+        RAWHID_TX_SIZE_12, 0,                   // wMaxPacketSize
         RAWHID_TX_INTERVAL,                     // bInterval
         // endpoint descriptor, USB spec 9.6.6, page 269-271, Table 9-13
         7,                                      // bLength
         5,                                      // bDescriptorType
         RAWHID_RX_ENDPOINT,                     // bEndpointAddress
         0x03,                                   // bmAttributes (0x03=intr)
-        RAWHID_RX_SIZE, 0,                      // wMaxPacketSize
+        RAWHID_RX_SIZE_12, 0,                   // wMaxPacketSize
         RAWHID_RX_INTERVAL,			// bInterval
 #endif // RAWHID_INTERFACE
 
@@ -2395,6 +2447,34 @@ PROGMEM const uint8_t usb_config_descriptor_12[CONFIG_DESC_SIZE] = {
         MTP_EVENT_INTERVAL_12,                  // bInterval
 #endif // MTP_INTERFACE
 
+#ifdef MSC_INTERFACE
+	// configuration for 12 Mbit/sec speed
+        // interface descriptor, USB spec 9.6.5, page 267-269, Table 9-12
+        9,                                      // bLength
+        4,                                      // bDescriptorType
+        MSC_INTERFACE,                          // bInterfaceNumber
+        0,                                      // bAlternateSetting
+        2,                                      // bNumEndpoints
+        0x08,                                   // bInterfaceClass (0x08 = Mass Storage)
+        0x06,                                   // bInterfaceSubClass (0x06 = SCSI)
+        0x50,                                   // bInterfaceProtocol (0x50 = Bulk-Only)
+        0,                                      // iInterface
+        // endpoint descriptor, USB spec 9.6.6, page 269-271, Table 9-13
+        7,                                      // bLength
+        5,                                      // bDescriptorType
+        MSC_TX_ENDPOINT | 0x80,                 // bEndpointAddress
+        0x02,                                   // bmAttributes (0x02=bulk)
+        LSB(MSC_TX_SIZE_12),MSB(MSC_TX_SIZE_12),// wMaxPacketSize
+        0,                                      // bInterval
+        // endpoint descriptor, USB spec 9.6.6, page 269-271, Table 9-13
+        7,                                      // bLength
+        5,                                      // bDescriptorType
+        MSC_RX_ENDPOINT,                        // bEndpointAddress
+        0x02,                                   // bmAttributes (0x02=bulk)
+        LSB(MSC_RX_SIZE_12),MSB(MSC_RX_SIZE_12),// wMaxPacketSize
+        0,                                      // bInterval
+#endif // MSC_INTERFACE
+
 #ifdef KEYMEDIA_INTERFACE
 	// configuration for 12 Mbit/sec speed
         // interface descriptor, USB spec 9.6.5, page 267-269, Table 9-12
@@ -2453,7 +2533,7 @@ PROGMEM const uint8_t usb_config_descriptor_12[CONFIG_DESC_SIZE] = {
 	0x24,					// bDescriptorType, 0x24 = CS_INTERFACE
 	0x01,					// bDescriptorSubtype, 1 = HEADER
 	0x00, 0x01,				// bcdADC (version 1.0)
-	LSB(62), MSB(62),			// wTotalLength
+	LSB(52+AUDIO_FEATURE_DESC_SIZE), MSB(52+AUDIO_FEATURE_DESC_SIZE), // wTotalLength
 	2,					// bInCollection
 	AUDIO_INTERFACE+1,			// baInterfaceNr(1) - Transmit to PC
 	AUDIO_INTERFACE+2,			// baInterfaceNr(2) - Receive from PC
@@ -2467,8 +2547,8 @@ PROGMEM const uint8_t usb_config_descriptor_12[CONFIG_DESC_SIZE] = {
 	//0x03, 0x06,				// wTerminalType, 0x0603 = Line Connector
 	0x02, 0x06,				// wTerminalType, 0x0602 = Digital Audio
 	0,					// bAssocTerminal, 0 = unidirectional
-	2,					// bNrChannels
-	0x03, 0x00,				// wChannelConfig, 0x0003 = Left & Right Front
+	USB_AUDIO_CHANNELS,			// bNrChannels
+	LSB(USB_AUDIO_CHANNEL_CONFIG), MSB(USB_AUDIO_CHANNEL_CONFIG), // wChannelConfig
 	0,					// iChannelNames
 	0, 					// iTerminal
 	// Output Terminal Descriptor
@@ -2489,20 +2569,19 @@ PROGMEM const uint8_t usb_config_descriptor_12[CONFIG_DESC_SIZE] = {
 	3,					// bTerminalID
 	0x01, 0x01,				// wTerminalType, 0x0101 = USB_STREAMING
 	0,					// bAssocTerminal, 0 = unidirectional
-	2,					// bNrChannels
-	0x03, 0x00,				// wChannelConfig, 0x0003 = Left & Right Front
+	USB_AUDIO_CHANNELS,			// bNrChannels
+	LSB(USB_AUDIO_CHANNEL_CONFIG), MSB(USB_AUDIO_CHANNEL_CONFIG), // wChannelConfig
 	0,					// iChannelNames
 	0, 					// iTerminal
 	// Volume feature descriptor
-	10,					// bLength
+	AUDIO_FEATURE_DESC_SIZE,		// bLength
 	0x24, 				// bDescriptorType = CS_INTERFACE
 	0x06, 				// bDescriptorSubType = FEATURE_UNIT
 	0x31, 				// bUnitID
 	0x03, 				// bSourceID (Input Terminal)
-	0x01, 				// bControlSize (each channel is 1 byte, 3 channels)
+	0x01, 				// bControlSize (each channel is 1 byte)
 	0x01, 				// bmaControls(0) Master: Mute
-	0x02, 				// bmaControls(1) Left: Volume
-	0x02, 				// bmaControls(2) Right: Volume
+	AUDIO_FEATURE_CHANNEL_CONTROLS		// bmaControls(1..n) Volume
 	0x00,				// iFeature
 	// Output Terminal Descriptor
 	// USB DCD for Audio Devices 1.0, Table 4-4, page 40
@@ -2551,9 +2630,9 @@ PROGMEM const uint8_t usb_config_descriptor_12[CONFIG_DESC_SIZE] = {
 	0x24,					// bDescriptorType = CS_INTERFACE
 	2,					// bDescriptorSubtype = FORMAT_TYPE
 	1,					// bFormatType = FORMAT_TYPE_I
-	2,					// bNrChannels = 2
-	2,					// bSubFrameSize = 2 byte
-	16,					// bBitResolution = 16 bits
+	USB_AUDIO_CHANNELS,			// bNrChannels
+	USB_AUDIO_SUBFRAME_SIZE,		// bSubFrameSize
+	USB_AUDIO_SUBFRAME_SIZE * 8,		// bBitResolution
 	1,					// bSamFreqType = 1 frequency
 	LSB(44100), MSB(44100), 0,		// tSamFreq
 	// Standard AS Isochronous Audio Data Endpoint Descriptor
@@ -2562,7 +2641,7 @@ PROGMEM const uint8_t usb_config_descriptor_12[CONFIG_DESC_SIZE] = {
 	5, 					// bDescriptorType, 5 = ENDPOINT_DESCRIPTOR
 	AUDIO_TX_ENDPOINT | 0x80,		// bEndpointAddress
 	0x09, 					// bmAttributes = isochronous, adaptive
-	LSB(AUDIO_TX_SIZE), MSB(AUDIO_TX_SIZE),	// wMaxPacketSize
+	LSB(AUDIO_TX_SIZE), MSB(AUDIO_TX_SIZE), // wMaxPacketSize (no high bandwidth at 12 Mbit)
 	1,			 		// bInterval, 1 = every frame
 	0,					// bRefresh
 	0,					// bSynchAddress
@@ -2610,9 +2689,9 @@ PROGMEM const uint8_t usb_config_descriptor_12[CONFIG_DESC_SIZE] = {
 	0x24,					// bDescriptorType = CS_INTERFACE
 	2,					// bDescriptorSubtype = FORMAT_TYPE
 	1,					// bFormatType = FORMAT_TYPE_I
-	2,					// bNrChannels = 2
-	2,					// bSubFrameSize = 2 byte
-	16,					// bBitResolution = 16 bits
+	USB_AUDIO_CHANNELS,			// bNrChannels
+	USB_AUDIO_SUBFRAME_SIZE,		// bSubFrameSize
+	USB_AUDIO_SUBFRAME_SIZE * 8,		// bBitResolution
 	1,					// bSamFreqType = 1 frequency
 	LSB(44100), MSB(44100), 0,		// tSamFreq
 	// Standard AS Isochronous Audio Data Endpoint Descriptor
@@ -2621,7 +2700,7 @@ PROGMEM const uint8_t usb_config_descriptor_12[CONFIG_DESC_SIZE] = {
 	5, 					// bDescriptorType, 5 = ENDPOINT_DESCRIPTOR
 	AUDIO_RX_ENDPOINT,			// bEndpointAddress
 	0x05, 					// bmAttributes = isochronous, asynchronous
-	LSB(AUDIO_RX_SIZE), MSB(AUDIO_RX_SIZE),	// wMaxPacketSize
+	LSB(AUDIO_RX_SIZE), MSB(AUDIO_RX_SIZE), // wMaxPacketSize (no high bandwidth at 12 Mbit)
 	1,			 		// bInterval, 1 = every frame
 	0,					// bRefresh
 	AUDIO_SYNC_ENDPOINT | 0x80,		// bSynchAddress
@@ -112,6 +112,68 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
 
 #define USB_AUDIO_48KHZ 1
 
+// USB audio stream format, used by all USB types with audio.  The number
+// of channels (1 to 8, must be a plain number) applies to both directions.
+// Subframe size is the bytes per sample: 2 = 16 bit, 3 = 24 bit, 4 = 32 bit.
+// AudioInputUSB and AudioOutputUSB have one audio library port per channel.
+// Formats needing more than 1024 bytes per millisecond use high bandwidth
+// isochronous endpoints, which only work at 480 Mbit/sec speed.
+#ifndef USB_AUDIO_CHANNELS
+#define USB_AUDIO_CHANNELS 2
+#endif
+#ifndef USB_AUDIO_SUBFRAME_SIZE
+#define USB_AUDIO_SUBFRAME_SIZE 2
+#endif
+#ifndef USB_AUDIO_CHANNEL_CONFIG
+#if USB_AUDIO_CHANNELS == 2
+#define USB_AUDIO_CHANNEL_CONFIG 0x0003 // Left & Right Front
+#else
+#define USB_AUDIO_CHANNEL_CONFIG 0x0000 // no spatial location
+#endif
+#endif
+#if USB_AUDIO_CHANNELS < 1 || USB_AUDIO_CHANNELS > 8
+#error "USB_AUDIO_CHANNELS must be 1 to 8"
+#endif
+#if USB_AUDIO_SUBFRAME_SIZE < 2 || USB_AUDIO_SUBFRAME_SIZE > 4
+#error "USB_AUDIO_SUBFRAME_SIZE must be 2, 3 or 4"
+#endif
+#define USB_AUDIO_FRAME_SIZE  (USB_AUDIO_CHANNELS * USB_AUDIO_SUBFRAME_SIZE)
+#ifdef USB_AUDIO_48KHZ
+#define USB_AUDIO_PACKET_SIZE (49 * USB_AUDIO_FRAME_SIZE) // max bytes per ms
+#else
+#define USB_AUDIO_PACKET_SIZE (45 * USB_AUDIO_FRAME_SIZE)
+#endif
+// Full speed isochronous endpoints are limited to 1023 bytes per frame.
+// Larger formats can only be used if the Teensy always runs at 480 Mbit,
+// and then audio is not streamed when connected at 12 Mbit.
+#if USB_AUDIO_PACKET_SIZE > 1023 && !defined(USB_AUDIO_HIGH_SPEED_ONLY)
+#error "USB audio format needs more than 1023 bytes/ms, too much for 12 Mbit. Use fewer channels or a smaller USB_AUDIO_SUBFRAME_SIZE, or define USB_AUDIO_HIGH_SPEED_ONLY"
+#endif
+#define USB_AUDIO_PACKET_MULT ((USB_AUDIO_PACKET_SIZE + 1023) / 1024)
+#define USB_AUDIO_TRANSACTION_SIZE ((USB_AUDIO_PACKET_SIZE + USB_AUDIO_PACKET_MULT - 1) / USB_AUDIO_PACKET_MULT)
+
+// RawHID report sizes, used by all USB types with RawHID.  Each report is
+// one transfer.  At 480 Mbit/sec speed reports up to 1024 bytes are a single
+// packet and larger reports (up to 3072) use high bandwidth interrupt
+// endpoints, 2 or 3 packets per microframe.  At 12 Mbit/sec speed, reports
+// larger than 64 bytes take several packets.  The host software must use
+// the same report sizes.
+#ifndef USB_RAWHID_TX_SIZE
+#define USB_RAWHID_TX_SIZE 64
+#endif
+#ifndef USB_RAWHID_RX_SIZE
+#define USB_RAWHID_RX_SIZE 64
+#endif
+#if USB_RAWHID_TX_SIZE < 1 || USB_RAWHID_TX_SIZE > 3072 || USB_RAWHID_RX_SIZE < 1 || USB_RAWHID_RX_SIZE > 3072
+#error "USB_RAWHID_TX_SIZE and USB_RAWHID_RX_SIZE must be 1 to 3072"
+#endif
+#define USB_RAWHID_TX_MULT ((USB_RAWHID_TX_SIZE + 1023) / 1024)
+#define USB_RAWHID_RX_MULT ((USB_RAWHID_RX_SIZE + 1023) / 1024)
+#define USB_RAWHID_TX_SIZE_480 ((USB_RAWHID_TX_SIZE + USB_RAWHID_TX_MULT - 1) / USB_RAWHID_TX_MULT)
+#define USB_RAWHID_RX_SIZE_480 ((USB_RAWHID_RX_SIZE + USB_RAWHID_RX_MULT - 1) / USB_RAWHID_RX_MULT)
+#define USB_RAWHID_TX_SIZE_12 (USB_RAWHID_TX_SIZE < 64 ? USB_RAWHID_TX_SIZE : 64)
+#define USB_RAWHID_RX_SIZE_12 (USB_RAWHID_RX_SIZE < 64 ? USB_RAWHID_RX_SIZE : 64)
+
 #if defined(USB_SERIAL)
   #define VENDOR_ID		0x16C0
   #define PRODUCT_ID		0x0483
@@ -599,10 +661,16 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define NUM_INTERFACE		2
   #define RAWHID_INTERFACE      0	// RawHID
   #define RAWHID_TX_ENDPOINT    3
-  #define RAWHID_TX_SIZE        64
+  #define RAWHID_TX_SIZE        USB_RAWHID_TX_SIZE
+  #define RAWHID_TX_SIZE_12     USB_RAWHID_TX_SIZE_12
+  #define RAWHID_TX_SIZE_480    USB_RAWHID_TX_SIZE_480
+  #define RAWHID_TX_MULT        USB_RAWHID_TX_MULT
   #define RAWHID_TX_INTERVAL    1	 // TODO: is this ok for 480 Mbit speed
   #define RAWHID_RX_ENDPOINT    4
-  #define RAWHID_RX_SIZE        64
+  #define RAWHID_RX_SIZE        USB_RAWHID_RX_SIZE
+  #define RAWHID_RX_SIZE_12     USB_RAWHID_RX_SIZE_12
+  #define RAWHID_RX_SIZE_480    USB_RAWHID_RX_SIZE_480
+  #define RAWHID_RX_MULT        USB_RAWHID_RX_MULT
   #define RAWHID_RX_INTERVAL    1	 // TODO: is this ok for 480 Mbit speed
   #define SEREMU_INTERFACE      1	// Serial emulation
   #define SEREMU_TX_ENDPOINT    2
@@ -744,6 +812,65 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define ENDPOINT4_CONFIG	ENDPOINT_RECEIVE_BULK + ENDPOINT_TRANSMIT_BULK
   #define ENDPOINT5_CONFIG	ENDPOINT_RECEIVE_UNUSED + ENDPOINT_TRANSMIT_INTERRUPT
 
+#elif defined(USB_MSC)
+  #define VENDOR_ID		0x16C0
+  #define PRODUCT_ID		0x04D6
+  #define MANUFACTURER_NAME	{'T','e','e','n','s','y','d','u','i','n','o'}
+  #define MANUFACTURER_NAME_LEN	11
+  #define PRODUCT_NAME		{'T','e','e','n','s','y',' ','D','i','s','k'}
+  #define PRODUCT_NAME_LEN	11
+  #define EP0_SIZE		64
+  #define NUM_ENDPOINTS         3
+  #define NUM_INTERFACE		2
+  #define SEREMU_INTERFACE      0	// Serial emulation
+  #define SEREMU_TX_ENDPOINT    2
+  #define SEREMU_TX_SIZE        64
+  #define SEREMU_TX_INTERVAL    1
+  #define SEREMU_RX_ENDPOINT    2
+  #define SEREMU_RX_SIZE        32
+  #define SEREMU_RX_INTERVAL    2
+  #define MSC_INTERFACE		1	// Mass Storage
+  #define MSC_TX_ENDPOINT	3
+  #define MSC_TX_SIZE_12	64
+  #define MSC_TX_SIZE_480	512
+  #define MSC_RX_ENDPOINT	3
+  #define MSC_RX_SIZE_12	64
+  #define MSC_RX_SIZE_480	512
+  #define ENDPOINT2_CONFIG	ENDPOINT_RECEIVE_INTERRUPT + ENDPOINT_TRANSMIT_INTERRUPT
+  #define ENDPOINT3_CONFIG	ENDPOINT_RECEIVE_BULK + ENDPOINT_TRANSMIT_BULK
+
+#elif defined(USB_MSC_SERIAL)
+  #define VENDOR_ID		0x16C0
+  #define PRODUCT_ID		0x04D7
+  #define MANUFACTURER_NAME	{'T','e','e','n','s','y','d','u','i','n','o'}
+  #define MANUFACTURER_NAME_LEN	11
+  #define PRODUCT_NAME		{'T','e','e','n','s','y',' ','D','i','s','k'}
+  #define PRODUCT_NAME_LEN	11
+  #define EP0_SIZE		64
+  #define NUM_ENDPOINTS         4
+  #define NUM_INTERFACE		3
+  #define CDC_IAD_DESCRIPTOR	1
+  #define CDC_STATUS_INTERFACE	0
+  #define CDC_DATA_INTERFACE	1	// Serial
+  #define CDC_ACM_ENDPOINT	2
+  #define CDC_RX_ENDPOINT       3
+  #define CDC_TX_ENDPOINT       3
+  #define CDC_ACM_SIZE          16
+  #define CDC_RX_SIZE_480       512
+  #define CDC_TX_SIZE_480       512
+  #define CDC_RX_SIZE_12        64
+  #define CDC_TX_SIZE_12        64
+  #define MSC_INTERFACE		2	// Mass Storage
+  #define MSC_TX_ENDPOINT	4
+  #define MSC_TX_SIZE_12	64
+  #define MSC_TX_SIZE_480	512
+  #define MSC_RX_ENDPOINT	4
+  #define MSC_RX_SIZE_12	64
+  #define MSC_RX_SIZE_480	512
+  #define ENDPOINT2_CONFIG	ENDPOINT_RECEIVE_UNUSED + ENDPOINT_TRANSMIT_INTERRUPT
+  #define ENDPOINT3_CONFIG	ENDPOINT_RECEIVE_BULK + ENDPOINT_TRANSMIT_BULK
+  #define ENDPOINT4_CONFIG	ENDPOINT_RECEIVE_BULK + ENDPOINT_TRANSMIT_BULK
+
 #elif defined(USB_AUDIO)
   #define VENDOR_ID		0x16C0
   #define PRODUCT_ID		0x04D2
@@ -763,13 +890,8 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define SEREMU_RX_INTERVAL    2
   #define AUDIO_INTERFACE	1	// Audio (uses 3 consecutive interfaces)
   #define AUDIO_TX_ENDPOINT     3
-#ifdef USB_AUDIO_48KHZ
-  #define AUDIO_TX_SIZE         196
-  #define AUDIO_RX_SIZE         196
-#else
-  #define AUDIO_TX_SIZE         180
-  #define AUDIO_RX_SIZE         180
-#endif
+  #define AUDIO_TX_SIZE         USB_AUDIO_TRANSACTION_SIZE
+  #define AUDIO_RX_SIZE         USB_AUDIO_TRANSACTION_SIZE
   #define AUDIO_RX_ENDPOINT     3
   #define AUDIO_SYNC_ENDPOINT	4
   #define ENDPOINT2_CONFIG	ENDPOINT_RECEIVE_INTERRUPT + ENDPOINT_TRANSMIT_INTERRUPT
@@ -807,13 +929,8 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define MIDI_RX_SIZE_480      512
   #define AUDIO_INTERFACE	3	// Audio (uses 3 consecutive interfaces)
   #define AUDIO_TX_ENDPOINT     5
-#ifdef USB_AUDIO_48KHZ
-  #define AUDIO_TX_SIZE         196
-  #define AUDIO_RX_SIZE         196
-#else
-  #define AUDIO_TX_SIZE         180
-  #define AUDIO_RX_SIZE         180
-#endif
+  #define AUDIO_TX_SIZE         USB_AUDIO_TRANSACTION_SIZE
+  #define AUDIO_RX_SIZE         USB_AUDIO_TRANSACTION_SIZE
   #define AUDIO_RX_ENDPOINT     5
   #define AUDIO_SYNC_ENDPOINT	6
   #define ENDPOINT2_CONFIG	ENDPOINT_RECEIVE_UNUSED + ENDPOINT_TRANSMIT_INTERRUPT
@@ -854,13 +971,8 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define MIDI_RX_SIZE_480      512
   #define AUDIO_INTERFACE	3	// Audio (uses 3 consecutive interfaces)
   #define AUDIO_TX_ENDPOINT     5
-#ifdef USB_AUDIO_48KHZ
-  #define AUDIO_TX_SIZE         196
-  #define AUDIO_RX_SIZE         196
-#else
-  #define AUDIO_TX_SIZE         180
-  #define AUDIO_RX_SIZE         180
-#endif
+  #define AUDIO_TX_SIZE         USB_AUDIO_TRANSACTION_SIZE
+  #define AUDIO_RX_SIZE         USB_AUDIO_TRANSACTION_SIZE
   #define AUDIO_RX_ENDPOINT     5
   #define AUDIO_SYNC_ENDPOINT	6
   #define ENDPOINT2_CONFIG	ENDPOINT_RECEIVE_UNUSED + ENDPOINT_TRANSMIT_INTERRUPT
@@ -909,10 +1021,16 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define MOUSE_INTERVAL        2
   #define RAWHID_INTERFACE      5	// RawHID
   #define RAWHID_TX_ENDPOINT    6
-  #define RAWHID_TX_SIZE        64
+  #define RAWHID_TX_SIZE        USB_RAWHID_TX_SIZE
+  #define RAWHID_TX_SIZE_12     USB_RAWHID_TX_SIZE_12
+  #define RAWHID_TX_SIZE_480    USB_RAWHID_TX_SIZE_480
+  #define RAWHID_TX_MULT        USB_RAWHID_TX_MULT
   #define RAWHID_TX_INTERVAL    1
   #define RAWHID_RX_ENDPOINT    6
-  #define RAWHID_RX_SIZE        64
+  #define RAWHID_RX_SIZE        USB_RAWHID_RX_SIZE
+  #define RAWHID_RX_SIZE_12     USB_RAWHID_RX_SIZE_12
+  #define RAWHID_RX_SIZE_480    USB_RAWHID_RX_SIZE_480
+  #define RAWHID_RX_MULT        USB_RAWHID_RX_MULT
   #define RAWHID_RX_INTERVAL    1
   #define FLIGHTSIM_INTERFACE	6	// Flight Sim Control
   #define FLIGHTSIM_TX_ENDPOINT	9
@@ -941,13 +1059,8 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define KEYMEDIA_INTERVAL     4
   #define AUDIO_INTERFACE	9	// Audio (uses 3 consecutive interfaces)
   #define AUDIO_TX_ENDPOINT     13
-#ifdef USB_AUDIO_48KHZ
-  #define AUDIO_TX_SIZE         196
-  #define AUDIO_RX_SIZE         196
-#else
-  #define AUDIO_TX_SIZE         180
-  #define AUDIO_RX_SIZE         180
-#endif
+  #define AUDIO_TX_SIZE         USB_AUDIO_TRANSACTION_SIZE
+  #define AUDIO_RX_SIZE         USB_AUDIO_TRANSACTION_SIZE
   #define AUDIO_RX_ENDPOINT     13
   #define AUDIO_SYNC_ENDPOINT	14
   #define MULTITOUCH_INTERFACE  12	// Touchscreen
@@ -31,6 +31,8 @@ void usb_prepare_transfer(transfer_t *transfer, const void *data, uint32_t len,
 void usb_transmit(int endpoint_number, transfer_t *transfer);
 void usb_receive(int endpoint_number, transfer_t *transfer);
 uint32_t usb_transfer_status(const transfer_t *transfer);
+void usb_stall(int endpoint_number, int tx);
+int usb_stalled(int endpoint_number, int tx);
 
 void usb_start_sof_interrupts(int interface);
 void usb_stop_sof_interrupts(int interface);
@@ -36,6 +36,7 @@ extern "C" {
 #include "avr/pgmspace.h"
 #include "core_pins.h" // for yield(), millis()
 #include <string.h>    // for memcpy()
+#include <stdlib.h>    // for realloc()
 
 #ifdef FLIGHTSIM_INTERFACE // defined by usb_dev.h -> usb_desc.h
 #if F_CPU >= 20000000
@@ -60,7 +61,46 @@ elapsedMillis FlightSimClass::enableTimeout;
 
 static unsigned int unassigned_id = 1;  // TODO: move into FlightSimClass
 
+// Incoming updates are looked up by id in this table, rather than walking
+// the linked lists.  Ids are assigned sequentially from unassigned_id, so
+// the table is dense.  If memory for the table runs out, find() falls
+// back to searching the lists.
+struct flightsim_index_entry {
+	void *object;
+	uint8_t type;  // same as identify() type: 1=int, 2=float, 3=event, 4=data
+};
+static struct flightsim_index_entry *id_index = NULL;
+static unsigned int id_index_size = 0;
+static bool id_index_incomplete = false;
+
+static void id_index_add(unsigned int id, void *object, uint8_t type)
+{
+	if (id >= id_index_size) {
+		unsigned int size = id_index_size ? id_index_size * 2 : 64;
+		while (size <= id) size *= 2;
+		struct flightsim_index_entry *table = (struct flightsim_index_entry *)
+			realloc(id_index, size * sizeof(struct flightsim_index_entry));
+		if (!table) {
+			id_index_incomplete = true;
+			return;
+		}
+		memset(table + id_index_size, 0,
+			(size - id_index_size) * sizeof(struct flightsim_index_entry));
+		id_index = table;
+		id_index_size = size;
+	}
+	id_index[id].object = object;
+	id_index[id].type = type;
+}
+
+static inline void * id_index_find(unsigned int id, uint8_t type)
+{
+	if (id < id_index_size && id_index[id].type == type) return id_index[id].object;
+	return NULL;
+}
+
 static uint8_t tx_noautoflush=0;
+static uint8_t tx_batch=0;
 static uint8_t transmit_previous_timeout=0;
 
 #define TX_NUM   8
@@ -136,6 +176,7 @@ void FlightSimCommand::sendcmd(uint8_t n)
 FlightSimEvent::FlightSimEvent()
 {
 	id = unassigned_id++;
+	id_index_add(id, this, 3);
 	if (!first) {
 		first = this;
 	} else {
@@ -198,6 +239,8 @@ void FlightSimEvent::update(long val)
 
 FlightSimEvent * FlightSimEvent::find(unsigned int n)
 {
+	FlightSimEvent *item = (FlightSimEvent *)id_index_find(n, 3);
+	if (item || !id_index_incomplete) return item;
 	for (FlightSimEvent *p = first; p; p = p->next) {
 		if (p->id == n) return p;
 	}
@@ -208,6 +251,7 @@ FlightSimEvent * FlightSimEvent::find(unsigned int n)
 FlightSimData::FlightSimData()
 {
 	id = unassigned_id++;
+	id_index_add(id, this, 4);
 	if (!first) {
 		first = this;
 	} else {
@@ -265,6 +309,8 @@ void FlightSimData::update(char *val, size_t len)
 
 FlightSimData * FlightSimData::find(unsigned int n)
 {
+	FlightSimData *item = (FlightSimData *)id_index_find(n, 4);
+	if (item || !id_index_incomplete) return item;
 	for (FlightSimData *p = first; p; p = p->next) {
 		if (p->id == n) return p;
 	}
@@ -276,6 +322,7 @@ FlightSimData * FlightSimData::find(unsigned int n)
 FlightSimInteger::FlightSimInteger()
 {
 	id = unassigned_id++;
+	id_index_add(id, this, 1);
 	if (!first) {
 		first = this;
 	} else {
@@ -335,6 +382,8 @@ void FlightSimInteger::update(long val)
 
 FlightSimInteger * FlightSimInteger::find(unsigned int n)
 {
+	FlightSimInteger *item = (FlightSimInteger *)id_index_find(n, 1);
+	if (item || !id_index_incomplete) return item;
 	for (FlightSimInteger *p = first; p; p = p->next) {
 		if (p->id == n) return p;
 	}
@@ -347,6 +396,7 @@ FlightSimInteger * FlightSimInteger::find(unsigned int n)
 FlightSimFloat::FlightSimFloat()
 {
 	id = unassigned_id++;
+	id_index_add(id, this, 2);
 	if (!first) {
 		first = this;
 	} else {
@@ -406,6 +456,8 @@ void FlightSimFloat::update(float val)
 
 FlightSimFloat * FlightSimFloat::find(unsigned int n)
 {
+	FlightSimFloat *item = (FlightSimFloat *)id_index_find(n, 2);
+	if (item || !id_index_incomplete) return item;
 	for (FlightSimFloat *p = first; p; p = p->next) {
 		if (p->id == n) return p;
 	}
@@ -501,6 +553,7 @@ void FlightSimClass::update(void)
 	}
 	if (enabled && request_id_messages) {
 		request_id_messages = 0;
+		beginTransmitBatch();
 		for (FlightSimCommand *p = FlightSimCommand::first; p; p = p->next) {
 			p->identify();
 		}
@@ -520,6 +573,26 @@ void FlightSimClass::update(void)
 			p->identify();
 			// TODO: send any dirty data
 		}
+		endTransmitBatch();
+	}
+}
+
+// Between beginTransmitBatch() and endTransmitBatch(), messages are packed
+// into full FLIGHTSIM_TX_SIZE packets and nothing is sent on USB start of
+// frame until the batch ends.
+void FlightSimClass::beginTransmitBatch(void)
+{
+	tx_batch = 1;
+	tx_noautoflush = 1;
+}
+
+void FlightSimClass::endTransmitBatch(void)
+{
+	tx_batch = 0;
+	tx_noautoflush = 0;
+	// anything left in a partial packet goes on the next start of frame
+	if (tx_available > 0 && usb_configuration) {
+		usb_start_sof_interrupts(FLIGHTSIM_INTERFACE);
 	}
 }
 
@@ -577,7 +650,7 @@ void FlightSimClass::xmit(const void *p1, uint8_t n1, const void *p2, uint8_t n2
 		// wait for send until next SOF
 		usb_start_sof_interrupts(FLIGHTSIM_INTERFACE);
 	}
-	tx_noautoflush = 0;
+	if (!tx_batch) tx_noautoflush = 0;
 }
 
 void FlightSimClass::xmit_big_packet(const void *p1, uint8_t n1, const void *p2, uint8_t n2)
@@ -692,7 +765,7 @@ void FlightSimClass::xmit_big_packet(const void *p1, uint8_t n1, const void *p2,
 			usb_start_sof_interrupts(FLIGHTSIM_INTERFACE);
 		}
 	}
-	tx_noautoflush = 0;  // data is ready to be transmitted on start of USB token
+	if (!tx_batch) tx_noautoflush = 0;  // data is ready to be transmitted on start of USB token
 }
 
 extern "C" {
@@ -67,6 +67,9 @@ public:
 	static void update(void);
 	static bool isEnabled(void);
 	static unsigned long getFrameCount(void) { return frameCount; }
+	// Pack many writes into as few USB packets as possible
+	static void beginTransmitBatch(void);
+	static void endTransmitBatch(void);
 private:
 	static uint8_t request_id_messages;
 	static uint8_t enabled;
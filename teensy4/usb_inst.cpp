@@ -67,6 +67,10 @@ usb_mouse_class Mouse;
 usb_rawhid_class RawHID;
 #endif
 
+#ifdef MSC_INTERFACE
+usb_msc_class MSC;
+#endif
+
 #ifdef FLIGHTSIM_INTERFACE
 FlightSimClass FlightSim;
 #endif
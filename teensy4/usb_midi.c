@@ -139,44 +139,62 @@ void usb_midi_configure(void)
 // of this 32 bit input.
 void usb_midi_write_packed(uint32_t n)
 {
-	printf("usb_midi_write_packed\n");
-	if (!usb_configuration) return;
+	usb_midi_write_packed_array(&n, 1);
+}
+
+// Write many 32 bit events.  They are copied into USB packets as whole
+// groups, with only one wait per packet.  Returns the number written,
+// which is less than count only if the PC isn't listening.
+uint32_t usb_midi_write_packed_array(const uint32_t *data, uint32_t count)
+{
+	uint32_t sent = 0;
+
+	if (!usb_configuration) return 0;
 	tx_noautoflush = 1;
-	uint32_t head = tx_head;
-	transfer_t *xfer = tx_transfer + head;
-	uint32_t wait_begin_at = systick_millis_count;
-	while (!tx_available) {
-		uint32_t status = usb_transfer_status(xfer);
-		if (!(status & 0x80)) {
-			if (status & 0x68) {
-				// TODO: what if status has errors???
+	while (sent < count) {
+		uint32_t head = tx_head;
+		transfer_t *xfer = tx_transfer + head;
+		uint32_t wait_begin_at = systick_millis_count;
+		while (!tx_available) {
+			uint32_t status = usb_transfer_status(xfer);
+			if (!(status & 0x80)) {
+				if (status & 0x68) {
+					// TODO: what if status has errors???
+				}
+				tx_available = tx_packet_size;
+				transmit_previous_timeout = 0;
+				break;
 			}
-			tx_available = tx_packet_size;
-			transmit_previous_timeout = 0;
-			break;
+			if (systick_millis_count - wait_begin_at > TX_TIMEOUT_MSEC) {
+				transmit_previous_timeout = 1;
+			}
+			if (transmit_previous_timeout || !usb_configuration) {
+				tx_noautoflush = 0;
+				return sent;
+			}
+			yield();
 		}
-		if (systick_millis_count - wait_begin_at > TX_TIMEOUT_MSEC) {
-			transmit_previous_timeout = 1;
+		uint8_t *txbuf = txbuffer + (head * TX_SIZE);
+		uint32_t n = tx_available / 4;
+		if (n > count - sent) n = count - sent;
+		memcpy(txbuf + (tx_packet_size - tx_available), data + sent, n * 4);
+		sent += n;
+		tx_available -= n * 4;
+		if (tx_available == 0) {
+			usb_prepare_transfer(xfer, txbuf, tx_packet_size, 0);
+			arm_dcache_flush_delete(txbuf, TX_SIZE);
+			usb_transmit(MIDI_TX_ENDPOINT, xfer);
+			if (++head >= TX_NUM) head = 0;
+			tx_head = head;
 		}
-		if (transmit_previous_timeout) return;
-		if (!usb_configuration) return;
-		yield();
 	}
-	uint32_t *txdata = (uint32_t *)(txbuffer + (tx_head * TX_SIZE) + (tx_packet_size - tx_available));
-	*txdata = n;
-	tx_available -= 4;
 	if (tx_available == 0) {
-		uint8_t *txbuf = txbuffer + (tx_head * TX_SIZE);
-		usb_prepare_transfer(xfer, txbuf, tx_packet_size, 0);
-		arm_dcache_flush_delete(txbuf, TX_SIZE);
-		usb_transmit(MIDI_TX_ENDPOINT, xfer);
-		if (++head >= TX_NUM) head = 0;
-		tx_head = head;
 		usb_stop_sof_interrupts(MIDI_INTERFACE);
 	} else {
 		usb_start_sof_interrupts(MIDI_INTERFACE);
 	}
 	tx_noautoflush = 0;
+	return sent;
 }
 
 void usb_midi_flush_output(void)
@@ -198,25 +216,39 @@ void usb_midi_flush_output(void)
 	}
 }
 
+// SysEx messages are sent in groups of events, rather than 1 per call
+#define SYSEX_GROUP 32
+
 void usb_midi_send_sysex_buffer_has_term(const uint8_t *data, uint32_t length, uint8_t cable)
 {
+	uint32_t buf[SYSEX_GROUP];
+	uint32_t n = 0;
+
 	cable = (cable & 0x0F) << 4;
-        while (length > 3) {
-                usb_midi_write_packed(0x04 | cable | (data[0] << 8) | (data[1] << 16) | (data[2] << 24));
-                data += 3;
-                length -= 3;
-        }
-        if (length == 3) {
-                usb_midi_write_packed(0x07 | cable | (data[0] << 8) | (data[1] << 16) | (data[2] << 24));
-        } else if (length == 2) {
-                usb_midi_write_packed(0x06 | cable | (data[0] << 8) | (data[1] << 16));
-        } else if (length == 1) {
-                usb_midi_write_packed(0x05 | cable | (data[0] << 8));
-        }
+	while (length > 3) {
+		buf[n++] = 0x04 | cable | (data[0] << 8) | (data[1] << 16) | (data[2] << 24);
+		if (n == SYSEX_GROUP) {
+			if (usb_midi_write_packed_array(buf, n) < n) return;
+			n = 0;
+		}
+		data += 3;
+		length -= 3;
+	}
+	if (length == 3) {
+		buf[n++] = 0x07 | cable | (data[0] << 8) | (data[1] << 16) | (data[2] << 24);
+	} else if (length == 2) {
+		buf[n++] = 0x06 | cable | (data[0] << 8) | (data[1] << 16);
+	} else if (length == 1) {
+		buf[n++] = 0x05 | cable | (data[0] << 8);
+	}
+	if (n > 0) usb_midi_write_packed_array(buf, n);
 }
 
 void usb_midi_send_sysex_add_term_bytes(const uint8_t *data, uint32_t length, uint8_t cable)
 {
+	uint32_t buf[SYSEX_GROUP];
+	uint32_t n = 0;
+
 	cable = (cable & 0x0F) << 4;
 
 	if (length == 0) {
@@ -226,22 +258,27 @@ void usb_midi_send_sysex_add_term_bytes(const uint8_t *data, uint32_t length, ui
 		usb_midi_write_packed(0x07 | cable | (0xF0 << 8) | (data[0] << 16) | (0xF7 << 24));
 		return;
 	} else {
-		usb_midi_write_packed(0x04 | cable | (0xF0 << 8) | (data[0] << 16) | (data[1] << 24));
+		buf[n++] = 0x04 | cable | (0xF0 << 8) | (data[0] << 16) | (data[1] << 24);
 		data += 2;
 		length -= 2;
 	}
 	while (length >= 3) {
-		usb_midi_write_packed(0x04 | cable | (data[0] << 8) | (data[1] << 16) | (data[2] << 24));
+		buf[n++] = 0x04 | cable | (data[0] << 8) | (data[1] << 16) | (data[2] << 24);
+		if (n == SYSEX_GROUP) {
+			if (usb_midi_write_packed_array(buf, n) < n) return;
+			n = 0;
+		}
 		data += 3;
 		length -= 3;
 	}
 	if (length == 2) {
-		usb_midi_write_packed(0x07 | cable | (data[0] << 8) | (data[1] << 16) | (0xF7 << 24));
+		buf[n++] = 0x07 | cable | (data[0] << 8) | (data[1] << 16) | (0xF7 << 24);
 	} else if (length == 1) {
-                usb_midi_write_packed(0x06 | cable | (data[0] << 8) | (0xF7 << 16));
+		buf[n++] = 0x06 | cable | (data[0] << 8) | (0xF7 << 16);
 	} else {
-                usb_midi_write_packed(0x05 | cable | (0xF7 << 8));
+		buf[n++] = 0x05 | cable | (0xF7 << 8);
 	}
+	usb_midi_write_packed_array(buf, n);
 }
 
 static void sysex_byte(uint8_t b)
@@ -261,13 +298,19 @@ static void sysex_byte(uint8_t b)
 
 
 
-static void rx_queue_transfer(int i)
+// caller must disable the USB interrupt
+static void rx_queue(int i)
 {
-	NVIC_DISABLE_IRQ(IRQ_USB1);
 	void *buffer = rx_buffer + i * MIDI_RX_SIZE_480;
 	usb_prepare_transfer(rx_transfer + i, buffer, rx_packet_size, i);
 	arm_dcache_delete(buffer, rx_packet_size);
 	usb_receive(MIDI_RX_ENDPOINT, rx_transfer + i);
+}
+
+static void rx_queue_transfer(int i)
+{
+	NVIC_DISABLE_IRQ(IRQ_USB1);
+	rx_queue(i);
 	NVIC_ENABLE_IRQ(IRQ_USB1);
 }
 
@@ -315,19 +358,74 @@ uint32_t usb_midi_read_message(void)
 		rx_index[i] += 4;
 		if (rx_index[i] >= rx_count[i]) {
 			rx_tail = tail;
-			rx_queue_transfer(i);
+			rx_queue(i);
 		}
 	}
 	NVIC_ENABLE_IRQ(IRQ_USB1);
 	return n;
 }
 
+// Read up to max messages, all that are buffered, with the USB interrupt
+// disabled only once.  Returns the number of messages read.
+uint32_t usb_midi_read_messages(uint32_t *buffer, uint32_t max)
+{
+	uint32_t count = 0, bytes = 0;
+	NVIC_DISABLE_IRQ(IRQ_USB1);
+	uint32_t tail = rx_tail;
+	while (tail != rx_head && count < max) {
+		uint32_t t = tail;
+		if (++t > RX_NUM) t = 0;
+		uint32_t i = rx_list[t];
+		uint32_t n = (rx_count[i] - rx_index[i]) / 4;
+		if (n > max - count) n = max - count;
+		memcpy(buffer + count, rx_buffer + i * MIDI_RX_SIZE_480 + rx_index[i], n * 4);
+		count += n;
+		rx_index[i] += n * 4;
+		bytes += n * 4;
+		// less than a whole message left, release the packet
+		if (rx_count[i] - rx_index[i] >= 4) break;
+		bytes += rx_count[i] - rx_index[i];
+		tail = t;
+		rx_queue(i);
+	}
+	rx_tail = tail;
+	rx_available -= bytes;
+	NVIC_ENABLE_IRQ(IRQ_USB1);
+	return count;
+}
+
+static int midi_dispatch(uint32_t n, uint32_t channel);
+
 int usb_midi_read(uint32_t channel)
 {
-	uint32_t n, ch, type1, type2, b1;
-	
-	n = usb_midi_read_message();
+	uint32_t n = usb_midi_read_message();
 	if (n == 0) return 0;
+	return midi_dispatch(n, channel);
+}
+
+// Read all buffered messages and call the usb_midi_handle functions for
+// each.  Returns the number of messages read.
+uint32_t usb_midi_read_all(uint32_t channel)
+{
+	uint32_t buf[32];
+	uint32_t i, n, total = 0;
+
+	do {
+		n = usb_midi_read_messages(buf, sizeof(buf) / 4);
+		for (i=0; i < n; i++) {
+			if (buf[i]) midi_dispatch(buf[i], channel);
+		}
+		total += n;
+	} while (n == sizeof(buf) / 4);
+	return total;
+}
+
+// Parse one 32 bit message, update the usb_midi_msg variables and call
+// any usb_midi_handle function.  Returns 1 for a complete message.
+static int midi_dispatch(uint32_t n, uint32_t channel)
+{
+	uint32_t ch, type1, type2, b1;
+
 	type1 = n & 15;
 	type2 = (n >> 12) & 15;
 	b1 = (n >> 8) & 0xFF;
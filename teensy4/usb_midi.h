@@ -46,12 +46,15 @@ extern "C" {
 #endif
 void usb_midi_configure(void);
 void usb_midi_write_packed(uint32_t n);
+uint32_t usb_midi_write_packed_array(const uint32_t *data, uint32_t count);
 void usb_midi_send_sysex_buffer_has_term(const uint8_t *data, uint32_t length, uint8_t cable);
 void usb_midi_send_sysex_add_term_bytes(const uint8_t *data, uint32_t length, uint8_t cable);
 void usb_midi_flush_output(void);
 int usb_midi_read(uint32_t channel);
 uint32_t usb_midi_available(void);
 uint32_t usb_midi_read_message(void);
+uint32_t usb_midi_read_messages(uint32_t *buffer, uint32_t max);
+uint32_t usb_midi_read_all(uint32_t channel);
 extern uint8_t usb_midi_msg_cable;
 extern uint8_t usb_midi_msg_channel;
 extern uint8_t usb_midi_msg_type;
@@ -284,6 +287,17 @@ class usb_midi_class
         bool read(uint8_t channel=0) __attribute__((always_inline)) {
 		return usb_midi_read(channel);
 	}
+	// read every buffered message, calling the handle functions for each
+	uint32_t readAll(uint8_t channel=0) __attribute__((always_inline)) {
+		return usb_midi_read_all(channel);
+	}
+	// raw 32 bit USB MIDI event packets, many at once
+	uint32_t sendPackets(const uint32_t *data, uint32_t count) __attribute__((always_inline)) {
+		return usb_midi_write_packed_array(data, count);
+	}
+	uint32_t readPackets(uint32_t *data, uint32_t max) __attribute__((always_inline)) {
+		return usb_midi_read_messages(data, max);
+	}
         uint8_t getType(void) __attribute__((always_inline)) {
                 return usb_midi_msg_type;
         }
@@ -0,0 +1,450 @@
+/* Teensyduino Core Library
+ * http://www.pjrc.com/teensy/
+ * Copyright (c) 2017 PJRC.COM, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * 1. The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * 2. If the Software is incorporated into a build system that allows
+ * selection among a list of target devices, then similar target
+ * devices manufactured by PJRC.COM must be included in the list of
+ * target devices and selectable in the same manner.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "usb_dev.h"
+#include "usb_msc.h"
+#include "avr/pgmspace.h" // for PROGMEM, DMAMEM, FASTRUN
+#include "core_pins.h" // for yield()
+#include <string.h>    // for memcpy()
+
+#include "debug/printf.h"
+#ifdef MSC_INTERFACE // defined by usb_dev.h -> usb_desc.h
+
+// USB Mass Storage Class, Bulk-Only Transport 1.0, with the SCSI
+// commands Windows, MacOS and Linux use for removable disks.
+
+extern volatile uint8_t usb_high_speed;
+extern volatile uint8_t usb_configuration;
+
+// READ(10) and WRITE(10) use 2 buffers, so USB transfer of one buffer
+// overlaps media access with the other.  A transfer descriptor can
+// move at most 16K.
+#ifndef MSC_BUFFER_SIZE
+#define MSC_BUFFER_SIZE 16384
+#endif
+#if MSC_BUFFER_SIZE < 512 || MSC_BUFFER_SIZE > 16384 || (MSC_BUFFER_SIZE & 511)
+#error "MSC_BUFFER_SIZE must be a multiple of 512, from 512 to 16384"
+#endif
+#define MSC_BUFFER_BLOCKS (MSC_BUFFER_SIZE / USB_MSC_BLOCK_SIZE)
+
+// transfers 0 & 1 are data, 2 is the command (rx) or status (tx)
+#define CMD 2
+static transfer_t tx_transfer[3] __attribute__ ((used, aligned(32)));
+static transfer_t rx_transfer[3] __attribute__ ((used, aligned(32)));
+static volatile uint8_t tx_done[3];
+static volatile uint8_t rx_done[3];
+DMAMEM static uint8_t buffer[2][MSC_BUFFER_SIZE] __attribute__ ((aligned(32)));
+// small buffers in DTCM need no cache maintenance
+static uint8_t cbw_buffer[MSC_RX_SIZE_480] __attribute__ ((aligned(32)));
+static uint8_t csw_buffer[32] __attribute__ ((aligned(32)));
+
+static uint16_t packet_size=0;
+static volatile uint8_t generation=0; // changes on reset, to abort commands
+static uint8_t yield_enabled=1;
+
+static const usb_msc_media_t * volatile media=NULL;
+static volatile uint8_t media_changed=0;
+
+// state of the command in progress
+static uint32_t cmd_tag;
+static uint32_t cmd_residue;
+static uint8_t cmd_in;
+static uint8_t cmd_generation;
+static uint8_t sense_key, sense_asc;
+
+#define CMD_PASSED	0
+#define CMD_FAILED	1
+#define CMD_PHASE_ERROR	2
+#define CMD_ABORTED	-1
+
+static void tx_event(transfer_t *t) { tx_done[t->callback_param] = 1; }
+static void rx_event(transfer_t *t) { rx_done[t->callback_param] = 1; }
+
+static void rx_queue_command(void)
+{
+	rx_done[CMD] = 0;
+	usb_prepare_transfer(rx_transfer + CMD, cbw_buffer, packet_size, CMD);
+	usb_receive(MSC_RX_ENDPOINT, rx_transfer + CMD);
+}
+
+// called from the USB interrupt by SET_CONFIGURATION
+void usb_msc_configure(void)
+{
+	if (usb_high_speed) {
+		packet_size = MSC_TX_SIZE_480;
+	} else {
+		packet_size = MSC_TX_SIZE_12;
+	}
+	printf("usb_msc_configure: %u\n", packet_size);
+	memset(tx_transfer, 0, sizeof(tx_transfer));
+	memset(rx_transfer, 0, sizeof(rx_transfer));
+	memset((void *)tx_done, 0, sizeof(tx_done));
+	memset((void *)rx_done, 0, sizeof(rx_done));
+	generation++;
+	usb_config_tx(MSC_TX_ENDPOINT, packet_size, 0, tx_event);
+	usb_config_rx(MSC_RX_ENDPOINT, packet_size, 0, rx_event);
+	rx_queue_command();
+	if (yield_enabled) yield_active_check_flags |= YIELD_CHECK_USB_MSC;
+}
+
+// called from the USB interrupt by Bulk-Only Mass Storage Reset
+void usb_msc_reset(void)
+{
+	const uint32_t mask = (1 << (MSC_TX_ENDPOINT + 16)) | (1 << MSC_RX_ENDPOINT);
+	USB1_ENDPTFLUSH = mask;
+	while (USB1_ENDPTFLUSH & mask) ;
+	// the host clears any halts, then sends the next command
+	usb_msc_configure();
+}
+
+void usb_msc_set_media(const usb_msc_media_t *m)
+{
+	media = m;
+	media_changed = 1;
+}
+
+void usb_msc_yield(int enable)
+{
+	yield_enabled = enable;
+	if (enable) {
+		yield_active_check_flags |= YIELD_CHECK_USB_MSC;
+	} else {
+		yield_active_check_flags &= ~YIELD_CHECK_USB_MSC;
+	}
+}
+
+/*************************************************************************/
+/**                          Data Transfers                             **/
+/*************************************************************************/
+
+// Start a transfer, unless the host reset (or reconfigured) since the
+// command began.  The USB interrupt is masked so a reset can't happen
+// between checking and queuing.
+static int tx_queue(int i, const void *data, uint32_t len)
+{
+	int r = -1;
+	tx_done[i] = 0;
+	NVIC_DISABLE_IRQ(IRQ_USB1);
+	if (cmd_generation == generation) {
+		usb_prepare_transfer(tx_transfer + i, data, len, i);
+		usb_transmit(MSC_TX_ENDPOINT, tx_transfer + i);
+		r = 0;
+	}
+	NVIC_ENABLE_IRQ(IRQ_USB1);
+	return r;
+}
+
+static int rx_queue(int i, void *data, uint32_t len)
+{
+	int r = -1;
+	rx_done[i] = 0;
+	NVIC_DISABLE_IRQ(IRQ_USB1);
+	if (cmd_generation == generation) {
+		usb_prepare_transfer(rx_transfer + i, data, len, i);
+		usb_receive(MSC_RX_ENDPOINT, rx_transfer + i);
+		r = 0;
+	}
+	NVIC_ENABLE_IRQ(IRQ_USB1);
+	return r;
+}
+
+static int wait(volatile uint8_t *done)
+{
+	while (!*done) {
+		if (cmd_generation != generation || !usb_configuration) return -1;
+	}
+	return 0;
+}
+
+// send a short response (INQUIRY, REQUEST SENSE, etc) from CPU memory
+static int send_response(const void *data, uint32_t len)
+{
+	if (len > cmd_residue) len = cmd_residue;
+	if (len == 0) return CMD_PASSED;
+	memcpy(buffer[0], data, len);
+	arm_dcache_flush_delete(buffer[0], len);
+	if (tx_queue(0, buffer[0], len) || wait(tx_done + 0)) return CMD_ABORTED;
+	cmd_residue -= len;
+	return CMD_PASSED;
+}
+
+static void send_status(int status)
+{
+	// when the host expected more data, the Bulk-Only spec requires a
+	// stall.  The status may only be sent after the host clears it.
+	if (cmd_residue > 0) {
+		if (cmd_in) {
+			usb_stall(MSC_TX_ENDPOINT, 1);
+			while (usb_stalled(MSC_TX_ENDPOINT, 1)) {
+				if (cmd_generation != generation || !usb_configuration) return;
+			}
+		} else {
+			usb_stall(MSC_RX_ENDPOINT, 0);
+		}
+	}
+	csw_buffer[0] = 'U';
+	csw_buffer[1] = 'S';
+	csw_buffer[2] = 'B';
+	csw_buffer[3] = 'S';
+	memcpy(csw_buffer + 4, &cmd_tag, 4);
+	memcpy(csw_buffer + 8, &cmd_residue, 4);
+	csw_buffer[12] = status;
+	if (tx_queue(CMD, csw_buffer, 13)) return;
+	NVIC_DISABLE_IRQ(IRQ_USB1);
+	if (cmd_generation == generation) rx_queue_command();
+	NVIC_ENABLE_IRQ(IRQ_USB1);
+}
+
+/*************************************************************************/
+/**                           SCSI Commands                             **/
+/*************************************************************************/
+
+static int fail(uint8_t key, uint8_t asc)
+{
+	sense_key = key;
+	sense_asc = asc;
+	return CMD_FAILED;
+}
+
+static int media_ready(const usb_msc_media_t *m)
+{
+	if (!m) {
+		fail(0x02, 0x3A); // not ready, medium not present
+		return 0;
+	}
+	if (media_changed) {
+		media_changed = 0;
+		fail(0x06, 0x28); // unit attention, medium may have changed
+		return 0;
+	}
+	return 1;
+}
+
+static inline uint32_t be32(const uint8_t *p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline void put_be32(uint8_t *p, uint32_t n)
+{
+	p[0] = n >> 24;
+	p[1] = n >> 16;
+	p[2] = n >> 8;
+	p[3] = n;
+}
+
+// READ(10), media reads of the next buffer overlap USB transmit of the
+// previous buffer
+static int read10(const usb_msc_media_t *m, uint32_t lba, uint32_t count)
+{
+	uint32_t n, next;
+	int b=0, err;
+
+	if (count == 0) return CMD_PASSED;
+	if (!cmd_in || cmd_residue < count * USB_MSC_BLOCK_SIZE) return CMD_PHASE_ERROR;
+	if (lba + count > m->block_count || lba + count < lba) {
+		return fail(0x05, 0x21); // illegal request, LBA out of range
+	}
+	n = (count < MSC_BUFFER_BLOCKS) ? count : MSC_BUFFER_BLOCKS;
+	if (m->read(m->context, lba, buffer[0], n)) return fail(0x03, 0x11);
+	while (1) {
+		arm_dcache_flush_delete(buffer[b], n * USB_MSC_BLOCK_SIZE);
+		if (tx_queue(b, buffer[b], n * USB_MSC_BLOCK_SIZE)) return CMD_ABORTED;
+		lba += n;
+		count -= n;
+		next = (count < MSC_BUFFER_BLOCKS) ? count : MSC_BUFFER_BLOCKS;
+		err = 0;
+		if (next) err = m->read(m->context, lba, buffer[b ^ 1], next);
+		if (wait(tx_done + b)) return CMD_ABORTED;
+		cmd_residue -= n * USB_MSC_BLOCK_SIZE;
+		if (!next) return CMD_PASSED;
+		if (err) return fail(0x03, 0x11); // medium error, unrecovered read error
+		b ^= 1;
+		n = next;
+	}
+}
+
+// WRITE(10), USB receive of the next buffer overlaps media writes of the
+// previous buffer.  After a media error the rest of the data is still
+// received, so the host sees the error in the status.
+static int write10(const usb_msc_media_t *m, uint32_t lba, uint32_t count)
+{
+	uint32_t n, next, len;
+	int b=0, err=0;
+
+	if (count == 0) return CMD_PASSED;
+	if (cmd_in || cmd_residue < count * USB_MSC_BLOCK_SIZE) return CMD_PHASE_ERROR;
+	if (lba + count > m->block_count || lba + count < lba) {
+		return fail(0x05, 0x21); // illegal request, LBA out of range
+	}
+	if (m->read_only) return fail(0x07, 0x27); // data protect, write protected
+	n = (count < MSC_BUFFER_BLOCKS) ? count : MSC_BUFFER_BLOCKS;
+	arm_dcache_delete(buffer[0], n * USB_MSC_BLOCK_SIZE);
+	if (rx_queue(0, buffer[0], n * USB_MSC_BLOCK_SIZE)) return CMD_ABORTED;
+	while (1) {
+		if (wait(rx_done + b)) return CMD_ABORTED;
+		len = n * USB_MSC_BLOCK_SIZE - ((rx_transfer[b].status >> 16) & 0x7FFF);
+		cmd_residue -= len;
+		if (len < n * USB_MSC_BLOCK_SIZE) return CMD_PHASE_ERROR; // host sent less
+		count -= n;
+		next = (count < MSC_BUFFER_BLOCKS) ? count : MSC_BUFFER_BLOCKS;
+		if (next) {
+			arm_dcache_delete(buffer[b ^ 1], next * USB_MSC_BLOCK_SIZE);
+			if (rx_queue(b ^ 1, buffer[b ^ 1], next * USB_MSC_BLOCK_SIZE)) return CMD_ABORTED;
+		}
+		arm_dcache_delete(buffer[b], n * USB_MSC_BLOCK_SIZE);
+		if (!err && m->write(m->context, lba, buffer[b], n)) err = 1;
+		lba += n;
+		if (!next) break;
+		b ^= 1;
+		n = next;
+	}
+	if (err) return fail(0x03, 0x03); // medium error, write fault
+	return CMD_PASSED;
+}
+
+static int scsi_command(const uint8_t *cmd)
+{
+	const usb_msc_media_t *m = media;
+	uint8_t reply[36];
+
+	switch (cmd[0]) {
+	  case 0x00: // TEST UNIT READY
+		if (!media_ready(m)) return CMD_FAILED;
+		return CMD_PASSED;
+	  case 0x03: // REQUEST SENSE
+		memset(reply, 0, 18);
+		reply[0] = 0x70;
+		reply[2] = sense_key;
+		reply[7] = 10;
+		reply[12] = sense_asc;
+		sense_key = 0;
+		sense_asc = 0;
+		return send_response(reply, (cmd[4] < 18) ? cmd[4] : 18);
+	  case 0x12: // INQUIRY
+		if (cmd[1] & 1) return fail(0x05, 0x24); // no vital product data
+		memset(reply, ' ', 36);
+		reply[0] = 0x00; // direct access block device
+		reply[1] = 0x80; // removable
+		reply[2] = 0x04; // SPC-2
+		reply[3] = 0x02;
+		reply[4] = 36 - 5;
+		reply[5] = 0;
+		reply[6] = 0;
+		reply[7] = 0;
+		memcpy(reply + 8, "Teensy", 6);
+		memcpy(reply + 16, "USB Disk", 8);
+		memcpy(reply + 32, "1.0", 3);
+		return send_response(reply, (((cmd[3] << 8) | cmd[4]) < 36) ? ((cmd[3] << 8) | cmd[4]) : 36);
+	  case 0x1A: // MODE SENSE(6)
+		memset(reply, 0, 4);
+		reply[0] = 3;
+		if (m && m->read_only) reply[2] = 0x80;
+		return send_response(reply, (cmd[4] < 4) ? cmd[4] : 4);
+	  case 0x5A: // MODE SENSE(10)
+		memset(reply, 0, 8);
+		reply[1] = 6;
+		if (m && m->read_only) reply[3] = 0x80;
+		return send_response(reply, (((cmd[7] << 8) | cmd[8]) < 8) ? ((cmd[7] << 8) | cmd[8]) : 8);
+	  case 0x1B: // START STOP UNIT
+		if (m && m->sync) m->sync(m->context);
+		return CMD_PASSED;
+	  case 0x1E: // PREVENT ALLOW MEDIUM REMOVAL
+		return CMD_PASSED;
+	  case 0x23: // READ FORMAT CAPACITIES
+		memset(reply, 0, 12);
+		reply[3] = 8;
+		if (m) {
+			put_be32(reply + 4, m->block_count);
+			reply[8] = 0x02; // formatted media
+		} else {
+			put_be32(reply + 4, 0xFFFFFFFF);
+			reply[8] = 0x03; // no media
+		}
+		reply[10] = USB_MSC_BLOCK_SIZE >> 8;
+		return send_response(reply, (((cmd[7] << 8) | cmd[8]) < 12) ? ((cmd[7] << 8) | cmd[8]) : 12);
+	  case 0x25: // READ CAPACITY(10)
+		if (!media_ready(m)) return CMD_FAILED;
+		put_be32(reply, m->block_count - 1);
+		put_be32(reply + 4, USB_MSC_BLOCK_SIZE);
+		return send_response(reply, 8);
+	  case 0x28: // READ(10)
+		if (!media_ready(m)) return CMD_FAILED;
+		return read10(m, be32(cmd + 2), (cmd[7] << 8) | cmd[8]);
+	  case 0x2A: // WRITE(10)
+		if (!media_ready(m)) return CMD_FAILED;
+		return write10(m, be32(cmd + 2), (cmd[7] << 8) | cmd[8]);
+	  case 0x2F: // VERIFY(10)
+		if (!media_ready(m)) return CMD_FAILED;
+		return CMD_PASSED;
+	  case 0x35: // SYNCHRONIZE CACHE(10)
+		if (!media_ready(m)) return CMD_FAILED;
+		if (m->sync && m->sync(m->context)) return fail(0x03, 0x03);
+		return CMD_PASSED;
+	}
+	return fail(0x05, 0x20); // illegal request, invalid command
+}
+
+// Process a received command.  Called from yield(), or by the program
+// if MSC.useYield(false).
+void usb_msc_task(void)
+{
+	static uint8_t running=0;
+	const uint8_t *cbw = cbw_buffer;
+	uint32_t len, length;
+	int status;
+
+	if (!usb_configuration || !rx_done[CMD] || running) return;
+	running = 1;
+	NVIC_DISABLE_IRQ(IRQ_USB1);
+	cmd_generation = generation;
+	rx_done[CMD] = 0;
+	len = packet_size - ((rx_transfer[CMD].status >> 16) & 0x7FFF);
+	NVIC_ENABLE_IRQ(IRQ_USB1);
+	memcpy(&length, cbw + 8, 4);
+	if (len != 31 || memcmp(cbw, "USBC", 4) != 0 || cbw[13] != 0
+	  || cbw[14] < 1 || cbw[14] > 16) {
+		// not a valid command, stall both endpoints until the
+		// host does reset recovery
+		usb_stall(MSC_TX_ENDPOINT, 1);
+		usb_stall(MSC_RX_ENDPOINT, 0);
+		running = 0;
+		return;
+	}
+	memcpy(&cmd_tag, cbw + 4, 4);
+	cmd_residue = length;
+	cmd_in = (cbw[12] & 0x80) ? 1 : 0;
+	if (cbw[0x0F] != 0x03) sense_key = sense_asc = 0;
+	status = scsi_command(cbw + 15);
+	if (status != CMD_ABORTED) send_status(status);
+	running = 0;
+}
+
+#endif // MSC_INTERFACE
@@ -0,0 +1,132 @@
+/* Teensyduino Core Library
+ * http://www.pjrc.com/teensy/
+ * Copyright (c) 2017 PJRC.COM, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * 1. The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * 2. If the Software is incorporated into a build system that allows
+ * selection among a list of target devices, then similar target
+ * devices manufactured by PJRC.COM must be included in the list of
+ * target devices and selectable in the same manner.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "usb_desc.h"
+
+#if defined(MSC_INTERFACE)
+
+#include <inttypes.h>
+
+// Mass storage (Bulk-Only Transport, SCSI) disk.  The disk's data comes
+// from a block media, which is any set of functions to read and write
+// 512 byte blocks.  RAM (including EXTMEM PSRAM) and program flash media
+// are built in.  SdFat cards, or anything with the same readSectors(),
+// writeSectors(), sectorCount() and syncDevice() functions, can be used
+// with MSC.begin(card).
+//
+// USB transfers are started by interrupts, but all media access is done
+// from yield(), so media drivers which wait or use interrupts work.  Do
+// not access the same media from your program while the USB host has
+// the disk mounted.
+
+#define USB_MSC_BLOCK_SIZE	512
+
+// read and write return 0 for success, or non-zero for media error
+typedef struct {
+	int (*read)(void *context, uint32_t lba, void *buffer, uint32_t count);
+	int (*write)(void *context, uint32_t lba, const void *buffer, uint32_t count);
+	int (*sync)(void *context);	// optional, may be NULL
+	void *context;
+	uint32_t block_count;
+	uint8_t read_only;
+} usb_msc_media_t;
+
+// C language implementation
+#ifdef __cplusplus
+extern "C" {
+#endif
+void usb_msc_configure(void);
+void usb_msc_reset(void);
+void usb_msc_task(void);
+void usb_msc_set_media(const usb_msc_media_t *media);
+void usb_msc_yield(int enable);
+int usb_msc_ramdisk(usb_msc_media_t *media, void *buffer, uint32_t size);
+int usb_msc_flashdisk(usb_msc_media_t *media, uint32_t offset, uint32_t size);
+#ifdef __cplusplus
+}
+#endif
+
+
+// C++ interface
+#ifdef __cplusplus
+class usb_msc_class
+{
+public:
+	// use any memory, the size is rounded down to whole 512 byte blocks
+	bool ramDisk(void *buffer, uint32_t size) {
+		if (!usb_msc_ramdisk(&media, buffer, size)) return false;
+		usb_msc_set_media(&media);
+		return true;
+	}
+	// use unused program flash, offset & size must be multiples of 4096
+	bool flashDisk(uint32_t offset, uint32_t size) {
+		if (!usb_msc_flashdisk(&media, offset, size)) return false;
+		usb_msc_set_media(&media);
+		return true;
+	}
+	// use a SD card or other block device, which must already be initialized
+	template <class T> bool begin(T &device, bool read_only = false) {
+		media.read = &device_read<T>;
+		media.write = &device_write<T>;
+		media.sync = &device_sync<T>;
+		media.context = &device;
+		media.block_count = device.sectorCount();
+		media.read_only = read_only;
+		if (media.block_count == 0) return false;
+		usb_msc_set_media(&media);
+		return true;
+	}
+	bool begin(const usb_msc_media_t *m) { usb_msc_set_media(m); return m != NULL; }
+	void end(void) { usb_msc_set_media(NULL); }
+	// media access normally runs from yield().  If your program uses
+	// yield() while accessing the same device (SdFat can), turn this off
+	// and call task() from loop().
+	void useYield(bool enable) { usb_msc_yield(enable); }
+	void task(void) { usb_msc_task(); }
+private:
+	template <class T> static int device_read(void *c, uint32_t lba, void *buf, uint32_t n) {
+		return ((T *)c)->readSectors(lba, (uint8_t *)buf, n) ? 0 : -1;
+	}
+	template <class T> static int device_write(void *c, uint32_t lba, const void *buf, uint32_t n) {
+		return ((T *)c)->writeSectors(lba, (const uint8_t *)buf, n) ? 0 : -1;
+	}
+	template <class T> static int device_sync(void *c) {
+		return ((T *)c)->syncDevice() ? 0 : -1;
+	}
+	usb_msc_media_t media;
+};
+
+extern usb_msc_class MSC;
+
+#endif // __cplusplus
+
+#endif // MSC_INTERFACE
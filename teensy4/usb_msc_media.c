@@ -0,0 +1,166 @@
+/* Teensyduino Core Library
+ * http://www.pjrc.com/teensy/
+ * Copyright (c) 2017 PJRC.COM, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * 1. The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * 2. If the Software is incorporated into a build system that allows
+ * selection among a list of target devices, then similar target
+ * devices manufactured by PJRC.COM must be included in the list of
+ * target devices and selectable in the same manner.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "usb_dev.h"
+#include "usb_msc.h"
+#include "avr/pgmspace.h" // for DMAMEM
+#include <string.h>
+
+#ifdef MSC_INTERFACE // defined by usb_dev.h -> usb_desc.h
+
+// Built in media for the USB disk: RAM and program flash.
+
+/*************************************************************************/
+/**                              RAM Disk                               **/
+/*************************************************************************/
+
+// Any memory works, including EXTMEM PSRAM on Teensy 4.1.
+static int ram_read(void *context, uint32_t lba, void *buffer, uint32_t count)
+{
+	memcpy(buffer, (uint8_t *)context + lba * USB_MSC_BLOCK_SIZE, count * USB_MSC_BLOCK_SIZE);
+	return 0;
+}
+
+static int ram_write(void *context, uint32_t lba, const void *buffer, uint32_t count)
+{
+	memcpy((uint8_t *)context + lba * USB_MSC_BLOCK_SIZE, buffer, count * USB_MSC_BLOCK_SIZE);
+	return 0;
+}
+
+int usb_msc_ramdisk(usb_msc_media_t *media, void *buffer, uint32_t size)
+{
+	if (!media || !buffer || size < USB_MSC_BLOCK_SIZE) return 0;
+	media->read = ram_read;
+	media->write = ram_write;
+	media->sync = NULL;
+	media->context = buffer;
+	media->block_count = size / USB_MSC_BLOCK_SIZE;
+	media->read_only = 0;
+	return 1;
+}
+
+/*************************************************************************/
+/**                         Program Flash Disk                          **/
+/*************************************************************************/
+
+// The flash between the end of the program and the EEPROM emulation
+// area may be used.  Writes erase 4K sectors, which stops all
+// interrupts for tens of milliseconds, so this is best for data which
+// is read often and rarely written.
+#if defined(ARDUINO_TEENSY40)
+#define FLASH_EEPROM_ADDR 0x601F0000
+#elif defined(ARDUINO_TEENSY41)
+#define FLASH_EEPROM_ADDR 0x607C0000
+#elif defined(ARDUINO_TEENSY_MICROMOD)
+#define FLASH_EEPROM_ADDR 0x60FC0000
+#endif
+
+#ifdef FLASH_EEPROM_ADDR
+extern unsigned long _flashimagelen;
+void eepromemu_flash_write(void *addr, const void *data, uint32_t len);
+void eepromemu_flash_erase_sector(void *addr);
+
+DMAMEM static uint8_t sector_buffer[4096] __attribute__ ((aligned(32)));
+
+static int flash_read(void *context, uint32_t lba, void *buffer, uint32_t count)
+{
+	memcpy(buffer, (uint8_t *)context + lba * USB_MSC_BLOCK_SIZE, count * USB_MSC_BLOCK_SIZE);
+	return 0;
+}
+
+// program pages which differ, page program can not cross a 256 byte page
+static void flash_program(uint8_t *addr, const uint8_t *data, uint32_t len)
+{
+	while (len > 0) {
+		uint32_t n = 256 - ((uint32_t)addr & 255);
+		if (n > len) n = len;
+		if (memcmp(addr, data, n) != 0) eepromemu_flash_write(addr, data, n);
+		addr += n;
+		data += n;
+		len -= n;
+	}
+}
+
+static int flash_write(void *context, uint32_t lba, const void *buffer, uint32_t count)
+{
+	const uint8_t *src = (const uint8_t *)buffer;
+	uint8_t *addr = (uint8_t *)context + lba * USB_MSC_BLOCK_SIZE;
+
+	while (count > 0) {
+		uint8_t *sector = (uint8_t *)((uint32_t)addr & ~4095);
+		uint32_t offset = addr - sector;
+		uint32_t i, len = 4096 - offset;
+		if (len > count * USB_MSC_BLOCK_SIZE) len = count * USB_MSC_BLOCK_SIZE;
+		if (memcmp(addr, src, len) != 0) {
+			// erase only if a bit must change from 0 to 1
+			for (i=0; i < len; i++) {
+				if (src[i] & ~addr[i]) break;
+			}
+			if (i < len) {
+				memcpy(sector_buffer, sector, 4096);
+				memcpy(sector_buffer + offset, src, len);
+				eepromemu_flash_erase_sector(sector);
+				flash_program(sector, sector_buffer, 4096);
+			} else {
+				flash_program(addr, src, len);
+			}
+			if (memcmp(addr, src, len) != 0) return -1;
+		}
+		addr += len;
+		src += len;
+		count -= len / USB_MSC_BLOCK_SIZE;
+	}
+	return 0;
+}
+
+int usb_msc_flashdisk(usb_msc_media_t *media, uint32_t offset, uint32_t size)
+{
+	uint32_t start = 0x60000000 + offset;
+	uint32_t image_end = 0x60000000 + (uint32_t)&_flashimagelen;
+
+	if (!media || size == 0 || ((offset | size) & 4095)) return 0;
+	if (start < image_end || start + size > FLASH_EEPROM_ADDR || start + size < start) return 0;
+	media->read = flash_read;
+	media->write = flash_write;
+	media->sync = NULL;
+	media->context = (void *)start;
+	media->block_count = size / USB_MSC_BLOCK_SIZE;
+	media->read_only = 0;
+	return 1;
+}
+
+#else
+int usb_msc_flashdisk(usb_msc_media_t *media, uint32_t offset, uint32_t size)
+{
+	return 0;
+}
+#endif // FLASH_EEPROM_ADDR
+
+#endif // MSC_INTERFACE
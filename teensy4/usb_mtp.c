@@ -57,8 +57,38 @@ static int rx_list_transfer_len[RX_NUM + 1];
 static uint16_t rx_packet_size=0;
 static void rx_queue_transfer(int i);
 static void rx_event(transfer_t *t);
+static void tx_event(transfer_t *t);
 extern volatile uint8_t usb_configuration;
 
+// Streaming transfers move data directly to or from the caller's memory,
+// up to 16K per transfer descriptor.  callback_param is STREAM + index.
+#ifndef MTP_STREAM_NUM
+#define MTP_STREAM_NUM  8
+#endif
+#define STREAM  16
+#define STREAM_SIZE  16384
+static transfer_t stream_tx[MTP_STREAM_NUM] __attribute__ ((used, aligned(32)));
+static usb_mtp_callback_t stream_tx_callback[MTP_STREAM_NUM];
+static void *stream_tx_context[MTP_STREAM_NUM];
+static uint32_t stream_tx_length[MTP_STREAM_NUM];
+static uint8_t stream_tx_head=0;
+static volatile uint8_t stream_tx_pending=0;
+
+static transfer_t stream_rx[MTP_STREAM_NUM] __attribute__ ((used, aligned(32)));
+static uint32_t stream_rx_size[MTP_STREAM_NUM];
+static uint8_t stream_rx_count;
+static uint8_t *stream_rx_buffer;
+static uint32_t stream_rx_length;
+static uint32_t stream_rx_offset;
+static uint32_t stream_rx_dma; // offset where streaming transfers begin
+static usb_mtp_callback_t stream_rx_callback;
+static void *stream_rx_context;
+static volatile int stream_rx_result;
+// 0 = packets received normally, 1 = streaming receive in progress,
+// 2 = streaming receive finished in the middle of a data phase
+static volatile uint8_t rx_stream=0;
+static uint8_t rx_idle=0; // packet transfers not queued during streaming
+
 uint32_t mtp_txEventCount = 0;
 static void txEvent_event(transfer_t *t) { mtp_txEventCount++;}
 
@@ -81,10 +111,17 @@ void usb_mtp_configure(void)
 	printf("usb_mtp_configure: TX:%u RX:%u\n", tx_packet_size, rx_packet_size);
 	memset(tx_transfer, 0, sizeof(tx_transfer));
 	memset(rx_transfer, 0, sizeof(rx_transfer));
+	memset(stream_tx, 0, sizeof(stream_tx));
+	memset(stream_rx, 0, sizeof(stream_rx));
 	tx_head = 0;
 	rx_head = 0;
 	rx_tail = 0;
-	usb_config_tx(MTP_TX_ENDPOINT, tx_packet_size, 0, NULL);
+	stream_tx_head = 0;
+	stream_tx_pending = 0;
+	rx_stream = 0;
+	rx_idle = 0;
+	stream_rx_result = 0;
+	usb_config_tx(MTP_TX_ENDPOINT, tx_packet_size, 0, tx_event);
 	usb_config_rx(MTP_RX_ENDPOINT, rx_packet_size, 0, rx_event);
 	usb_config_tx(MTP_EVENT_ENDPOINT, MTP_EVENT_SIZE, 0, txEvent_event);
 	int i;
@@ -117,27 +154,107 @@ static void rx_queue_transfer(int i)
 	NVIC_ENABLE_IRQ(IRQ_USB1);
 }
 
+// stop streaming transfers which will never receive data
+static void rx_stream_cancel(void)
+{
+	USB1_ENDPTFLUSH = (1 << MTP_RX_ENDPOINT);
+	while (USB1_ENDPTFLUSH & (1 << MTP_RX_ENDPOINT)) ;
+	usb_config_rx(MTP_RX_ENDPOINT, rx_packet_size, 0, rx_event);
+	stream_rx_count = 0;
+	rx_idle = (1 << RX_NUM) - 1;
+}
+
+static void rx_stream_finish(void)
+{
+	int i;
+	if (stream_rx_dma < stream_rx_length) {
+		// drop data speculatively loaded into the cache during DMA
+		arm_dcache_delete(stream_rx_buffer + stream_rx_dma,
+			(stream_rx_length - stream_rx_dma + 31) & ~31);
+	}
+	stream_rx_result = stream_rx_offset;
+	if (stream_rx_offset % rx_packet_size) {
+		// short packet ended the data phase, resume normal receive
+		rx_stream = 0;
+		for (i=0; i < RX_NUM; i++) {
+			if (rx_idle & (1 << i)) rx_queue_transfer(i);
+		}
+		rx_idle = 0;
+	} else {
+		rx_stream = 2;
+	}
+	if (stream_rx_callback) stream_rx_callback(stream_rx_context, stream_rx_offset);
+}
+
+// copy a packet which was already queued when streaming began
+static void rx_stream_packet(int i, uint32_t len)
+{
+	uint32_t n = stream_rx_length - stream_rx_offset;
+	if (n > len) n = len;
+	memcpy(stream_rx_buffer + stream_rx_offset, rx_buffer + i * MTP_RX_SIZE_480, n);
+	stream_rx_offset += n;
+	rx_idle |= (1 << i);
+	if (len < rx_packet_size || stream_rx_offset >= stream_rx_length) {
+		if (stream_rx_count > 0) rx_stream_cancel();
+		rx_stream_finish();
+	}
+}
+
 static void rx_event(transfer_t *t)
 {
 	int i = t->callback_param;
 	//printf("rx event i=%d\n", i);
+	if (i >= STREAM) {
+		i -= STREAM;
+		uint32_t len = stream_rx_size[i] - ((t->status >> 16) & 0x7FFF);
+		stream_rx_offset += len;
+		if (len < stream_rx_size[i] && i + 1 < stream_rx_count) {
+			// short packet, the rest of the streaming transfers are not needed
+			rx_stream_cancel();
+			rx_stream_finish();
+		} else if (i + 1 == stream_rx_count) {
+			stream_rx_count = 0;
+			rx_stream_finish();
+		}
+		return;
+	}
+	int len = rx_packet_size - ((t->status >> 16) & 0x7FFF);
+	if (rx_stream == 1) {
+		rx_stream_packet(i, len);
+		return;
+	}
 	// received a packet with data
 	uint32_t head = rx_head;
 	if (++head > RX_NUM) head = 0;
 	rx_list[head] = i;
 	// remember how many bytes were actually sent by host...
-	int len = rx_packet_size - ((t->status >> 16) & 0x7FFF);
 	rx_list_transfer_len[head] = len;
 	rx_head = head;
 }
 
 
+// after streaming receive, packets are received normally again
+static void rx_resume(void)
+{
+	int i;
+	if (rx_stream != 2) return;
+	NVIC_DISABLE_IRQ(IRQ_USB1);
+	rx_stream = 0;
+	for (i=0; i < RX_NUM; i++) {
+		if (rx_idle & (1 << i)) rx_queue_transfer(i);
+	}
+	rx_idle = 0;
+	NVIC_ENABLE_IRQ(IRQ_USB1);
+}
+
 int usb_mtp_recv(void *buffer, uint32_t timeout)
 {
 	uint32_t wait_begin_at = systick_millis_count;
 	uint32_t tail = rx_tail;
+	rx_resume();
 	while (1) {
 		if (!usb_configuration) return -1; // usb not enumerated by host
+		if (rx_stream) return 0; // streaming receive in progress
 		if (tail != rx_head) break;
 		if (systick_millis_count - wait_begin_at >= timeout)  {
 			return 0;
@@ -162,6 +279,8 @@ int usb_mtp_recv(void *buffer, uint32_t timeout)
 int usb_mtp_available(void)
 {
 	if (!usb_configuration) return 0;
+	rx_resume();
+	if (rx_stream) return 0;
 	if (rx_head != rx_tail) return rx_packet_size;
 	//if (!(usb_transfer_status(rx_transfer) & 0x80)) return MTP_RX_SIZE;
 	return 0;
@@ -191,4 +310,149 @@ int usb_mtp_send(const void *buffer, uint32_t len, uint32_t timeout)
 	return len;
 }
 
+
+/*************************************************************************/
+/**                          Streaming Transfers                        **/
+/*************************************************************************/
+
+static void tx_event(transfer_t *t)
+{
+	int i = t->callback_param;
+	if (i < STREAM) return;
+	i -= STREAM;
+	stream_tx_pending--;
+	if (stream_tx_callback[i]) {
+		stream_tx_callback[i](stream_tx_context[i], stream_tx_length[i]);
+	}
+}
+
+// Send directly from the caller's buffer, which must not change until
+// the transfer completes.  More sends may be started while others are
+// in progress, up to MTP_STREAM_NUM * 16K total.  Returns the number of
+// bytes accepted, 0 if none can be accepted now, or -1 if not configured.
+// callback (may be NULL) is called from the USB interrupt when all
+// accepted bytes have been sent.
+int usb_mtp_send_start(const void *buffer, uint32_t len, usb_mtp_callback_t callback, void *context)
+{
+	const uint8_t *p = (const uint8_t *)buffer;
+	uint32_t n, total=0;
+	int i=0;
+
+	if (!usb_configuration) return -1;
+	if (len == 0) return 0;
+	arm_dcache_flush((void *)buffer, len);
+	NVIC_DISABLE_IRQ(IRQ_USB1);
+	while (len > 0 && stream_tx_pending < MTP_STREAM_NUM) {
+		n = (len < STREAM_SIZE) ? len : STREAM_SIZE;
+		i = stream_tx_head;
+		stream_tx_callback[i] = NULL;
+		usb_prepare_transfer(stream_tx + i, p, n, STREAM + i);
+		usb_transmit(MTP_TX_ENDPOINT, stream_tx + i);
+		stream_tx_pending++;
+		if (++stream_tx_head >= MTP_STREAM_NUM) stream_tx_head = 0;
+		p += n;
+		len -= n;
+		total += n;
+	}
+	if (total > 0) {
+		// the last transfer reports completion of all of them
+		stream_tx_callback[i] = callback;
+		stream_tx_context[i] = context;
+		stream_tx_length[i] = total;
+	}
+	NVIC_ENABLE_IRQ(IRQ_USB1);
+	return total;
+}
+
+int usb_mtp_send_busy(void)
+{
+	return stream_tx_pending > 0;
+}
+
+int usb_mtp_send_wait(uint32_t timeout)
+{
+	uint32_t wait_begin_at = systick_millis_count;
+	while (stream_tx_pending) {
+		if (!usb_configuration) return -1;
+		if (systick_millis_count - wait_begin_at > timeout) return 0;
+		yield();
+	}
+	return 1;
+}
+
+// Receive directly into the caller's buffer.  The buffer must be aligned
+// to 32 bytes and the length a multiple of 32, because the cache is
+// deleted for the received data.  The length should cover the rest of
+// the data phase, or be a multiple of usb_mtp_rxSize().  A short packet
+// from the host ends the receive early.  Only one receive may be in
+// progress.  Returns the number of bytes which will be received (up to
+// MTP_STREAM_NUM * 16K), 0 if busy or misaligned, or -1 if not configured.
+int usb_mtp_recv_start(void *buffer, uint32_t len, usb_mtp_callback_t callback, void *context)
+{
+	uint32_t tail, i, n, pos, active;
+
+	if (!usb_configuration) return -1;
+	if (len == 0 || rx_stream == 1 || (((uint32_t)buffer | len) & 31)) return 0;
+	if (len > MTP_STREAM_NUM * STREAM_SIZE) len = MTP_STREAM_NUM * STREAM_SIZE;
+	NVIC_DISABLE_IRQ(IRQ_USB1);
+	stream_rx_buffer = (uint8_t *)buffer;
+	stream_rx_length = len;
+	stream_rx_offset = 0;
+	stream_rx_callback = callback;
+	stream_rx_context = context;
+	stream_rx_result = -1;
+	stream_rx_count = 0;
+	stream_rx_dma = len;
+	rx_stream = 1;
+	// packets already received are copied
+	tail = rx_tail;
+	while (tail != rx_head && rx_stream == 1) {
+		if (++tail > RX_NUM) tail = 0;
+		rx_tail = tail;
+		rx_stream_packet(rx_list[tail], rx_list_transfer_len[tail]);
+	}
+	if (rx_stream == 1) {
+		// packets already queued will be copied when they arrive,
+		// so streaming transfers begin after them
+		active = 0;
+		for (i=0; i < RX_NUM; i++) {
+			if (!(rx_idle & (1 << i))) active++;
+		}
+		pos = stream_rx_offset + active * rx_packet_size;
+		if (pos < len) {
+			stream_rx_dma = pos;
+			arm_dcache_flush_delete(stream_rx_buffer + pos, len - pos);
+		}
+		for (i=0; pos < len; i++) {
+			n = len - pos;
+			if (n > STREAM_SIZE) n = STREAM_SIZE;
+			stream_rx_size[i] = n;
+			usb_prepare_transfer(stream_rx + i, stream_rx_buffer + pos, n, STREAM + i);
+			usb_receive(MTP_RX_ENDPOINT, stream_rx + i);
+			pos += n;
+		}
+		stream_rx_count = i;
+	}
+	NVIC_ENABLE_IRQ(IRQ_USB1);
+	return len;
+}
+
+int usb_mtp_recv_busy(void)
+{
+	return rx_stream == 1;
+}
+
+// Wait for a streaming receive.  Returns the number of bytes received,
+// or 0 for timeout or -1 if not configured.
+int usb_mtp_recv_wait(uint32_t timeout)
+{
+	uint32_t wait_begin_at = systick_millis_count;
+	while (rx_stream == 1) {
+		if (!usb_configuration) return -1;
+		if (systick_millis_count - wait_begin_at > timeout) return 0;
+		yield();
+	}
+	return stream_rx_result;
+}
+
 #endif // MTP_INTERFACE
@@ -47,6 +47,15 @@ int usb_mtp_send(const void *buffer, uint32_t len, uint32_t timeout);
 int usb_mtp_rxSize(void);
 int usb_mtp_txSize(void);
 
+// streaming transfers, directly from or to the caller's memory
+typedef void (*usb_mtp_callback_t)(void *context, uint32_t len);
+int usb_mtp_send_start(const void *buffer, uint32_t len, usb_mtp_callback_t callback, void *context);
+int usb_mtp_send_busy(void);
+int usb_mtp_send_wait(uint32_t timeout);
+int usb_mtp_recv_start(void *buffer, uint32_t len, usb_mtp_callback_t callback, void *context);
+int usb_mtp_recv_busy(void);
+int usb_mtp_recv_wait(uint32_t timeout);
+
 extern uint32_t mtp_txEventCount;
 extern volatile uint8_t usb_mtp_status;
 
@@ -66,6 +75,15 @@ public:
     int rxSize(void) {return usb_mtp_rxSize(); }
     int txSize(void) {return usb_mtp_txSize(); }
 
+	int sendStart(const void *buffer, uint32_t len, usb_mtp_callback_t callback = NULL, void *context = NULL) {
+		return usb_mtp_send_start(buffer, len, callback, context); }
+	bool sendBusy(void) { return usb_mtp_send_busy(); }
+	int sendWait(uint32_t timeout) { return usb_mtp_send_wait(timeout); }
+	int recvStart(void *buffer, uint32_t len, usb_mtp_callback_t callback = NULL, void *context = NULL) {
+		return usb_mtp_recv_start(buffer, len, callback, context); }
+	bool recvBusy(void) { return usb_mtp_recv_busy(); }
+	int recvWait(uint32_t timeout) { return usb_mtp_recv_wait(timeout); }
+
     uint32_t txEventCount() { return mtp_txEventCount; }
 };
 
@@ -39,14 +39,30 @@
 
 #ifdef RAWHID_INTERFACE // defined by usb_dev.h -> usb_desc.h
 
-#define TX_NUM   4
+// number of reports which may be queued in each direction
+#ifndef RAWHID_TX_NUM
+#define RAWHID_TX_NUM  4
+#endif
+#ifndef RAWHID_RX_NUM
+#define RAWHID_RX_NUM  4
+#endif
+#if RAWHID_RX_NUM > 255
+#error "RAWHID_RX_NUM must be 255 or less"
+#endif
+
+// buffers are whole cache rows, so arm_dcache_delete() never touches
+// a neighbouring buffer
+#define TX_BUFSIZE  ((RAWHID_TX_SIZE + 31) & ~31)
+#define RX_BUFSIZE  ((RAWHID_RX_SIZE + 31) & ~31)
+
+#define TX_NUM   RAWHID_TX_NUM
 static transfer_t tx_transfer[TX_NUM] __attribute__ ((used, aligned(32)));
-DMAMEM static uint8_t txbuffer[RAWHID_TX_SIZE * TX_NUM];
+DMAMEM static uint8_t txbuffer[TX_BUFSIZE * TX_NUM] __attribute__ ((aligned(32)));
 static uint8_t tx_head=0;
 
-#define RX_NUM  4
+#define RX_NUM   RAWHID_RX_NUM
 static transfer_t rx_transfer[RX_NUM] __attribute__ ((used, aligned(32)));
-DMAMEM static uint8_t rx_buffer[RAWHID_RX_SIZE * RX_NUM] __attribute__ ((aligned(32)));
+DMAMEM static uint8_t rx_buffer[RX_BUFSIZE * RX_NUM] __attribute__ ((aligned(32)));
 static volatile uint8_t rx_head;
 static volatile uint8_t rx_tail;
 static uint8_t rx_list[RX_NUM + 1];
@@ -54,6 +70,7 @@ static volatile uint32_t rx_available;
 static void rx_queue_transfer(int i);
 static void rx_event(transfer_t *t);
 extern volatile uint8_t usb_configuration;
+extern volatile uint8_t usb_high_speed;
 
 
 void usb_rawhid_configure(void)
@@ -64,8 +81,15 @@ void usb_rawhid_configure(void)
 	tx_head = 0;
 	rx_head = 0;
 	rx_tail = 0;
-	usb_config_tx(RAWHID_TX_ENDPOINT, RAWHID_TX_SIZE, 0, NULL);
-	usb_config_rx(RAWHID_RX_ENDPOINT, RAWHID_RX_SIZE, 0, rx_event);
+	// reports larger than the packet size are sent as several packets,
+	// high bandwidth endpoints need no special dQH setting (Mult = 0)
+	if (usb_high_speed) {
+		usb_config_tx(RAWHID_TX_ENDPOINT, RAWHID_TX_SIZE_480, 0, NULL);
+		usb_config_rx(RAWHID_RX_ENDPOINT, RAWHID_RX_SIZE_480, 0, rx_event);
+	} else {
+		usb_config_tx(RAWHID_TX_ENDPOINT, RAWHID_TX_SIZE_12, 0, NULL);
+		usb_config_rx(RAWHID_RX_ENDPOINT, RAWHID_RX_SIZE_12, 0, rx_event);
+	}
 	int i;
 	for (i=0; i < RX_NUM; i++) rx_queue_transfer(i);
 }
@@ -76,8 +100,8 @@ void usb_rawhid_configure(void)
 
 static void rx_queue_transfer(int i)
 {
-	void *buffer = rx_buffer + i * RAWHID_RX_SIZE;
-	arm_dcache_delete(buffer, RAWHID_RX_SIZE);
+	void *buffer = rx_buffer + i * RX_BUFSIZE;
+	arm_dcache_delete(buffer, RX_BUFSIZE);
 	//memset(buffer, )
 	NVIC_DISABLE_IRQ(IRQ_USB1);
 	usb_prepare_transfer(rx_transfer + i, buffer, RAWHID_RX_SIZE, i);
@@ -96,53 +120,106 @@ static void rx_event(transfer_t *t)
 	rx_head = head;
 }
 
+// copy the oldest received report and give its buffer back to the USB
+static void rx_copy(void *buffer)
+{
+	uint32_t tail = rx_tail;
+	if (++tail > RX_NUM) tail = 0;
+	uint32_t i = rx_list[tail];
+	rx_tail = tail;
+	memcpy(buffer,  rx_buffer + i * RX_BUFSIZE, RAWHID_RX_SIZE);
+	rx_queue_transfer(i);
+}
 
 int usb_rawhid_recv(void *buffer, uint32_t timeout)
 {
 	uint32_t wait_begin_at = systick_millis_count;
-	uint32_t tail = rx_tail;
 	while (1) {
 		if (!usb_configuration) return -1; // usb not enumerated by host
-		if (tail != rx_head) break;
+		if (rx_tail != rx_head) break;
 		if ((systick_millis_count - wait_begin_at > timeout) || !timeout) {
 			return 0;
 		}
 		yield();
 	}
 //	digitalWriteFast(0, LOW);
-	if (++tail > RX_NUM) tail = 0;
-	uint32_t i = rx_list[tail];
-	rx_tail = tail;
-
-	memcpy(buffer,  rx_buffer + i * RAWHID_RX_SIZE, RAWHID_RX_SIZE);
-	rx_queue_transfer(i);
-	//memset(rx_transfer, 0, sizeof(rx_transfer));
-	//usb_prepare_transfer(rx_transfer + 0, rx_buffer, RAWHID_RX_SIZE, 0);
-	//usb_receive(RAWHID_RX_ENDPOINT, rx_transfer + 0);
+	rx_copy(buffer);
 	return RAWHID_RX_SIZE;
 }
 
-int usb_rawhid_send(const void *buffer, uint32_t timeout)
+// receive up to count reports, waiting no more than timeout for all of
+// them.  With timeout = 0, only the already received reports are read.
+int usb_rawhid_recv_reports(void *buffer, uint32_t count, uint32_t timeout)
 {
-	transfer_t *xfer = tx_transfer + tx_head;
+	uint8_t *p = (uint8_t *)buffer;
+	uint32_t n = 0;
 	uint32_t wait_begin_at = systick_millis_count;
+	while (n < count) {
+		if (!usb_configuration) return n ? (int)n : -1;
+		if (rx_tail != rx_head) {
+			rx_copy(p);
+			p += RAWHID_RX_SIZE;
+			n++;
+			continue;
+		}
+		if ((systick_millis_count - wait_begin_at > timeout) || !timeout) break;
+		yield();
+	}
+	return n;
+}
 
+/*************************************************************************/
+/**                               Transmit                              **/
+/*************************************************************************/
+
+// wait for the next transfer descriptor to become free, 1 = ready
+static int tx_wait(uint32_t wait_begin_at, uint32_t timeout)
+{
+	transfer_t *xfer = tx_transfer + tx_head;
 	while (1) {
 		if (!usb_configuration) return -1; // usb not enumerated by host
 		uint32_t status = usb_transfer_status(xfer);
-		if (!(status & 0x80)) break; // transfer descriptor ready
+		if (!(status & 0x80)) return 1; // transfer descriptor ready
 		if (systick_millis_count - wait_begin_at > timeout) return 0;
 		yield();
 	}
-	uint8_t *txdata = txbuffer + (tx_head * RAWHID_TX_SIZE);
+}
+
+static void tx_queue(const void *buffer)
+{
+	transfer_t *xfer = tx_transfer + tx_head;
+	uint8_t *txdata = txbuffer + (tx_head * TX_BUFSIZE);
 	memcpy(txdata, buffer, RAWHID_TX_SIZE);
-	arm_dcache_flush_delete(txdata, RAWHID_TX_SIZE );
+	arm_dcache_flush_delete(txdata, TX_BUFSIZE);
 	usb_prepare_transfer(xfer, txdata, RAWHID_TX_SIZE, 0);
 	usb_transmit(RAWHID_TX_ENDPOINT, xfer);
 	if (++tx_head >= TX_NUM) tx_head = 0;
+}
+
+int usb_rawhid_send(const void *buffer, uint32_t timeout)
+{
+	int r = tx_wait(systick_millis_count, timeout);
+	if (r <= 0) return r;
+	tx_queue(buffer);
 	return RAWHID_TX_SIZE;
 }
 
+// send count reports, waiting no more than timeout for all of them to
+// be queued.  Returns the number of reports sent.
+int usb_rawhid_send_reports(const void *buffer, uint32_t count, uint32_t timeout)
+{
+	const uint8_t *p = (const uint8_t *)buffer;
+	uint32_t n;
+	uint32_t wait_begin_at = systick_millis_count;
+	for (n=0; n < count; n++) {
+		int r = tx_wait(wait_begin_at, timeout);
+		if (r <= 0) return n ? (int)n : r;
+		tx_queue(p);
+		p += RAWHID_TX_SIZE;
+	}
+	return n;
+}
+
 int usb_rawhid_available(void)
 {
 	if (!usb_configuration) return 0;
@@ -44,6 +44,8 @@ void usb_rawhid_configure(void);
 int usb_rawhid_recv(void *buffer, uint32_t timeout);
 int usb_rawhid_available(void);
 int usb_rawhid_send(const void *buffer, uint32_t timeout);
+int usb_rawhid_recv_reports(void *buffer, uint32_t count, uint32_t timeout);
+int usb_rawhid_send_reports(const void *buffer, uint32_t count, uint32_t timeout);
 #ifdef __cplusplus
 }
 #endif
@@ -57,6 +59,9 @@ public:
 	int available(void) {return usb_rawhid_available(); }
 	int recv(void *buffer, uint16_t timeout) { return usb_rawhid_recv(buffer, timeout); }
 	int send(const void *buffer, uint16_t timeout) { return usb_rawhid_send(buffer, timeout); }
+	// many reports per call, buffer holds count * RAWHID_RX_SIZE or RAWHID_TX_SIZE bytes
+	int recvReports(void *buffer, uint32_t count, uint32_t timeout) { return usb_rawhid_recv_reports(buffer, count, timeout); }
+	int sendReports(const void *buffer, uint32_t count, uint32_t timeout) { return usb_rawhid_send_reports(buffer, count, timeout); }
 };
 
 extern usb_rawhid_class RawHID;
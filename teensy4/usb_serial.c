@@ -74,6 +74,21 @@ DMAMEM static uint8_t txbuffer[TX_SIZE * TX_NUM] __attribute__ ((aligned(32)));
 static uint8_t tx_head=0;
 static uint16_t tx_available=0;
 static uint16_t tx_packet_size=0;
+static uint8_t tx_claimed=0; // usb_serial_write_claim() handed out buffer space
+
+#if defined(TEENSY_INIT_USB_FAST_BOOT)
+// With fast boot, setup() may print before the PC has configured USB.  That
+// output is held here and sent as soon as USB is configured the first time.
+#ifndef USB_SERIAL_BOOT_BUFFER_SIZE
+#define USB_SERIAL_BOOT_BUFFER_SIZE 1024
+#endif
+#if USB_SERIAL_BOOT_BUFFER_SIZE > TX_SIZE
+#error "USB_SERIAL_BOOT_BUFFER_SIZE must not be larger than TX_SIZE"
+#endif
+static uint8_t boot_buffer[USB_SERIAL_BOOT_BUFFER_SIZE];
+static uint16_t boot_buffer_count=0;
+static uint8_t boot_buffer_done=0;
+#endif
 
 #define RX_NUM  8
 static transfer_t rx_transfer[RX_NUM] __attribute__ ((used, aligned(32)));
@@ -110,6 +125,7 @@ void usb_serial_configure(void)
 	memset(tx_transfer, 0, sizeof(tx_transfer));
 	tx_head = 0;
 	tx_available = 0;
+	tx_claimed = 0;
 	memset(rx_transfer, 0, sizeof(rx_transfer));
 	memset(rx_count, 0, sizeof(rx_count));
 	memset(rx_index, 0, sizeof(rx_index));
@@ -121,6 +137,16 @@ void usb_serial_configure(void)
 	usb_config_tx(CDC_TX_ENDPOINT, tx_packet_size, 1, NULL);
 	for (i=0; i < RX_NUM; i++) rx_queue_transfer(i);
 	timer_config(usb_serial_flush_callback, TRANSMIT_FLUSH_TIMEOUT);
+#if defined(TEENSY_INIT_USB_FAST_BOOT)
+	if (!boot_buffer_done) {
+		boot_buffer_done = 1;
+		if (boot_buffer_count > 0) {
+			memcpy(txbuffer, boot_buffer, boot_buffer_count);
+			tx_available = TX_SIZE - boot_buffer_count;
+			timer_start_oneshot();
+		}
+	}
+#endif
 	// weak serialEvent will be NULL unless user's program defines serialEvent()
 	if (serialEvent) yield_active_check_flags |= YIELD_CHECK_USB_SERIAL;
 }
@@ -320,53 +346,87 @@ static void timer_stop(void)
 }
 
 
+// wait for the current transmit buffer to have space.  Must be called with
+// tx_noautoflush set.  Returns 1 with tx_noautoflush still set when space is
+// available, or 0 with tx_noautoflush cleared if USB is unconfigured or the
+// PC isn't listening.
+static int tx_wait_available(void)
+{
+	transfer_t *xfer = tx_transfer + tx_head;
+	int waiting=0;
+	uint32_t wait_begin_at=0;
+	while (!tx_available) {
+		//digitalWriteFast(3, HIGH);
+		uint32_t status = usb_transfer_status(xfer);
+		if (!(status & 0x80)) {
+			if (status & 0x68) {
+				// TODO: what if status has errors???
+				printf("ERROR status = %x, i=%d, ms=%u\n",
+					status, tx_head, systick_millis_count);
+			}
+			tx_available = TX_SIZE;
+			transmit_previous_timeout = 0;
+			break;
+		}
+		asm("dsb" ::: "memory");
+		tx_noautoflush = 0;
+		if (!waiting) {
+			wait_begin_at = systick_millis_count;
+			waiting = 1;
+		}
+		if (transmit_previous_timeout) return 0;
+		if (systick_millis_count - wait_begin_at > TX_TIMEOUT_MSEC) {
+			// waited too long, assume the USB host isn't listening
+			transmit_previous_timeout = 1;
+			return 0;
+			//printf("\nstop, waited too long\n");
+			//printf("status = %x\n", status);
+			//printf("tx head=%d\n", tx_head);
+			//printf("TXFILLTUNING=%08lX\n", USB1_TXFILLTUNING);
+			//usb_print_transfer_log();
+			//while (1) ;
+		}
+		if (!usb_configuration) return 0;
+		yield();
+		tx_noautoflush = 1;
+	}
+	//digitalWriteFast(3, LOW);
+	return 1;
+}
+
+#if defined(TEENSY_INIT_USB_FAST_BOOT)
+static int boot_buffer_write(const void *buffer, uint32_t size)
+{
+	NVIC_DISABLE_IRQ(IRQ_USB1);
+	if (boot_buffer_done) {
+		NVIC_ENABLE_IRQ(IRQ_USB1);
+		return 0;
+	}
+	uint32_t avail = USB_SERIAL_BOOT_BUFFER_SIZE - boot_buffer_count;
+	if (size > avail) size = avail;
+	memcpy(boot_buffer + boot_buffer_count, buffer, size);
+	boot_buffer_count += size;
+	NVIC_ENABLE_IRQ(IRQ_USB1);
+	return size;
+}
+#endif
+
 int usb_serial_write(const void *buffer, uint32_t size)
 {
 	uint32_t sent=0;
 	const uint8_t *data = (const uint8_t *)buffer;
 
-	if (!usb_configuration) return 0;
+	if (!usb_configuration) {
+#if defined(TEENSY_INIT_USB_FAST_BOOT)
+		return boot_buffer_write(buffer, size);
+#else
+		return 0;
+#endif
+	}
 	while (size > 0) {
 		tx_noautoflush = 1;
+		if (!tx_wait_available()) return sent;
 		transfer_t *xfer = tx_transfer + tx_head;
-		int waiting=0;
-		uint32_t wait_begin_at=0;
-		while (!tx_available) {
-			//digitalWriteFast(3, HIGH);
-			uint32_t status = usb_transfer_status(xfer);
-			if (!(status & 0x80)) {
-				if (status & 0x68) {
-					// TODO: what if status has errors???
-					printf("ERROR status = %x, i=%d, ms=%u\n",
-						status, tx_head, systick_millis_count);
-				}
-				tx_available = TX_SIZE;
-				transmit_previous_timeout = 0;
-				break;
-			}
-			asm("dsb" ::: "memory");
-			tx_noautoflush = 0;
-			if (!waiting) {
-				wait_begin_at = systick_millis_count;
-				waiting = 1;
-			}
-			if (transmit_previous_timeout) return sent;
-			if (systick_millis_count - wait_begin_at > TX_TIMEOUT_MSEC) {
-				// waited too long, assume the USB host isn't listening
-				transmit_previous_timeout = 1;
-				return sent;
-				//printf("\nstop, waited too long\n");
-				//printf("status = %x\n", status);
-				//printf("tx head=%d\n", tx_head);
-				//printf("TXFILLTUNING=%08lX\n", USB1_TXFILLTUNING);
-				//usb_print_transfer_log();
-				//while (1) ;
-			}
-			if (!usb_configuration) return sent;
-			yield();
-			tx_noautoflush = 1;
-		}
-		//digitalWriteFast(3, LOW);
 		uint8_t *txdata = txbuffer + (tx_head * TX_SIZE) + (TX_SIZE - tx_available);
 		if (size >= tx_available) {
 			memcpy(txdata, data, tx_available);
@@ -395,6 +455,47 @@ int usb_serial_write(const void *buffer, uint32_t size)
 	return sent;
 }
 
+// Claim space directly inside the transmit buffer, so data can be formatted
+// in place rather than copied by usb_serial_write().  Returns a pointer to
+// the free space and its length in *size, or NULL if nothing can be sent.
+// Automatic flush is held off until usb_serial_write_commit() is called,
+// which must happen before any other Serial transmit function or yield()
+// is called.  Do not hold a claim across separate writes.
+uint8_t * usb_serial_write_claim(uint32_t *size)
+{
+	*size = 0;
+	if (!usb_configuration) return NULL;
+	tx_noautoflush = 1;
+	if (!tx_wait_available()) return NULL;
+	tx_claimed = 1;
+	*size = tx_available;
+	return txbuffer + (tx_head * TX_SIZE) + (TX_SIZE - tx_available);
+}
+
+// Commit the first "size" bytes of space obtained by usb_serial_write_claim().
+// A completely filled buffer is transmitted immediately, otherwise the
+// usual flush timer sends it if no more data arrives.
+void usb_serial_write_commit(uint32_t size)
+{
+	if (!tx_claimed) return;
+	tx_claimed = 0;
+	if (size > tx_available) size = tx_available;
+	tx_available -= size;
+	if (tx_available == 0) {
+		transfer_t *xfer = tx_transfer + tx_head;
+		uint8_t *txbuf = txbuffer + (tx_head * TX_SIZE);
+		usb_prepare_transfer(xfer, txbuf, TX_SIZE, 0);
+		arm_dcache_flush_delete(txbuf, TX_SIZE);
+		usb_transmit(CDC_TX_ENDPOINT, xfer);
+		if (++tx_head >= TX_NUM) tx_head = 0;
+		timer_stop();
+	} else if (size > 0) {
+		timer_start_oneshot();
+	}
+	asm("dsb" ::: "memory");
+	tx_noautoflush = 0;
+}
+
 int usb_serial_write_buffer_free(void)
 {
 	uint32_t sum = 0;
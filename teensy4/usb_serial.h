@@ -50,6 +50,8 @@ int usb_serial_read(void *buffer, uint32_t size);
 void usb_serial_flush_input(void);
 int usb_serial_putchar(uint8_t c);
 int usb_serial_write(const void *buffer, uint32_t size);
+uint8_t * usb_serial_write_claim(uint32_t *size);
+void usb_serial_write_commit(uint32_t size);
 int usb_serial_write_buffer_free(void);
 void usb_serial_flush_output(void);
 extern uint32_t usb_cdc_line_coding[2];
@@ -228,6 +228,9 @@ void *extmem_malloc(size_t size);
 void extmem_free(void *ptr);
 void *extmem_calloc(size_t nmemb, size_t size);
 void *extmem_realloc(void *ptr, size_t size);
+// Teensy 4.1 PSRAM speed, returns MHz used.  DMA to or from PSRAM must be
+// idle while the clock changes.
+uint32_t extmem_set_clock(uint32_t mhz);
 
 #ifdef __cplusplus
 } // extern "C"
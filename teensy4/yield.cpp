@@ -62,6 +62,12 @@ void yield(void)
 	}
 #endif
 
+#ifdef MSC_INTERFACE
+	if (check_flags & YIELD_CHECK_USB_MSC) {
+		usb_msc_task();
+	}
+#endif
+
 	// Current workaround until integrate with EventResponder.
 	if (check_flags & YIELD_CHECK_HARDWARE_SERIAL) {
 		HardwareSerialIMXRT::processSerialEventsList();